@@ -6,8 +6,39 @@ Data port = PORTB
 
 switches and led :-
 sw1 is connected to PC2
-SW2 is connected to INT0
+SW2 is connected to AIN1 (PD7)
 led is connected to PC0
+
+reaction time :-
+timer1 counts microseconds (F_CPU/8), the led is switched on by a timer1 compare match
+and the press of SW2 is timestamped by timer1 input capture, triggered by the analog comparator
+(AIN1 against the internal bandgap, the ICP1 pin is used by the lcd data port), with the noise canceller on
+the reaction time is the difference of the two timestamps (the ISR that switches the led on adds a constant
+delay of about 2us, the noise canceller 0.5us)
+
+multiplayer :-
+up to 8 player switches are connected to PORTD (player n to PD(n-1), player 8 is SW2), internal pull ups
+players join by pressing their switch on the instructions screen, the game is a multiplayer game
+if any player other than player 8 joined
+every press is timestamped with timer1 in the ISR that sees it first (no debouncing before the timestamp),
+all presses seen in one ISR get the same timestamp and the same rank, a press before the led is on is a cheat
+the pin change interrupt is used on devices that have one, the atmega8 samples PORTD every 256 cycles (32us)
+
+sessions :-
+the wait before the led is switched on is random (1 to 4s, 16 bit lfsr reseeded with timer1 whenever SW1 starts a trial)
+a session is SESSION_TRIALS single player trials that were not cheats or too slow, the mean, median, standard deviation
+and a histogram (25ms bins) of the session are updated with every trial, the session screen follows the last trial
+the 10 best times of all sessions (leaderboard) and the number of sessions are kept in EEPROM
+
+serial export :-
+every trial and every session is sent as text lines (250kbaud 8N1, TXD is PD1), times in us :-
+trial,<session>,<trial>,<reaction time>,<leaderboard rank or 0>
+session,<session>,<trials>,<mean>,<median>,<standard deviation>,<min>,<max>
+histogram,<session>,<bin width>,<count of bin 0>,...,<count of bin 15> (the last bin includes all slower times)
+leaderboard,<best time>,<second time>,... (empty entries are left out)
+TXD is shared with player 2, the transmitter is only switched on while a single player game sends its lines
+(an export is skipped if PD1 reads low when it starts), the lines are queued and sent by the uart ISR,
+task2 queues the longer session lines one per pass and switches the transmitter off once they have been sent
 */
 
 //define clock frequency
@@ -21,41 +52,84 @@ led is connected to PC0
 #include <avr/pgmspace.h>
 #include <avr/eeprom.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "lcd.h"
 #include "avr_delay.h"
+#include "eeprom_cache.h"
+#include "stats.h"
+#include "uart.h"
+#include "fsm.h"
+#include "hal.h"
 
 //process schedule time durations
 #define t1 30 //SW1 state machine update duration
 #define t2 50 //application state machine update duration
 #define t3 100 //lcd update duration
 
+//timer1 counts from the end of the wait until the led is switched on (us)
+#define LED_DELAY 100
+
+//random wait before the led is switched on (WAIT_MIN to WAIT_MIN + WAIT_RANGE - 1 ms)
+#define WAIT_MIN 1000
+#define WAIT_RANGE 3000
+//taps of the 16 bit galois lfsr (x^16 + x^14 + x^13 + x^11 + 1, maximum length)
+#define RANDOM_TAPS 0xB400
+
+//sessions
+#define SESSION_TRIALS 10
+#define HISTOGRAM_BINS 16
+#define HISTOGRAM_BIN_WIDTH 25000 //us
+
+//leaderboard (EEPROM)
+#define LEADERBOARD_SIZE 10
+#define LEADERBOARD_EMPTY 0xFFFF
+
+//serial export
+#define UART_BAUD 250000
+
+//states of a session export (lines still to be queued by export_task())
+#define EXPORT_IDLE 0
+#define EXPORT_HISTOGRAM 1
+#define EXPORT_LEADERBOARD 2
+
 //SW1 states
 #define NoPush 1
 #define MaybePush 2
 #define Pushed 3
 #define MaybeNoPush 4
 
-//main application states
-#define READY 1
-#define INSTRUCTIONS 2
-#define WAIT 3
-#define CHEAT 4
-#define RUNNING 5
-#define RESULTS 6
-
-//Flags for communication between processes (there can be a total of 16 flags)
-#define DISPLAY_READY 0
-#define SW1_EVENT 1
-#define DISPLAY_INSTRUCTIONS 2
-#define WAIT_DONE 3
-#define SW2_EVENT 4
-#define TIME_COUNT 5
-#define TOO_SLOW 6
-#define DISPLAY_CHEAT 7
-#define DISPLAY_TOO_SLOW 8
-#define DISPLAY_RESULTS 9
-#define DISPLAY_WAITING 10
+//main application states (states of app_fsm)
+#define READY 0
+#define INSTRUCTIONS 1
+#define WAIT 2
+#define CHEAT 3
+#define RUNNING 4
+#define RESULTS 5
+#define SESSION 6
+#define NUM_APP_STATES 7
+
+//events of the main application (queued by the ISRs and tasks, handled by task2)
+//SW1 has been pushed and released (task1)
+#define SW1_EVENT 0
+//SW2 has been pressed (timer1 capture ISR) or every player of a multiplayer game has pressed
+#define SW2_EVENT 1
+//end of the random wait (timer2 ISR)
+#define WAIT_DONE 2
+//the led has been switched on (timer1 compare ISR)
+#define LED_ON 3
+//no reaction within 400ms (timer2 ISR)
+#define TOO_SLOW 4
+//posted by results_next() when SW1 leaves the results, to start the next trial or to end the session
+#define NEXT_TRIAL 5
+#define SESSION_DONE 6
+#define NUM_EVENTS 7
+
+//multiplayer
+#define NUM_PLAYERS 8
+//player 8 (SW2) alone plays the single player game
+#define SW2_PLAYER_MASK (1<<PD7)
 
 //_____Global variables_____
 const prog_uchar message[] PROGMEM = {"Reaction time   tester"};
@@ -63,10 +137,11 @@ const prog_uchar ready[] PROGMEM = {"READY !!!"};
 const prog_uchar push_SW1[] PROGMEM = {"push SW1"};
 const prog_uchar instructions[] PROGMEM = {"push SW2 when   led comes on"};
 const prog_uchar reaction_time[] PROGMEM = {"R/n time :"};
-const prog_uchar high_score[] PROGMEM = {"High score :"};
+const prog_uchar high_score[] PROGMEM = {"Best time:"};
 const prog_uchar too_slow[] PROGMEM = {"Too slow !      Try again !"};
 const prog_uchar cheat[] PROGMEM = {"CHEAT !!!"};
 const prog_uchar waiting[] PROGMEM = {"....."};
+const prog_uchar players[] PROGMEM = {"Players"};
 
 //timer variables used to schedule tasks
 volatile uint16_t time1 = 0;
@@ -76,26 +151,77 @@ volatile uint16_t time3 = 0;
 //variables used to store current state of state machines
 //used for trackig SW1 state
 uint8_t PushState = NoPush;
-//used for tracking main application state
-uint8_t app_state = READY;
-
-//flags for inter-process communication
-volatile uint16_t flags = 0;
-
-//timer1 capture value
-volatile uint16_t t1capture = 0;
+//used for tracking main application state (tables after the function prototypes)
+fsm_t app_fsm;
+
+//trial state shared with the ISRs
+//the led is on (the reaction time is counted) and SW2 has been pressed
+volatile bool led_on = false;
+volatile bool sw2_pressed = false;
+//the trial ended without a reaction within 400ms
+bool reaction_too_slow = false;
+
+//timer1 overflows (upper 16 bits of the timer1 time in us)
+volatile uint16_t t1overflows = 0;
+//timer1 time at which the led was switched on
+volatile uint32_t led_on_time = 0;
+//reaction time measured by timer1 (us)
+volatile uint32_t reaction_us = 0;
+
+//multiplayer
+//players that joined (bit n-1 for player n) and the game type
+uint8_t players_joined = 0;
+bool multiplayer = false;
+//players that pressed their switch and players that pressed it before the led was on
+volatile uint8_t players_done = 0;
+volatile uint8_t players_cheat = 0;
+//reaction time of every player (us)
+volatile uint32_t player_time[NUM_PLAYERS];
 
 //variable used to track wait duration in WAIT state of application
 volatile uint16_t wait_duration = 0;
+//random duration of the wait (ms)
+volatile uint16_t wait_target = WAIT_MIN;
+//state of the lfsr (never 0)
+uint16_t random_state = 1;
 
-//variable to track number of times timer1 overflows
+//variable to track the time since the led was switched on (ms, used to detect slow reactions)
 volatile uint16_t time_count = 0;
 
-//variable used to store high_score
+//session
+//number of the session (from the EEPROM) and statistics of the reaction times (us)
+uint16_t session_number = 0;
+stats_t session_stats;
+//times of the session from the fastest to the slowest (units of 10us, for the median)
+uint16_t session_times[SESSION_TRIALS];
+uint8_t session_histogram[HISTOGRAM_BINS];
+//leaderboard rank of the last trial (0 if it is not on the leaderboard)
+uint8_t trial_rank = 0;
+
+//serial export
+//the transmitter is on (PD1 is TXD), the lines of a session export still to be queued and their data
+bool export_active = false;
+uint8_t export_state = EXPORT_IDLE;
+uint16_t export_session_number = 0;
+uint8_t export_histogram[HISTOGRAM_BINS];
+
+//variables stored in EEPROM (one struct, cached together by eeprom_cache)
+//number of sessions and the leaderboard, fastest first in units of 10us
+//(an erased EEPROM reads as an empty leaderboard)
+typedef struct
+{
+    uint16_t sessions;
+    uint16_t leaderboard[LEADERBOARD_SIZE];
+} scores_t;
+
+//the whole struct is cached, a larger leaderboard needs a larger EEPROM_CACHE_SIZE
+_Static_assert(sizeof(scores_t) <= EEPROM_CACHE_SIZE, "scores_t does not fit in the EEPROM cache");
+
 //make it an EEMEM variable so that it gets sotred in EEPROM
-uint16_t EEMEM high_score_eeprom = 400;
+//(read from the sram copy of the EEPROM kept by eeprom_cache, changes are written in the background)
+scores_t EEMEM scores_eeprom = {0, {[0 ... LEADERBOARD_SIZE - 1] = LEADERBOARD_EMPTY}};
 
-//create variable is sram to store high_score
+//create variable is sram to store high_score (best time of the leaderboard)
 uint16_t high_score_sram = 0;
 
 //_____Function prototypes_____
@@ -106,10 +232,89 @@ void task1(void); //SW1 state machint
 void task2(void); //app_state machine
 void task3(void); //screen update task
 
-//functions to modify flags
-void set_flag(uint8_t val);
-void clear_flag(uint8_t val);
-bool is_flag_set(uint8_t val);
+//timer1 time
+uint32_t timer1_extend(uint16_t count);
+void lcd_print_time(uint16_t time, char loc);
+
+//multiplayer
+void players_sample(void);
+void players_enable(bool enable);
+uint8_t players_rank(uint8_t* order);
+void lcd_print_ranking(void);
+
+//sessions
+uint16_t random_next(void);
+void session_reset(void);
+void session_add(uint32_t time);
+uint32_t session_median(void);
+uint8_t leaderboard_add(uint16_t time);
+void lcd_print_session(void);
+
+//serial export
+bool export_start(void);
+bool export_line(const char* line);
+void export_trial(uint32_t time);
+void export_session(void);
+void export_task(void);
+
+//actions of the application state machine
+void instructions_enter(void);
+void trial_start(void);
+void led_arm(void);
+void led_disarm(void);
+void running_enter(void);
+void running_exit(void);
+void trial_record(void);
+void trial_too_slow(void);
+void results_next(void);
+
+
+//_____State machine_____
+//transitions [state][event] of the application (events left out are ignored, see fsm.h)
+const fsm_transition_t app_transitions[NUM_APP_STATES][NUM_EVENTS] PROGMEM =
+{
+    [READY] =
+    {
+        [SW1_EVENT] = FSM_TRANSITION(INSTRUCTIONS, NULL),
+    },
+    [INSTRUCTIONS] =
+    {
+        [SW1_EVENT] = FSM_TRANSITION(WAIT, trial_start),
+    },
+    [WAIT] =
+    {
+        [WAIT_DONE] = FSM_TRANSITION(WAIT, led_arm),
+        [LED_ON] = FSM_TRANSITION(RUNNING, NULL),
+        //SW2 pressed in advance
+        [SW2_EVENT] = FSM_TRANSITION(CHEAT, led_disarm),
+    },
+    [CHEAT] =
+    {
+        [SW1_EVENT] = FSM_TRANSITION(READY, NULL),
+    },
+    [RUNNING] =
+    {
+        [SW2_EVENT] = FSM_TRANSITION(RESULTS, trial_record),
+        [TOO_SLOW] = FSM_TRANSITION(RESULTS, trial_too_slow),
+    },
+    [RESULTS] =
+    {
+        [SW1_EVENT] = FSM_TRANSITION(RESULTS, results_next),
+        [NEXT_TRIAL] = FSM_TRANSITION(READY, NULL),
+        [SESSION_DONE] = FSM_TRANSITION(SESSION, export_session),
+    },
+    [SESSION] =
+    {
+        [SW1_EVENT] = FSM_TRANSITION(READY, session_reset),
+    },
+};
+
+//entry and exit actions [state]
+const fsm_state_t app_states[NUM_APP_STATES] PROGMEM =
+{
+    [INSTRUCTIONS] = {instructions_enter, NULL},
+    [RUNNING] = {running_enter, running_exit},
+};
 
 
 //_____ISR_____
@@ -131,43 +336,78 @@ ISR (TIMER2_COMP_vect)
         time3 = time3 - 1;
     }
 
-    if(app_state == WAIT && !is_flag_set(WAIT_DONE))
+    if(app_fsm.state == WAIT && wait_duration < wait_target)
     {
-        if(wait_duration >= 2000)
+        if(++wait_duration == wait_target)
         {
-            set_flag(WAIT_DONE);
-            wait_duration = 0;
+            fsm_post(&app_fsm, WAIT_DONE);
         }
+    }
 
-        else
+    if (led_on && !sw2_pressed && time_count < 400)
+    {
+        //if response time exceeds 400ms, post TOO_SLOW
+        if(++time_count == 400)
         {
-            wait_duration++;
+            fsm_post(&app_fsm, TOO_SLOW);
         }
     }
+}
 
-    if (is_flag_set(TIME_COUNT) && !is_flag_set(SW2_EVENT) && !is_flag_set(TOO_SLOW))
+//timer1 input capture vector (SW2 pressed, the comparator output rises)
+ISR (TIMER1_CAPT_vect)
+{
+    uint32_t time = timer1_extend(ICR1);
+
+    //(the player switches are sampled in a multiplayer game)
+    if(!multiplayer && !sw2_pressed && (app_fsm.state == WAIT || app_fsm.state == RUNNING))
     {
-        //if response time exceeds 400ms, set TOO_SLOW flag
-        if(time_count >= 400)
+        //a press before the led is on is a cheat
+        if(led_on)
         {
-            set_flag(TOO_SLOW);
+            reaction_us = time - led_on_time;
         }
 
-        else
-        {
-            time_count++;
-        }
+        sw2_pressed = true;
+        fsm_post(&app_fsm, SW2_EVENT);
     }
 }
 
-ISR (INT0_vect)
+//timer1 compare A vector (end of the wait)
+ISR (TIMER1_COMPA_vect)
 {
-    if(!is_flag_set(SW2_EVENT) && (app_state == WAIT || app_state == RUNNING))
+    //single shot
+    TIMSK &= ~(1<<OCIE1A);
+
+    //the led stays off if SW2 was pressed during the wait
+    if(!sw2_pressed)
     {
-        set_flag(SW2_EVENT);
+        //turn led on
+        PORTC |= (1<<PC0);
+        led_on_time = timer1_extend(OCR1A);
+        //start counting the time
+        led_on = true;
+        fsm_post(&app_fsm, LED_ON);
     }
 }
 
+//timer1 overflow vector
+ISR (TIMER1_OVF_vect)
+{
+    t1overflows++;
+}
+
+#if defined(PCICR)
+//pin change vector of the player switches
+ISR (PCINT2_vect)
+#else
+//the atmega8 has no pin change interrupts, timer0 overflow vector (every 256 cycles) is used to sample the switches
+ISR (TIMER0_OVF_vect)
+#endif
+{
+    players_sample();
+}
+
 //_____MAIN_____
 int main(void)
 {
@@ -196,6 +436,8 @@ int main(void)
         {
             task3();
         }
+
+        HAL_IDLE();
     }
 }
 
@@ -220,11 +462,26 @@ void init(void)
     //led
     DDRC |= (1<<PC0);
 
-    //external hardware interrupt
-    //falling edge on INT0 generates an interrupt request
-    MCUCR |= (1<<ISC01);
-    //enable external interrupt request on INT0
-    GICR |= (1<<INT0);
+    //player switches and SW2 (AIN1) with pull ups
+    PORTD = 0xFF;
+    //analog comparator
+    //internal bandgap on the positive input, the output rises when SW2 pulls AIN1 below it
+    //the output triggers timer1 input capture
+    ACSR = ((1<<ACBG) | (1<<ACIC));
+
+    //timer1 for reaction timing
+    //prescalar 8 (1us per count), input capture noise canceller, capture on the rising edge of the comparator output
+    TCCR1B = ((1<<ICNC1) | (1<<ICES1) | (1<<CS11));
+    //enable input capture and overflow interrupts (compare A is enabled at the end of every wait)
+    hal_clear_flags(&TIFR, (1<<ICF1) | (1<<TOV1));
+    TIMSK |= ((1<<TICIE1) | (1<<TOIE1));
+
+    //copy the EEPROM variables (sessions and leaderboard) to sram
+    eeprom_cache_init(&scores_eeprom);
+    session_reset();
+
+    //application state machine
+    fsm_init(&app_fsm, &app_transitions[0][0], app_states, NUM_EVENTS, READY);
 
     //write a message to screen
     lcd_print_string_progmem(message,16,0x80);
@@ -295,7 +552,7 @@ void task1(void)
                 PushState = NoPush;
 
                 //SW1 has been pushed and released
-                set_flag(SW1_EVENT);
+                fsm_post(&app_fsm, SW1_EVENT);
             }
             break;
 
@@ -310,268 +567,680 @@ void task2(void)
 {
     time2 = t2;
 
-    switch(app_state)
+    //players join by pressing their switch on the instructions screen
+    if(app_fsm.state == INSTRUCTIONS)
     {
-        case READY:
-        {
-            //display ready message on lcd
-            if (!is_flag_set(DISPLAY_READY))
-            {
-                set_flag(DISPLAY_READY);
-            }
+        players_joined |= ~PIND;
+    }
 
-            if(is_flag_set(SW1_EVENT))
-            {
-                //when SW1 event is detected, set app_state to INSTRUCTIONS
-                app_state = INSTRUCTIONS;
-                //clear SW1 event flag
-                clear_flag(SW1_EVENT);
-                //clear DISPLAY_READY flag
-                clear_flag(DISPLAY_READY);
-            }
+    //handle the queued events
+    fsm_run(&app_fsm);
 
-            break;
-        }
+    //queue the next export line or switch the transmitter off
+    export_task();
+}
 
-        case INSTRUCTIONS:
+void task3(void)
+{
+    time3 = t3;
+
+    static uint8_t old_lcd_state = 0xFF;
+    static uint8_t old_players_joined = 0;
+    uint8_t new_lcd_state = app_fsm.state;
+
+    //the screen of a state is drawn once when the state is entered
+    if(new_lcd_state != old_lcd_state)
+    {
+        switch(new_lcd_state)
         {
-            if (!is_flag_set(DISPLAY_INSTRUCTIONS))
+            case READY:
             {
-                set_flag(DISPLAY_INSTRUCTIONS);
+                char line[17];
+
+                lcd_reset();
+                lcd_print_string_progmem(ready,sizeof(ready)/sizeof(prog_uchar),0x80);
+                //number of the next trial of the session (8 bit operands, at most 16 characters)
+                lcd_print_string(line,sprintf(line, "Trial %u of %u", (uint8_t) (session_stats.count + 1),
+                    (uint8_t) SESSION_TRIALS),0xC0);
+                break;
             }
 
-            if(is_flag_set(SW1_EVENT))
+            case INSTRUCTIONS:
             {
-                //when SW1 event is detected, set app_state to WAIT
-                app_state = WAIT;
-                //clear SW1 event flag
-                clear_flag(SW1_EVENT);
-                //clear DISPLAY_READY flag
-                clear_flag(DISPLAY_INSTRUCTIONS);
-                //st flag DISPLAY_WAITING
-                set_flag(DISPLAY_WAITING);
+                lcd_reset();
+                lcd_print_string_progmem(instructions,sizeof(instructions)/sizeof(prog_uchar),0x80);
+                lcd_print_string_progmem(&(instructions[16]),sizeof(instructions)/sizeof(prog_uchar),0xC0);
+                old_players_joined = 0;
+                break;
             }
 
-            break;
-        }
-
-        case WAIT:
-        {
-            //ignore SW1 events if any
-            if(is_flag_set(SW1_EVENT))
+            case WAIT:
             {
-                clear_flag(SW1_EVENT);
+                lcd_reset();
+                lcd_print_string_progmem(waiting,sizeof(waiting)/sizeof(prog_uchar),0x80);
+                break;
             }
 
-            //if waiting is done, clear WAIT_DONE flag
-            if(is_flag_set(WAIT_DONE))
+            case CHEAT:
             {
-                //set app state to RUNNING
-                app_state = RUNNING;
-                //clear WAIT_DONE flag
-                clear_flag(WAIT_DONE);
-                //reset time_count value
-                time_count = 0;
-                //turn led on
-                PORTC |= (1<<PC0);
-                //set flag to start counting timer1 value
-                set_flag(TIME_COUNT);
+                lcd_reset();
+                lcd_print_string_progmem(cheat,sizeof(cheat)/sizeof(prog_uchar),0x80);
+                break;
             }
 
-            //if SW2 is pressed in advance, set app_state to CHEAT and clear SW2 event
-            if (is_flag_set(SW2_EVENT))
+            //the waiting screen stays while the led is on
+            case RUNNING:
             {
-                app_state = CHEAT;
-                clear_flag(SW2_EVENT);
-                //clear DISPLAY_WAITING flag
-                clear_flag(DISPLAY_WAITING);
+                break;
             }
 
-            break;
-        }
-
-        case CHEAT:
-        {
-            if (!is_flag_set(DISPLAY_CHEAT))
+            case RESULTS:
             {
-                set_flag(DISPLAY_CHEAT);
+                lcd_reset();
+
+                //display the ranking of a multiplayer game (players that were too slow are not ranked)
+                if(multiplayer)
+                {
+                    lcd_print_ranking();
+                }
+
+                //display too slow message
+                else if(reaction_too_slow)
+                {
+                    lcd_print_string_progmem(too_slow,sizeof(too_slow)/sizeof(prog_uchar),0x80);
+                    lcd_print_string_progmem(&(too_slow[16]),sizeof(too_slow)/sizeof(prog_uchar),0xC0);
+                }
+
+                else
+                {
+                    lcd_print_string_progmem(reaction_time,sizeof(reaction_time)/sizeof(prog_uchar),0x80);
+                    //display reaction time value (ms) at location 0x8A
+                    lcd_print_time((reaction_us + 5)/10,0x8A);
+
+                    lcd_print_string_progmem(high_score,sizeof(high_score)/sizeof(prog_uchar),0xC0);
+                    //read the value of high score (from the sram copy of the EEPROM, the trial is already on the leaderboard)
+                    high_score_sram = eeprom_cache_read_word(&scores_eeprom.leaderboard[0]);
+                    //display high score (ms) at location 0xCA on lcd
+                    lcd_print_time(high_score_sram,0xCA);
+                }
+                break;
             }
 
-            if(is_flag_set(SW1_EVENT))
+            case SESSION:
             {
-                //when SW1 event is detected, set app_state to WAIT
-                app_state = READY;
-                //clear SW1 event flag
-                clear_flag(SW1_EVENT);
-                //clear DISPLAY_CHEAT flag
-                clear_flag(DISPLAY_CHEAT);
+                lcd_reset();
+                lcd_print_session();
+                break;
             }
-
-            break;
         }
+    }
 
-        case RUNNING:
-        {
-            if(is_flag_set(SW2_EVENT) || is_flag_set(TOO_SLOW))
-            {
-                //reset SW2_EVENT flag
-                clear_flag(SW2_EVENT);
-                //reset T1_COUNT flag
-                clear_flag(TIME_COUNT);
-                //set app state to RESULTS
-                app_state = RESULTS;
-                //turn off led
-                PORTC &= ~(1<<PC0);
-                //clear DISPLAY_WAITING flag
-                clear_flag(DISPLAY_WAITING);
-            }
+    //the second line of the instructions lists the players that joined
+    if((new_lcd_state == INSTRUCTIONS) && (players_joined != old_players_joined))
+    {
+        char line[NUM_PLAYERS + 1];
+        uint8_t count;
 
-            break;
+        for(count = 0; count < NUM_PLAYERS; count++)
+        {
+            line[count] = (players_joined & (1<<count)) ? ('1' + count) : ' ';
         }
 
-        case RESULTS:
-        {
-            //clear SW2_EVENT which may have been generated due to switch bounce
-            clear_flag(SW2_EVENT);
-            //display too slow message if TOO_SLOW flag is set
-            if(is_flag_set(TOO_SLOW))
-            {
-                set_flag(DISPLAY_TOO_SLOW);
-            }
+        lcd_clear_segment(16,0xC0);
+        lcd_print_string_progmem(players,sizeof(players)/sizeof(prog_uchar),0xC0);
+        lcd_print_string(line,NUM_PLAYERS,0xC8);
+        old_players_joined = players_joined;
+    }
 
-            else
-            {
-                set_flag(DISPLAY_RESULTS);
-            }
+    old_lcd_state = new_lcd_state;
+}
 
-            if(is_flag_set(SW1_EVENT))
-            {
-                //set app state to ready
-                app_state = READY;
-                //clear SW1_EVENT flag
-                clear_flag(SW1_EVENT);
-                //reset TOO_SLOW flag
-                clear_flag(TOO_SLOW);
-                //clear DISPLAY_RESULTS flag
-                clear_flag(DISPLAY_RESULTS);
-                //clear DISPLAY_TOO_SLOW flag
-                clear_flag(DISPLAY_TOO_SLOW);
-            }
+//extend a timer1 count (compare or capture value) to 32 bits with the number of overflows
+//(called from the timer1 ISRs and from the switch sampling ISR (pin change or timer0 overflow),
+//an overflow after the count may not have been handled yet)
+uint32_t timer1_extend(uint16_t count)
+{
+    uint16_t overflows = t1overflows;
 
-            break;
+    if((TIFR & (1<<TOV1)) && (count < 0x8000))
+    {
+        overflows++;
+    }
+
+    return (((uint32_t) overflows << 16) | count);
+}
+
+//multiplayer
+//timestamp the first press of every player (called from the pin change or sampling ISR)
+//all presses seen in one call get the same timestamp
+void players_sample(void)
+{
+    uint8_t pressed = ~PIND & players_joined & ~players_done;
+    uint32_t time;
+    uint8_t count;
+
+    if(pressed == 0)
+    {
+        return;
+    }
+
+    time = timer1_extend(TCNT1);
+    players_done |= pressed;
+
+    //presses before the led is on are cheats
+    if(!led_on)
+    {
+        players_cheat |= pressed;
+
+        return;
+    }
+
+    for(count = 0; count < NUM_PLAYERS; count++)
+    {
+        if(pressed & (1<<count))
+        {
+            player_time[count] = time - led_on_time;
         }
     }
+
+    //the game ends when every player has pressed
+    if(players_done == players_joined)
+    {
+        fsm_post(&app_fsm, SW2_EVENT);
+    }
+
+    return;
 }
 
-void task3(void)
+//start or stop timestamping the player switches
+void players_enable(bool enable)
 {
-    time3 = t3;
+#if defined(PCICR)
+    PCMSK2 = enable ? players_joined : 0;
+    hal_clear_flags(&PCIFR, (1<<PCIF2));
+
+    if(enable)
+    {
+        PCICR |= (1<<PCIE2);
+    }
+
+    else
+    {
+        PCICR &= ~(1<<PCIE2);
+    }
+#else
+    //timer0 overflows every 256 cycles without prescaler
+    TCCR0 = enable ? (1<<CS00) : 0;
+    hal_clear_flags(&TIFR, (1<<TOV0));
+
+    if(enable)
+    {
+        TIMSK |= (1<<TOIE0);
+    }
+
+    else
+    {
+        TIMSK &= ~(1<<TOIE0);
+    }
+#endif
+
+    return;
+}
 
-    static uint8_t new_lcd_state = 0;
-    static uint8_t old_lcd_state = 0;
+//sort the players that pressed in time (no cheat) from the fastest to the slowest, returns their number
+uint8_t players_rank(uint8_t* order)
+{
+    uint8_t ranked = players_done & ~players_cheat;
+    uint8_t num_ranked = 0;
+    uint8_t count;
+    uint8_t index;
 
-    if(is_flag_set(DISPLAY_READY))
+    for(count = 0; count < NUM_PLAYERS; count++)
     {
-        new_lcd_state = 1;
-        if(new_lcd_state != old_lcd_state)
+        //players that were too slow have no time
+        if(!(ranked & (1<<count)) || (player_time[count] > 400000UL))
         {
-            lcd_reset();
-            lcd_print_string_progmem(ready,sizeof(ready)/sizeof(prog_uchar),0x80);
+            continue;
         }
+
+        //insertion sort, players with the same time keep the order of their numbers
+        for(index = num_ranked; (index > 0) && (player_time[order[index - 1]] > player_time[count]); index--)
+        {
+            order[index] = order[index - 1];
+        }
+
+        order[index] = count;
+        num_ranked++;
     }
 
-    else if(is_flag_set(DISPLAY_INSTRUCTIONS))
+    return (num_ranked);
+}
+
+//print the ranking (first line, equal times joined by '='), the time of the winner and the cheats (second line)
+void lcd_print_ranking(void)
+{
+    uint8_t order[NUM_PLAYERS];
+    uint8_t num_ranked = players_rank(order);
+    char line[17];
+    uint8_t length = 0;
+    uint8_t count;
+
+    for(count = 0; count < num_ranked; count++)
     {
-        new_lcd_state = 2;
-        if(new_lcd_state != old_lcd_state)
+        if(count > 0)
         {
-            lcd_reset();
-            lcd_print_string_progmem(instructions,sizeof(instructions)/sizeof(prog_uchar),0x80);
-            lcd_print_string_progmem(&(instructions[16]),sizeof(instructions)/sizeof(prog_uchar),0xC0);
+            line[length++] = (player_time[order[count]] == player_time[order[count - 1]]) ? '=' : ' ';
         }
+
+        line[length++] = '1' + order[count];
     }
 
-    else if(is_flag_set(DISPLAY_RESULTS))
+    lcd_print_string(line,length,0x80);
+
+    length = 0;
+
+    if(num_ranked > 0)
+    {
+        uint16_t time = (player_time[order[0]] + 5)/10;
+
+        length = sprintf(line, "P%c %3u.%02u", '1' + order[0], time/100, time%100);
+    }
+
+    if(players_cheat)
     {
-        new_lcd_state = 3;
-        if(new_lcd_state != old_lcd_state)
+        line[length++] = ' ';
+        line[length++] = 'X';
+
+        for(count = 0; (count < NUM_PLAYERS) && (length < 16); count++)
         {
-            lcd_reset();
-            lcd_print_string_progmem(reaction_time,sizeof(reaction_time)/sizeof(prog_uchar),0x80);
-            //display reaction time value at location 0x8B
-            lcd_print_num(time_count,3,0x8B);
-
-            lcd_print_string_progmem(high_score,sizeof(high_score)/sizeof(prog_uchar),0xC0);
-            //read the value of high score in EEPROM to a variable in sram
-            high_score_sram = eeprom_read_word(&high_score_eeprom);
-            if(time_count < high_score_sram)
+            if(players_cheat & (1<<count))
             {
-                high_score_sram = time_count;
-                eeprom_update_word(&high_score_eeprom, high_score_sram);
+                line[length++] = '1' + count;
             }
-            //display high score at location 0xCD on lcd
-            lcd_print_num(high_score_sram,3,0xCD);
         }
     }
 
-    else if(is_flag_set(DISPLAY_CHEAT))
+    lcd_print_string(line,length,0xC0);
+
+    return;
+}
+
+//sessions
+//next value of the lfsr (galois form, one shift per call)
+uint16_t random_next(void)
+{
+    //a seed of 0 would never change
+    if(random_state == 0)
     {
-        new_lcd_state = 4;
-        if(new_lcd_state != old_lcd_state)
-        {
-            lcd_reset();
-            lcd_print_string_progmem(cheat,sizeof(cheat)/sizeof(prog_uchar),0x80);
-        }
+        random_state = 1;
     }
 
-    else if(is_flag_set(DISPLAY_TOO_SLOW))
+    if(random_state & 1)
     {
-        new_lcd_state = 5;
-        if(new_lcd_state != old_lcd_state)
-        {
-            lcd_reset();
-            lcd_print_string_progmem(too_slow,sizeof(too_slow)/sizeof(prog_uchar),0x80);
-            lcd_print_string_progmem(&(too_slow[16]),sizeof(too_slow)/sizeof(prog_uchar),0xC0);
-        }
+        random_state = (random_state >> 1) ^ RANDOM_TAPS;
     }
 
-    else if(is_flag_set(DISPLAY_WAITING))
+    else
     {
-        new_lcd_state = 6;
-        if(new_lcd_state != old_lcd_state)
+        random_state >>= 1;
+    }
+
+    return (random_state);
+}
+
+//start a new session (the session number is taken from the EEPROM with the first trial)
+void session_reset(void)
+{
+    uint8_t count;
+
+    stats_reset(&session_stats);
+
+    for(count = 0; count < HISTOGRAM_BINS; count++)
+    {
+        session_histogram[count] = 0;
+    }
+
+    return;
+}
+
+//add the reaction time of a trial (us) to the statistics, the sorted times and the histogram
+//(the time is at most 400ms, a few hundred cycles)
+void session_add(uint32_t time)
+{
+    uint16_t time_10us = (time + 5)/10;
+    uint8_t bin = time/HISTOGRAM_BIN_WIDTH;
+    uint8_t index;
+
+    //every session gets a new number, also if it is not finished
+    if(session_stats.count == 0)
+    {
+        session_number = eeprom_cache_read_word(&scores_eeprom.sessions) + 1;
+        eeprom_cache_write_word(&scores_eeprom.sessions, session_number);
+    }
+
+    //insertion into the sorted times
+    for(index = session_stats.count; (index > 0) && (session_times[index - 1] > time_10us); index--)
+    {
+        session_times[index] = session_times[index - 1];
+    }
+
+    session_times[index] = time_10us;
+
+    stats_update(&session_stats, time);
+
+    session_histogram[(bin < HISTOGRAM_BINS) ? bin : (HISTOGRAM_BINS - 1)]++;
+
+    return;
+}
+
+//median of the session (us, resolution 10us)
+uint32_t session_median(void)
+{
+    uint8_t count = session_stats.count;
+
+    if(count == 0)
+    {
+        return (0);
+    }
+
+    //an even number of times has two middle values
+    if(count & 1)
+    {
+        return (session_times[count/2] * 10UL);
+    }
+
+    return ((session_times[count/2 - 1] + (uint32_t) session_times[count/2]) * 5);
+}
+
+//add a time (units of 10us) to the leaderboard in the EEPROM
+//returns the rank (1 for the best time) or 0 if the time is not fast enough
+uint8_t leaderboard_add(uint16_t time)
+{
+    uint16_t leaderboard[LEADERBOARD_SIZE];
+    uint8_t index;
+
+    eeprom_cache_read_block(leaderboard, scores_eeprom.leaderboard, sizeof(leaderboard));
+
+    if(time >= leaderboard[LEADERBOARD_SIZE - 1])
+    {
+        return (0);
+    }
+
+    //the slower times move down, an equal time stays ahead of the new one
+    for(index = LEADERBOARD_SIZE - 1; (index > 0) && (leaderboard[index - 1] > time); index--)
+    {
+        leaderboard[index] = leaderboard[index - 1];
+    }
+
+    leaderboard[index] = time;
+
+    //only the changed bytes are written (in the background)
+    eeprom_cache_write_block(leaderboard, scores_eeprom.leaderboard, sizeof(leaderboard));
+
+    return (index + 1);
+}
+
+//print the mean and the standard deviation (first line) and the median (second line) of the session
+void lcd_print_session(void)
+{
+    char line[24];
+
+    lcd_print_string(line,sprintf(line, "Avg %3u.%02u sd%3u", (uint16_t) ((stats_mean(&session_stats) + 5)/10)/100,
+        (uint16_t) ((stats_mean(&session_stats) + 5)/10)%100, (uint16_t) ((stats_deviation(&session_stats) + 500)/1000)),0x80);
+    lcd_print_string(line,sprintf(line, "Med %3u.%02u n%3u", (uint16_t) ((session_median() + 5)/10)/100,
+        (uint16_t) ((session_median() + 5)/10)%100, (uint16_t) session_stats.count),0xC0);
+
+    return;
+}
+
+//serial export
+//switch the transmitter on for an export, returns false (the export is skipped) if PD1 is held low
+//(player 2 presses the switch, TXD would drive the pin against it)
+bool export_start(void)
+{
+    //while the transmitter is on the pin is driven by TXD and reads high
+    if(!export_active)
+    {
+        if(bit_is_clear(PIND, PD1))
         {
-            lcd_reset();
-            lcd_print_string_progmem(waiting,sizeof(waiting)/sizeof(prog_uchar),0x80);
+            return (false);
         }
+
+        uart_init(UART_UBRR(UART_BAUD));
+        export_active = true;
     }
 
-    else;
+    return (true);
+}
 
-    old_lcd_state = new_lcd_state;
+//queue a line (the transmit ring buffer is emptied by the uart ISR), returns false if it does not fit yet
+bool export_line(const char* line)
+{
+    return (uart_try_write((const uint8_t*) line, strlen(line)));
+}
+
+//send the line of a trial (reaction time in us)
+//(the line is queued, task2 switches the transmitter off once it has been sent)
+void export_trial(uint32_t time)
+{
+    char line[48];
+
+    if(!export_start())
+    {
+        return;
+    }
+
+    sprintf(line, "trial,%u,%u,%lu,%u\r\n", session_number, (uint16_t) session_stats.count, (unsigned long) time,
+        trial_rank);
+    export_line(line);
+
+    return;
+}
+
+//send the lines of a finished session (statistics, histogram and leaderboard)
+//the statistics line is queued at once, the histogram (copied here, the next session clears it) and the
+//leaderboard lines are queued by export_task() in the next task2 passes
+void export_session(void)
+{
+    char line[96];
+
+    if(!export_start())
+    {
+        return;
+    }
+
+    sprintf(line, "session,%u,%u,%ld,%lu,%lu,%ld,%ld\r\n", session_number, (uint16_t) session_stats.count,
+        (long) stats_mean(&session_stats), (unsigned long) session_median(),
+        (unsigned long) stats_deviation(&session_stats), (long) session_stats.min, (long) session_stats.max);
+    export_line(line);
+
+    export_session_number = session_number;
+    memcpy(export_histogram, session_histogram, sizeof(export_histogram));
+    export_state = EXPORT_HISTOGRAM;
+
+    return;
+}
+
+//queue the next line of a session export (a line per pass, at most 87 characters, 3.5ms at 250kbaud)
+//and switch the transmitter off once everything has been sent, PD1 is given back to player 2
+//(called by task2, never waits)
+void export_task(void)
+{
+    char line[96];
+    char* end = line;
+    uint16_t leaderboard[LEADERBOARD_SIZE];
+    uint8_t count;
+
+    switch(export_state)
+    {
+        case EXPORT_HISTOGRAM:
+            end += sprintf(end, "histogram,%u,%lu", export_session_number, (unsigned long) HISTOGRAM_BIN_WIDTH);
+
+            for(count = 0; count < HISTOGRAM_BINS; count++)
+            {
+                end += sprintf(end, ",%u", export_histogram[count]);
+            }
+
+            strcpy(end, "\r\n");
+
+            if(export_line(line))
+            {
+                export_state = EXPORT_LEADERBOARD;
+            }
+
+            break;
+
+        case EXPORT_LEADERBOARD:
+            end += sprintf(end, "leaderboard");
+
+            eeprom_cache_read_block(leaderboard, scores_eeprom.leaderboard, sizeof(leaderboard));
+
+            for(count = 0; (count < LEADERBOARD_SIZE) && (leaderboard[count] != LEADERBOARD_EMPTY); count++)
+            {
+                end += sprintf(end, ",%lu", leaderboard[count] * 10UL);
+            }
+
+            strcpy(end, "\r\n");
+
+            if(export_line(line))
+            {
+                export_state = EXPORT_IDLE;
+            }
+
+            break;
+
+        default:
+            if(export_active && uart_tx_idle())
+            {
+                uart_disable();
+                export_active = false;
+            }
+
+            break;
+    }
+
+    return;
+}
+
+//print a time given in units of 10us as ms with two decimals (6 characters)
+void lcd_print_time(uint16_t time, char loc)
+{
+    char array[8];
+
+    sprintf(array, "%3u.%02u", time/100, time%100);
+    lcd_print_string(array, 6, loc);
+
+    return;
+}
+
+//actions of the application state machine (called by fsm_run() in task2)
+//players join on the instructions screen
+void instructions_enter(void)
+{
+    players_joined = 0;
+
+    return;
+}
+
+//start a trial (SW1 on the instructions screen)
+void trial_start(void)
+{
+    //random wait, the time at which SW1 was released reseeds the lfsr
+    //(set before the state changes, the timer2 ISR only counts in the WAIT state)
+    random_state ^= TCNT1;
+    wait_target = WAIT_MIN + (random_next() % WAIT_RANGE);
+    wait_duration = 0;
+    time_count = 0;
+    sw2_pressed = false;
+    reaction_too_slow = false;
+
+    //start sampling the switches of a multiplayer game (presses during the wait are cheats)
+    multiplayer = ((players_joined & ~SW2_PLAYER_MASK) != 0);
+
+    if(multiplayer)
+    {
+        players_done = 0;
+        players_cheat = 0;
+        players_enable(true);
+    }
+
+    return;
 }
 
-//functions to set and reset flags
-void set_flag(uint8_t val)
+//end of the wait, the led is switched on by the timer1 compare match LED_DELAY us from now
+void led_arm(void)
 {
-    flags |= (1<<val);
+    //(the 16 bit timer1 registers share a temporary register with the input capture ISR)
+    cli();
+    OCR1A = TCNT1 + LED_DELAY;
+    hal_clear_flags(&TIFR, (1<<OCF1A));
+    TIMSK |= (1<<OCIE1A);
+    sei();
+
+    return;
 }
 
-void clear_flag(uint8_t val)
+//SW2 was pressed in advance, the led is not switched on
+//(the running state is never entered, so its exit action does not stop sampling the switches)
+void led_disarm(void)
 {
-    flags &= ~(1<<val);
+    TIMSK &= ~(1<<OCIE1A);
+    players_enable(false);
+
+    return;
 }
 
-bool is_flag_set(uint8_t val)
+//the led is on
+void running_enter(void)
 {
-    if (flags & (1<<val))
+    //every player of a multiplayer game may already have pressed (cheats)
+    if(multiplayer && (players_done == players_joined))
     {
-        return (true);
+        fsm_post(&app_fsm, SW2_EVENT);
     }
 
-    else
+    return;
+}
+
+//end of the trial
+void running_exit(void)
+{
+    //stop sampling the switches
+    players_enable(false);
+    //stop counting the time
+    led_on = false;
+    //turn off led
+    PORTC &= ~(1<<PC0);
+
+    return;
+}
+
+//a single player trial in time is added to the session and the leaderboard and sent
+void trial_record(void)
+{
+    if(!multiplayer)
     {
-        return (false);
+        session_add(reaction_us);
+        trial_rank = leaderboard_add((reaction_us + 5)/10);
+        export_trial(reaction_us);
     }
+
+    return;
 }
 
+//no reaction within 400ms
+void trial_too_slow(void)
+{
+    reaction_too_slow = true;
+
+    return;
+}
+
+//SW1 on the results screen starts the next trial or shows the session after its last trial
+void results_next(void)
+{
+    fsm_post(&app_fsm, (session_stats.count >= SESSION_TRIALS) ? SESSION_DONE : NEXT_TRIAL);
+
+    return;
+}
 
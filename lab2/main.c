@@ -9,10 +9,12 @@ button_0 is connected to PC2
 botton_1 is connected to PD2
 button_2 is connected to PD3
 R_0 (1Kohm) is connected to PD5
-R_1 (1Kohm) is connected to PC1
+R_1 (10Kohm) is connected to PC1
+R_2 (100Kohm) is connected to PD4
 
 Frequency measurement probe is connected to AIN1
-Voltage and resistance measurement probe is connected to PC0
+Voltage, resistance and capacitance measurement probe is connected to PC0
+(for true rms measurement the signal is connected to both probes, AIN1 provides the period synchronisation)
 */
 
 
@@ -25,12 +27,104 @@ Voltage and resistance measurement probe is connected to PC0
 //timer1 capture vector
 ISR (TIMER1_CAPT_vect)
 {
+    //capacitance measurement, the capacitor has been charged to VCC/2
+    if(app_state == CAPACITANCE)
+    {
+        uint16_t capture = ICR1;
+        uint16_t overflows = cap_overflows;
+
+        //an overflow that happened before the capture may still be pending
+        if((TIFR1 & (1<<TOV1)) && (capture < 0x8000))
+        {
+            overflows++;
+        }
+
+        cap_counts = (((uint32_t) overflows) << 16) | capture;
+        set_flag(CAP_CHARGED);
+
+        return;
+    }
+
+    //logic analyzer, store the time since the previous edge
+    //estimated cost is about 120 cycles for a 1 byte delta (edges down to about 15us apart are recorded)
+    if(app_state == LOGIC)
+    {
+        uint16_t capture = ICR1;
+        uint16_t overflows = logic_overflows;
+        uint16_t index = logic_index;
+        uint32_t time;
+        uint32_t delta;
+
+        //capture the opposite edge next, the capture flag has to be cleared after changing the edge
+        TCCR1B ^= (1<<ICES1);
+        hal_clear_flags(&TIFR1, (1<<ICF1));
+
+        if(logic_state != LOGIC_CAPTURE)
+        {
+            return;
+        }
+
+        //an overflow that happened before the capture may still be pending
+        if((TIFR1 & (1<<TOV1)) && (capture < 0x8000))
+        {
+            overflows++;
+        }
+
+        time = (((uint32_t) overflows) << 16) | capture;
+        delta = time - logic_last_time;
+        logic_last_time = time;
+
+        while(delta >= 0x80)
+        {
+            logic_buffer[index++] = (uint8_t) (delta | 0x80);
+            delta >>= 7;
+        }
+
+        logic_buffer[index++] = (uint8_t) delta;
+        logic_index = index;
+        logic_edges++;
+
+        if(index > (LOGIC_BUFFER_SIZE - LOGIC_MAX_VARINT))
+        {
+            logic_state = LOGIC_DONE;
+        }
+
+        return;
+    }
+
+    //true rms measurement, windows start and end on a rising edge (whole number of signal periods)
+    //the frequency is measured as well, it is used for autoranging the timer1 prescaler
+    if(app_state == AC_RMS)
+    {
+        if(ac_state == AC_WAIT_EDGE)
+        {
+            ac_count = 0;
+            ac_synced = true;
+            ac_state = AC_ACQUIRE;
+        }
+
+        else if((ac_state == AC_ACQUIRE) && (ac_count >= AC_MIN_SAMPLES))
+        {
+            ac_state = AC_DONE;
+        }
+    }
+
     //reset timer1 count value
     TCNT1 = 0;
     //record the timer1 capture value
     tick_val = ICR1;
-    //calculate frequency
-    frequency = F_CPU/(prescaler*tick_val);
+
+    //add the period to the periods of the current display period (the frequency is calculated by measurement_task)
+    if(frequency_discard)
+    {
+        frequency_discard = false;
+    }
+
+    else
+    {
+        frequency_ticks += tick_val;
+        frequency_periods++;
+    }
 
     return;
 }
@@ -38,11 +132,28 @@ ISR (TIMER1_CAPT_vect)
 //timer1 overflow vector
 ISR(TIMER1_OVF_vect)
 {
+    //capacitance measurement, extend timer1 to 32 bits
+    if(app_state == CAPACITANCE)
+    {
+        cap_overflows++;
+
+        return;
+    }
+
+    //logic analyzer, extend timer1 to 32 bits
+    if(app_state == LOGIC)
+    {
+        logic_overflows++;
+
+        return;
+    }
+
     //avoid timer1 overflow interrupt before input capture interrupt by increasing the prescaler value
     //set INCREASE_PRESCALER flag
     set_flag(INCREASE_PRESCALER);
-    //set frequency to 0
-    frequency = 0;
+    //the period is lost (the frequency is 0 if no whole period is captured during the display period)
+    frequency_overflow = true;
+    frequency_discard = true;
 
     return;
 }
@@ -50,42 +161,187 @@ ISR(TIMER1_OVF_vect)
 //timer 2 interrupt on compare match
 ISR (TIMER2_COMPA_vect)
 {
-    if(button_time_count > 0)
+    scheduler_tick();
+
+    return;
+}
+
+//ADC interrupt vector
+ISR(ADC_vect)
+{
+    //oscilloscope capture, 8 bit samples in free running mode
+    if(app_state == SCOPE)
     {
-        button_time_count--;
+        uint8_t sample = ADCH;
+
+        //the conversion that was running when the capture completed is dropped
+        if(scope_state == SCOPE_DONE)
+        {
+            return;
+        }
+
+        scope_buffer[scope_index] = sample;
+
+        if(++scope_index == SCOPE_BUFFER_SIZE)
+        {
+            scope_index = 0;
+        }
+
+        if(scope_state == SCOPE_POST_TRIGGER)
+        {
+            if(--scope_remaining == 0)
+            {
+                //capture complete, the oldest sample is at scope_index
+                ADCSRA &= ~(1<<ADATE);
+                scope_state = SCOPE_DONE;
+            }
+        }
+
+        else if(scope_state == SCOPE_WAIT_TRIGGER)
+        {
+            if(((scope_trigger_edge == SCOPE_RISING) && (scope_previous < scope_trigger_level) && (sample >= scope_trigger_level)) ||
+               ((scope_trigger_edge == SCOPE_FALLING) && (scope_previous > scope_trigger_level) && (sample <= scope_trigger_level)))
+            {
+                //SCOPE_PRE_TRIGGER samples before the trigger sample are kept
+                scope_remaining = SCOPE_BUFFER_SIZE - SCOPE_PRE_TRIGGER - 1;
+                scope_state = SCOPE_POST_TRIGGER;
+            }
+        }
+
+        else if(--scope_remaining == 0)
+        {
+            //pre-trigger samples acquired, the trigger is armed
+            scope_state = SCOPE_WAIT_TRIGGER;
+        }
+
+        scope_previous = sample;
+
+        return;
     }
 
-    if(button_event_handler_time_count > 0)
+    //timer0 count at ISR entry (used by the ISR profiler)
+    uint8_t isr_start = TCNT0;
+
+    //clear the timer0 compare flag, the next compare match then triggers a new conversion
+    hal_clear_flags(&TIFR0, (1<<OCF0A));
+
+    //discard conversions while the reference settles
+    if(adc_discard_samples > 0)
     {
-        button_event_handler_time_count--;
+        adc_discard_samples--;
+
+        return;
     }
 
-    if(measurement_time_count > 0)
+    //true rms measurement, every sample is added to the window
+    //estimated cost is roughly 200 cycles (25us) including prologue and epilogue, 800 cycles are available per sample at 10kSa/s
+    //adc_isr_ticks_max holds the measured worst case
+    if(app_state == AC_RMS)
     {
-        measurement_time_count --;
+        uint16_t sample = ADC;
+
+        if(ac_state == AC_ACQUIRE)
+        {
+            ac_sum += sample;
+            ac_sum_sq += ((uint32_t) sample) * sample;
+
+            if(sample < ac_min)
+            {
+                ac_min = sample;
+            }
+
+            if(sample > ac_max)
+            {
+                ac_max = sample;
+            }
+
+            //close the window before the sum of squares can overflow
+            if(++ac_count == AC_MAX_SAMPLES)
+            {
+                ac_synced = false;
+                ac_state = AC_DONE;
+            }
+        }
+
+        else if(ac_state == AC_WAIT_EDGE)
+        {
+            //no rising edge (dc or very slow signal), start an unsynchronised window
+            if(++ac_count == AC_MAX_SAMPLES)
+            {
+                ac_count = 0;
+                ac_synced = false;
+                ac_state = AC_ACQUIRE;
+            }
+        }
     }
 
-    if(autoranging_time_count > 0)
+    //tone detection, every sample of the block is fed to the goertzel bins (see TONE_BINS_PER_BLOCK for the cycle budget)
+    else if(app_state == TONE)
     {
-        autoranging_time_count --;
+        if(tone_state == TONE_ACQUIRE)
+        {
+            uint16_t code = ADC;
+            //the dc offset is removed, so that the rounding of the bins does not let it leak into the lowest bins
+            int16_t sample = ((int16_t) code) - tone_offset;
+            uint8_t count;
+
+            tone_sum += code;
+
+            if(code > tone_peak)
+            {
+                tone_peak = code;
+            }
+
+            for(count = 0; count < TONE_BINS_PER_BLOCK; count++)
+            {
+                goertzel_update(&tone_bins[count], sample);
+            }
+
+            if(++tone_count == TONE_BLOCK_SIZE)
+            {
+                tone_state = TONE_DONE;
+            }
+        }
     }
 
-    if(lcd_time_count > 0)
+    //ac rms and tone detection use every sample, there are no blocks
+    if((app_state == AC_RMS) || (app_state == TONE))
     {
-        lcd_time_count --;
+        //timer0 runs at 1MHz and is cleared on every trigger, so the difference is the ISR duration in us
+        uint8_t isr_end = TCNT0;
+        adc_isr_ticks = (isr_end >= isr_start) ? (isr_end - isr_start) : (isr_end + OCR0A + 1 - isr_start);
+
+        if(adc_isr_ticks > adc_isr_ticks_max)
+        {
+            adc_isr_ticks_max = adc_isr_ticks;
+        }
+
+        return;
     }
 
-    return;
-}
+    //add the sample to the current block
+    adc_accumulator += ADC;
 
-//ADC interrupt vector
-ISR(ADC_vect)
-{
-    //read ADC value
-    adcl = (uint16_t) ADCL;
-    adch = ((uint16_t) ADCH) * 256;
-    //calculate the value of voltage
-    new_voltage = ((adch + adcl)*vref)/1023.0;
+    if(--adc_samples_remaining == 0)
+    {
+        //block complete, store the decimated value in the ring buffer
+        uint8_t next_head = (adc_block_head + 1) & (ADC_BLOCK_BUFFER_SIZE - 1);
+
+        if(next_head != adc_block_tail)
+        {
+            adc_blocks[adc_block_head] = adc_accumulator >> adc_oversample_bits;
+            adc_block_head = next_head;
+        }
+
+        else
+        {
+            adc_block_overruns++;
+        }
+
+        //start a new block
+        adc_accumulator = 0;
+        adc_samples_remaining = (1 << (2*adc_oversample_bits));
+    }
 
     return;
 }
@@ -115,6 +371,11 @@ int main(void)
             measurement_task();
         }
 
+        if(acquisition_time_count == 0)
+        {
+            acquisition_task();
+        }
+
         if(autoranging_time_count == 0)
         {
             autoranging_task();
@@ -124,6 +385,33 @@ int main(void)
         {
             lcd_task();
         }
+
+        if(calibration_time_count == 0)
+        {
+            calibration_task();
+        }
+
+        if(mode_time_count == 0)
+        {
+            mode_task();
+        }
+
+        if(command_time_count == 0)
+        {
+            command_task();
+        }
+
+        if(log_time_count == 0)
+        {
+            log_task();
+        }
+
+        if(settings_time_count == 0)
+        {
+            settings_task();
+        }
+
+        HAL_IDLE();
     }
 
     return (0);
@@ -131,11 +419,103 @@ int main(void)
 
 
 //______Functions_______
+//scheduler
+//update the countdown of every task (called every 1ms from the timer2 ISR)
+void scheduler_tick(void)
+{
+    if(button_time_count > 0)
+    {
+        button_time_count--;
+    }
+
+    if(button_event_handler_time_count > 0)
+    {
+        button_event_handler_time_count--;
+    }
+
+    time_ms++;
+
+    if(measurement_time_count > 0)
+    {
+        measurement_time_count --;
+    }
+
+    if(acquisition_time_count > 0)
+    {
+        acquisition_time_count --;
+    }
+
+    if(autoranging_time_count > 0)
+    {
+        autoranging_time_count --;
+    }
+
+    if(lcd_time_count > 0)
+    {
+        lcd_time_count --;
+    }
+
+    if(mode_time_count > 0)
+    {
+        mode_time_count --;
+    }
+
+    if(command_time_count > 0)
+    {
+        command_time_count --;
+    }
+
+    if(log_time_count > 0)
+    {
+        log_time_count --;
+    }
+
+    if(settings_time_count > 0)
+    {
+        settings_time_count --;
+    }
+
+    if(calibration_time_count > 0)
+    {
+        calibration_time_count --;
+    }
+
+    return;
+}
+
+//account for time during which timer2 was halted (e.g. while sleeping in SLEEP_MODE_ADC)
+//missed ticks are replayed and the remainder is added to TCNT2, so no scheduler time is lost
+void scheduler_compensate(uint16_t lost_us)
+{
+    uint16_t count;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        count = TCNT2 + (lost_us / TIMER2_COUNT_US);
+
+        while(count > OCR2A)
+        {
+            scheduler_tick();
+            count -= (OCR2A + 1);
+        }
+
+        TCNT2 = count;
+    }
+
+    return;
+}
+
 void init(void)
 {
+    //settings were restored from EEPROM
+    bool restored;
+
     //initialize lcd
     lcd_init();
 
+    //twi and spi are not used, the peripherals of the measurement modes are switched by select_app_state()
+    PRR |= POWER_ALWAYS_OFF;
+
     //configure timer1 for input capture
     //enable input capture noise canceller and set input edge capture (positive edge)
     TCCR1B |= ((1<<ICNC1)|(1<<ICES1));
@@ -168,29 +548,64 @@ void init(void)
     //enable ADC iterrupt flag "ADIE"
     //set adc prescaler to 64 (ADPS2 = 1 and ADPS1 = 1)
     ADCSRA |= ((1<<ADEN) | (1<<ADIE) | (1<<ADPS2) | (1<<ADPS1));
+    //auto trigger source is timer0 compare match A (ADTS2:0 = 011)
+    //auto triggering itself (ADATE) is only enabled by adc_start()
+    ADCSRB |= ((1<<ADTS1) | (1<<ADTS0));
+    //set up the filter of the default app state
+    measurement_filter_reset();
+
+    //serial port (used to send telemetry and captures and to receive remote commands)
+    uart_init(UART_UBRR(UART_BAUD));
+    uart_rx_enable();
+
+    //set up default oversampling and output rate
+    adc_configure(ADC_OVERSAMPLE_BITS, ADC_OUTPUT_RATE);
+
+    //load calibration data from EEPROM
+    calibration_load();
+    //user calibration of the bandgap if button 0 is held down at power up
+    if(~BUTTON_0_PORT & (1<<BUTTON_0_LOC))
+    {
+        calibration_user_bandgap();
+    }
+    //measure AVCC
+    calibration_measure_avcc();
+    //find the newest page of the measurement log
+    log_init();
+    //restore the mode and the ranges used before the last power down
+    restored = settings_load();
 
     //IO pins to which buttons are connected are configured as inputs by default (DDRX = 0)
     //external pull-up resistors need to be connected
 
     //enable R_0 by default for resistance measurement
-    R_0_CONFIG |= (1<<R_0_LOC);
-    R_0_PORT |= (1<<R_0_LOC);
-
-    //print initial message to lcd
-    lcd_print_string_progmem(initial_message, 16, 0x80);
-    lcd_print_string_progmem(&(initial_message[16]), 16, 0xC0);
-    delayms(2000);
+    *ref_resistors[ref_resistance].config |= (1<<ref_resistors[ref_resistance].loc);
+    *ref_resistors[ref_resistance].port |= (1<<ref_resistors[ref_resistance].loc);
 
     //display initial default app state on lcd
     //set APP_STATE_CHANGE flag
     set_flag(APP_STATE_CHANGE);
     //enable autoranging by default
     set_flag(AUTORANGING);
+    //switch to the restored mode and ranges (or keep the defaults)
+    settings_apply();
+
+    //print initial message to lcd at the first power up
+    //(the lcd task starts after it, the measurements do not wait)
+    if(!restored)
+    {
+        lcd_print_string_progmem(initial_message, 16, 0x80);
+        lcd_print_string_progmem(&(initial_message[16]), 16, 0xC0);
+        lcd_time_count = SPLASH_MS;
+    }
     //set RANGE_DISPLAY_UPDATE flag
     set_flag(RANGE_DISPLAY_UPDATE);
     //set UPDATE_LCD flag
     set_flag(UPDATE_LCD);
 
+    //user interface state machine (button events)
+    fsm_init(&ui_fsm, &ui_transitions[0][0], ui_states, NUM_UI_EVENTS, UI_MEASURE);
+
     //enable global interrupts
     sei();
 
@@ -212,6 +627,7 @@ void button_task(void)
             if(~BUTTON_0_PORT & (1<<BUTTON_0_LOC))
             {
                 button_0_push_state = MAY_BE_PUSH;
+                button_0_hold_count = 0;
             }
 
             else
@@ -242,6 +658,15 @@ void button_task(void)
             if(~BUTTON_0_PORT & (1<<BUTTON_0_LOC))
             {
                 button_0_push_state = PUSH;
+
+                //the long press event is set once while the button is still held
+                if(button_0_hold_count < BUTTON_LONG_PRESS)
+                {
+                    if(++button_0_hold_count == BUTTON_LONG_PRESS)
+                    {
+                        fsm_post(&ui_fsm, BUTTON_0_LONG_EVENT);
+                    }
+                }
             }
 
             else
@@ -264,7 +689,11 @@ void button_task(void)
                 button_0_push_state = NO_PUSH;
 
                 //button 0 has been pushed and released (change app_state)
-                set_flag(BUTTON_0_EVENT);
+                //(there is no release event after a long press)
+                if(button_0_hold_count < BUTTON_LONG_PRESS)
+                {
+                    fsm_post(&ui_fsm, BUTTON_0_EVENT);
+                }
             }
 
             break;
@@ -279,6 +708,7 @@ void button_task(void)
             if(~BUTTON_1_PORT & (1<<BUTTON_1_LOC))
             {
                 button_1_push_state = MAY_BE_PUSH;
+                button_1_hold_count = 0;
             }
 
             else
@@ -309,6 +739,15 @@ void button_task(void)
             if(~BUTTON_1_PORT & (1<<BUTTON_1_LOC))
             {
                 button_1_push_state = PUSH;
+
+                //the long press event is set once while the button is still held
+                if(button_1_hold_count < BUTTON_LONG_PRESS)
+                {
+                    if(++button_1_hold_count == BUTTON_LONG_PRESS)
+                    {
+                        fsm_post(&ui_fsm, BUTTON_1_LONG_EVENT);
+                    }
+                }
             }
 
             else
@@ -331,7 +770,11 @@ void button_task(void)
                 button_1_push_state = NO_PUSH;
 
                 //button 1 has been pushed and released (toggle autoranging)
-                set_flag(BUTTON_1_EVENT);
+                //(there is no release event after a long press)
+                if(button_1_hold_count < BUTTON_LONG_PRESS)
+                {
+                    fsm_post(&ui_fsm, BUTTON_1_EVENT);
+                }
             }
 
             break;
@@ -346,6 +789,7 @@ void button_task(void)
             if(~BUTTON_2_PORT & (1<<BUTTON_2_LOC))
             {
                 button_2_push_state = MAY_BE_PUSH;
+                button_2_hold_count = 0;
             }
 
             else
@@ -376,6 +820,15 @@ void button_task(void)
             if(~BUTTON_2_PORT & (1<<BUTTON_2_LOC))
             {
                 button_2_push_state = PUSH;
+
+                //the long press event is set once while the button is still held
+                if(button_2_hold_count < BUTTON_LONG_PRESS)
+                {
+                    if(++button_2_hold_count == BUTTON_LONG_PRESS)
+                    {
+                        fsm_post(&ui_fsm, BUTTON_2_LONG_EVENT);
+                    }
+                }
             }
 
             else
@@ -397,10 +850,11 @@ void button_task(void)
             {
                 button_2_push_state = NO_PUSH;
 
-                //button 2 has been pushed and released (change measurement range)
-                if(!is_flag_set(AUTORANGING))
+                //button 2 has been pushed and released (change measurement range or select a menu setting)
+                //(there is no release event after a long press)
+                if(button_2_hold_count < BUTTON_LONG_PRESS)
                 {
-                    set_flag(BUTTON_2_EVENT);
+                    fsm_post(&ui_fsm, BUTTON_2_EVENT);
                 }
             }
 
@@ -412,483 +866,3544 @@ void button_task(void)
 //this task is used to handle button events
 void button_event_handler_task(void)
 {
-    if(is_flag_set(BUTTON_0_EVENT))
-    {
-        //update app_state
-        if(app_state < 2)
-        {
-            app_state++;
-        }
+    //reset the value of button_event_handler_time_count
+    button_event_handler_time_count = BUTTON_EVENT_HANDLER_TIMEOUT;
 
-        else
-        {
-            app_state = 0;
-        }
+    //handle the queued button events (ui_transitions)
+    fsm_run(&ui_fsm);
+}
 
-        //if app_state changed to RESISTANCE,
-        //set the ADC reference voltage to 5.0V by default
-        if(app_state == RESISTANCE)
-        {
-            if(vref == 1.1)
+//user interface actions (called by fsm_run() in button_event_handler_task)
+//change to the next app_state
+void mode_next(void)
+{
+    select_app_state((app_state < NUM_APP_STATES - 1) ? (app_state + 1) : 0);
+
+    return;
+}
+
+//toggle autoranging
+void autoranging_toggle(void)
+{
+    toggle_flag(AUTORANGING);
+    //set RANGE_DISPLAY_UPDATE flag
+    set_flag(RANGE_DISPLAY_UPDATE);
+    //set UPDATE_LCD flag
+    set_flag(UPDATE_LCD);
+
+    return;
+}
+
+//change measurement range (only while autoranging is off)
+void range_next(void)
+{
+    if(is_flag_set(AUTORANGING))
+    {
+        return;
+    }
+
+    //cycle through the ranges of the current mode (the logic analyzer starts a new capture instead)
+    MODE_HOOK(next_range)();
+
+    //update range display on lcd
+    set_flag(RANGE_DISPLAY_UPDATE);
+    //set UPDATE_LCD flag
+    set_flag(UPDATE_LCD);
+
+    return;
+}
+
+//start new statistics, the hold and relative views take the current reading
+void stats_restart(void)
+{
+    if(stats_available())
+    {
+        stats_reset(&measurement_stats);
+        stats_select_view(stats_view);
+    }
+
+    return;
+}
+
+//cycle through the statistics views
+void stats_next_view(void)
+{
+    if(stats_available())
+    {
+        stats_select_view((stats_view + 1) % NUM_STATS_VIEWS);
+    }
+
+    return;
+}
+
+//the menu replaces the screen of the current mode, measurements continue
+void menu_enter(void)
+{
+    set_flag(APP_STATE_CHANGE);
+    //set UPDATE_LCD flag
+    set_flag(UPDATE_LCD);
+
+    return;
+}
+
+//redraw the screen of the current mode
+void menu_exit(void)
+{
+    set_flag(APP_STATE_CHANGE);
+    set_flag(MEASURED_VALUE_CHANGE);
+    set_flag(RANGE_DISPLAY_UPDATE);
+
+    if(app_state == DUAL)
+    {
+        set_flag(FREQUENCY_VALUE_CHANGE);
+    }
+
+    //set UPDATE_LCD flag
+    set_flag(UPDATE_LCD);
+
+    return;
+}
+
+//cycle through the available display rates (used from the next reading on)
+void display_rate_next(void)
+{
+    display_rate = (display_rate + 1) % NUM_DISPLAY_RATES;
+    //set UPDATE_LCD flag
+    set_flag(UPDATE_LCD);
+
+    return;
+}
+
+//toggle the measurement logger
+void log_toggle(void)
+{
+    log_start((log_interval == 0) ? LOG_DEFAULT_INTERVAL : 0);
+    //set UPDATE_LCD flag
+    set_flag(UPDATE_LCD);
+
+    return;
+}
+
+//change the application state (the quantity being measured)
+//the peripherals used by the old mode are restored before the new mode is set up
+void select_app_state(uint8_t state)
+{
+    //restore the peripherals used by the old mode (comparator, adc clock, timer1 prescaler ...)
+    MODE_HOOK(exit)();
+
+    //remember the range of the old mode
+    mode_ranges[app_state] = mode_range();
+
+    //update app_state
+    app_state = state;
+
+    //power up the peripherals of the new mode and shut down the others before the new mode is set up
+    power_select(pgm_read_byte(&modes[app_state].power));
+    MODE_HOOK(enter)();
+
+    //start in the range last used in the new mode (autoranging starts from there)
+    select_range(mode_ranges[app_state]);
+
+    //start filtering with the settings of the new mode
+    measurement_filter_reset();
+    //start new statistics, the live reading is shown first
+    stats_reset(&measurement_stats);
+    stats_view = STATS_LIVE;
+    //periods captured in the old mode are not used
+    frequency_restart();
+
+    //enable auto ranging by default
+    set_flag(AUTORANGING);
+    //set APP_STATE_CHANGE flag
+    set_flag(APP_STATE_CHANGE);
+    //set RANGE_DISPLAY_UPDATE flag
+    set_flag(RANGE_DISPLAY_UPDATE);
+    //set UPDATE_LCD flag
+    set_flag(UPDATE_LCD);
+
+    return;
+}
+
+//power up the peripherals of the current mode (POWER_ bits) and shut down the other switchable ones
+//free running acquisition is stopped and the adc is disabled before they are shut down
+//(a module keeps its registers while it is shut down, but they cannot be written)
+void power_select(uint8_t power)
+{
+    uint8_t shut_down = POWER_SWITCHED & ~power;
+
+    if(shut_down & (POWER_ADC | POWER_TIMER0))
+    {
+        adc_stop();
+    }
+
+    if(shut_down & POWER_ADC)
+    {
+        ADCSRA &= ~(1<<ADEN);
+    }
+
+    PRR = (PRR & ~POWER_SWITCHED) | shut_down;
+
+    if(power & POWER_ADC)
+    {
+        ADCSRA |= (1<<ADEN);
+    }
+
+    return;
+}
+
+//hook of a mode that has nothing to do
+void mode_nothing(void)
+{
+    return;
+}
+
+//select a range of the current mode (the buttons cycle through the ranges, remote commands select one directly)
+//returns false if the range does not exist in the current mode
+bool select_range(uint8_t range)
+{
+    if(!MODE_HOOK(set_range)(range))
+    {
+        return (false);
+    }
+
+    //update range display on lcd
+    set_flag(RANGE_DISPLAY_UPDATE);
+    //set UPDATE_LCD flag
+    set_flag(UPDATE_LCD);
+
+    return (true);
+}
+
+//range of the current mode (the argument of select_range)
+uint8_t mode_range(void)
+{
+    return (MODE_HOOK(get_range)());
+}
+
+//range hooks of the modes
+//set_range returns false if the range does not exist, next_range cycles through the ranges (button 2)
+bool frequency_set_range(uint8_t range)
+{
+    if(range >= sizeof(prescaler_values)/sizeof(prescaler_values[0]))
+    {
+        return (false);
+    }
+
+    frequency_select_prescaler(range);
+
+    return (true);
+}
+
+uint8_t frequency_get_range(void)
+{
+    return (prescaler_index);
+}
+
+void frequency_next_range(void)
+{
+    //cycle through the available "prescaler" values
+    if(prescaler_index < ((sizeof(prescaler_values)/sizeof(prescaler_values[0]))-1))
+    {
+        //increase prescaler
+        frequency_select_prescaler(prescaler_index + 1);
+    }
+
+    else
+    {
+        //reset prescaler to initial value
+        frequency_select_prescaler(0);
+    }
+
+    return;
+}
+
+//the voltage, dual, ac rms and tone modes select the adc reference
+//(the frequency of dual and ac rms mode is always autoranged)
+bool vref_set_range(uint8_t range)
+{
+    if(range > RANGE_VREF_1V1)
+    {
+        return (false);
+    }
+
+    adc_select_vref(range);
+
+    return (true);
+}
+
+uint8_t vref_get_range(void)
+{
+    return (vref_range);
+}
+
+void vref_next_range(void)
+{
+    //cycle through the available vref values
+    adc_select_vref((vref_range == RANGE_VREF_5V0) ? RANGE_VREF_1V1 : RANGE_VREF_5V0);
+
+    return;
+}
+
+bool resistance_set_range(uint8_t range)
+{
+    if(range >= NUM_REF_RESISTORS)
+    {
+        return (false);
+    }
+
+    select_ref_resistor(range);
+
+    return (true);
+}
+
+uint8_t resistance_get_range(void)
+{
+    return (ref_resistance);
+}
+
+void resistance_next_range(void)
+{
+    //cycle through the available reference resistors
+    select_ref_resistor((ref_resistance + 1) % NUM_REF_RESISTORS);
+
+    return;
+}
+
+bool capacitance_set_range(uint8_t range)
+{
+    if(range >= NUM_REF_RESISTORS)
+    {
+        return (false);
+    }
+
+    capacitance_select_range(range);
+
+    return (true);
+}
+
+uint8_t capacitance_get_range(void)
+{
+    return (cap_range);
+}
+
+void capacitance_next_range(void)
+{
+    //cycle through the available capacitance ranges
+    capacitance_select_range((cap_range + 1) % NUM_REF_RESISTORS);
+
+    return;
+}
+
+bool scope_set_range(uint8_t range)
+{
+    if(range >= NUM_SCOPE_TIMEBASES)
+    {
+        return (false);
+    }
+
+    scope_select_timebase(range);
+
+    return (true);
+}
+
+uint8_t scope_get_range(void)
+{
+    return (scope_timebase);
+}
+
+void scope_next_range(void)
+{
+    //cycle through the available timebases
+    scope_select_timebase((scope_timebase + 1) % NUM_SCOPE_TIMEBASES);
+
+    return;
+}
+
+//the logic analyzer has no ranges (button 2 starts a new capture)
+bool no_range_set(uint8_t range)
+{
+    (void) range;
+
+    return (false);
+}
+
+uint8_t no_range_get(void)
+{
+    return (0);
+}
+
+//set up resistance measurement, the ADC reference voltage is 5.0V by default
+void resistance_enter(void)
+{
+    adc_select_vref(RANGE_VREF_5V0);
+    //(re)start acquisition so that no block mixes samples from two modes
+    adc_start();
+
+    return;
+}
+
+//this task is used to measure frequency, voltage and resistance
+//in dual mode frequency and voltage are measured in the same period
+//(timer1 input capture and the timer0 triggered adc run independently)
+void measurement_task(void)
+{
+    //reset measurement_time_count (one reading per display period)
+    measurement_time_count = display_periods[display_rate];
+
+    //reading of the current mode
+    MODE_HOOK(sample)();
+
+    return;
+}
+
+//frequency of all periods captured since the last reading (frequency, dual and ac rms mode)
+void frequency_measure(void)
+{
+    uint32_t ticks;
+
+    frequency = frequency_read(&ticks);
+    telemetry_send(FREQUENCY, prescaler_index, ticks, frequency);
+
+    return;
+}
+
+void frequency_sample(void)
+{
+    frequency_measure();
+
+    stats_update(&measurement_stats, frequency);
+    filtered_frequency = filter_update(&measurement_channel.filter, frequency);
+
+    //if the filtered frequency changed by more than the threshold, update it on lcd screen
+    //(the statistics views change with every reading)
+    if(measurement_filter_changed(&measurement_channel, FREQUENCY, filtered_frequency) || (stats_view != STATS_LIVE))
+    {
+        //set MEASURED_VALUE_CHANGE
+        set_flag(MEASURED_VALUE_CHANGE);
+        //set UPDATE_LCD flag
+        set_flag(UPDATE_LCD);
+    }
+
+    return;
+}
+
+void dual_sample(void)
+{
+    frequency_measure();
+
+    filtered_frequency = filter_update(&frequency_channel.filter, frequency);
+
+    if(measurement_filter_changed(&frequency_channel, FREQUENCY, filtered_frequency))
+    {
+        //set FREQUENCY_VALUE_CHANGE
+        set_flag(FREQUENCY_VALUE_CHANGE);
+        //set UPDATE_LCD flag
+        set_flag(UPDATE_LCD);
+    }
+
+    voltage_sample();
+
+    return;
+}
+
+void ac_rms_sample(void)
+{
+    frequency_measure();
+    ac_rms_update();
+
+    return;
+}
+
+//reading of the voltage, resistance and dual mode, the average of the filtered blocks of the display period
+//returns false if no block was completed
+bool adc_reading(uint16_t* code)
+{
+    //the usart stops with clkIO during the burst, a free running block is acquired instead while a byte is sent
+    //or a request is partly received
+    if(adc_precision_selected() && uart_tx_idle() && !uart_rx_busy())
+    {
+        //acquire a block with the cpu asleep
+        adc_precision_burst();
+    }
+
+    else if(~ADCSRA & (1<<ADATE))
+    {
+        //precision mode was left, resume free running acquisition
+        adc_start();
+    }
+
+    adc_collect_blocks();
+
+    if(adc_reading_blocks == 0)
+    {
+        return (false);
+    }
+
+    *code = (adc_reading_sum + (adc_reading_blocks >> 1)) / adc_reading_blocks;
+    adc_reading_sum = 0;
+    adc_reading_blocks = 0;
+
+    new_voltage = adc_code_to_uv(*code);
+
+    if(stats_available() && (stats_view != STATS_LIVE))
+    {
+        //the statistics views change with every block
+        set_flag(MEASURED_VALUE_CHANGE);
+        set_flag(UPDATE_LCD);
+    }
+
+    return (true);
+}
+
+void voltage_sample(void)
+{
+    uint16_t code;
+
+    if(!adc_reading(&code))
+    {
+        return;
+    }
+
+    //voltage autoranging is done on every new reading (instead of in autoranging_task)
+    //after a reference switch the reading is dropped, the next period then shows a settled value
+    if((measurement_quantity() == VOLTAGE) && is_flag_set(AUTORANGING))
+    {
+        uint8_t index = (vref_range == voltage_autorange_ranges[0]) ? 0 : 1;
+        uint8_t new_index = autorange_select(voltage_autorange_table, 2, index, new_voltage);
+
+        if(new_index != index)
+        {
+            adc_select_vref(voltage_autorange_ranges[new_index]);
+            //update range display on lcd
+            set_flag(RANGE_DISPLAY_UPDATE);
+            //set UPDATE_LCD flag
+            set_flag(UPDATE_LCD);
+
+            return;
+        }
+    }
+
+    //only update the display if the filtered value moved by more than the threshold
+    if(measurement_filter_changed(&measurement_channel, measurement_quantity(), code))
+    {
+        voltage = new_voltage;
+
+        //set MEASURED_VALUE_CHANGE
+        set_flag(MEASURED_VALUE_CHANGE);
+        //set UPDATE_LCD flag
+        set_flag(UPDATE_LCD);
+    }
+
+    return;
+}
+
+void resistance_sample(void)
+{
+    uint16_t code;
+
+    if(!adc_reading(&code))
+    {
+        return;
+    }
+
+    //resistance autoranging is done on every new reading (instead of in autoranging_task)
+    if(is_flag_set(AUTORANGING))
+    {
+        uint8_t index = resistance_autorange(code);
+
+        if(index != ref_resistance)
+        {
+            select_ref_resistor(index);
+            //update range display on lcd
+            set_flag(RANGE_DISPLAY_UPDATE);
+            //set UPDATE_LCD flag
+            set_flag(UPDATE_LCD);
+
+            return;
+        }
+    }
+
+    //only update the display if the filtered value moved by more than the threshold
+    if(measurement_filter_changed(&measurement_channel, measurement_quantity(), code))
+    {
+        uint32_t ohm;
+
+        resistance_status = resistance_from_code(code, &ohm);
+
+        if(resistance_status == RESISTANCE_OK)
+        {
+            resistance = ohm;
+        }
+
+        //set MEASURED_VALUE_CHANGE
+        set_flag(MEASURED_VALUE_CHANGE);
+        //set UPDATE_LCD flag
+        set_flag(UPDATE_LCD);
+    }
+
+    return;
+}
+
+//this task is used to collect the decimated blocks at the rate they are produced
+//(the ring buffer only holds ADC_BLOCK_BUFFER_SIZE blocks, 80ms at the default block rate)
+//periodic task of the current mode
+void mode_task(void)
+{
+    //reset mode_time_count
+    mode_time_count = MODE_TASK_TIMEOUT;
+
+    MODE_HOOK(task)();
+
+    return;
+}
+
+void acquisition_task(void)
+{
+    //reset acquisition_time_count
+    acquisition_time_count = ACQUISITION_TIMEOUT;
+
+    //blocks of the current mode
+    MODE_HOOK(acquire)();
+
+    return;
+}
+
+//blocks are only produced by free running acquisition (precision blocks are collected by measurement_task)
+void adc_acquire(void)
+{
+    if(ADCSRA & (1<<ADATE))
+    {
+        adc_collect_blocks();
+    }
+
+    return;
+}
+
+//this task is used to perform autoranging
+void autoranging_task(void)
+{
+    //reset autoranging_time_count
+    autoranging_time_count = AUTORANGING_TIMEOUT;
+
+    //voltage and resistance autoranging is done by measurement_task on every new reading
+    //the frequency of dual and ac rms mode is always autoranged (AUTORANGING applies to the voltage)
+    MODE_HOOK(autorange)();
+
+    return;
+}
+
+//the frequency of frequency mode is only autoranged if AUTORANGING is set
+void frequency_autorange_optional(void)
+{
+    if(is_flag_set(AUTORANGING))
+    {
+        frequency_autorange();
+    }
+
+    return;
+}
+
+//select the timer1 prescaler based on the measured frequency
+void frequency_autorange(void)
+{
+    if(is_flag_set(INCREASE_PRESCALER))
+    {
+        if(prescaler_index < ((sizeof(prescaler_values)/sizeof(prescaler_values[0]))-1))
+        {
+            //increase the prescaler value, since timer1 overflows before input capture occurs
+            frequency_select_prescaler(prescaler_index + 1);
+            //update range display on lcd
+            set_flag(RANGE_DISPLAY_UPDATE);
+            //set UPDATE_LCD flag
+            set_flag(UPDATE_LCD);
+        }
+
+        //cler INCREASE_PRESCALER flag
+        clear_flag(INCREASE_PRESCALER);
+    }
+
+    else if(prescaler_index > 0)
+    {
+        if(frequency > frequency_lower[prescaler_index-1])
+        {
+            //decrease prescaler value so that frequency can be measured with higher precision
+            frequency_select_prescaler(prescaler_index - 1);
+            //update range display on lcd
+            set_flag(RANGE_DISPLAY_UPDATE);
+            //set UPDATE_LCD flag
+            set_flag(UPDATE_LCD);
+        }
+    }
+
+    return;
+}
+
+//update the prescaler value
+void frequency_select_prescaler(uint8_t index)
+{
+    if(index != prescaler_index)
+    {
+        range_switch_count[SWITCH_FREQUENCY_BASE + index]++;
+    }
+
+    prescaler_index = index;
+    prescaler = prescaler_values[prescaler_index];
+    //modify TCCR1B register to set the appropriate prescaler
+    TCCR1B &= ~(0x07);
+    TCCR1B |= (0x07 & (prescaler_index+1));
+    //periods measured with the old prescaler are not mixed with the new ones
+    frequency_restart();
+
+    return;
+}
+
+//drop the periods captured so far, the capture in progress does not give a whole period
+void frequency_restart(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        frequency_ticks = 0;
+        frequency_periods = 0;
+        frequency_discard = true;
+    }
+
+    return;
+}
+
+//reduce the periods captured since the last reading to one frequency, f = periods * F_CPU / (prescaler * ticks)
+//(periods longer than the display period keep the last frequency until timer1 overflows)
+//the sum of the periods in timer1 counts is returned in ticks
+uint32_t frequency_read(uint32_t* ticks)
+{
+    uint32_t periods;
+    bool overflow;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        *ticks = frequency_ticks;
+        periods = frequency_periods;
+        overflow = frequency_overflow;
+        frequency_ticks = 0;
+        frequency_periods = 0;
+        frequency_overflow = false;
+    }
+
+    if((periods == 0) || (*ticks == 0))
+    {
+        return (overflow ? 0 : frequency);
+    }
+
+    return (((((uint64_t) periods) * F_CPU) + ((((uint64_t) *ticks) * prescaler) >> 1)) / (((uint64_t) *ticks) * prescaler));
+}
+
+//this task is used to control the lcd
+void lcd_task(void)
+{
+    //reset lcd_time_count
+    lcd_time_count = LCD_TIMEOUT;
+
+    //handle any flags if they are set
+    if(is_flag_set(UPDATE_LCD))
+    {
+        //the flags of the current mode are kept until the menu is closed
+        if(ui_fsm.state == UI_MENU)
+        {
+            if(is_flag_set(APP_STATE_CHANGE))
+            {
+                //reset lcd
+                lcd_reset();
+                //write the menu heading to lcd
+                lcd_print_string_progmem(rate_string, sizeof(rate_string)/sizeof(rate_string[0]),0x80);
+                //clear APP_STATE_CHANGE flag
+                clear_flag(APP_STATE_CHANGE);
+            }
+
+            //display the selected display rate
+            lcd_clear_segment(2,0xC0);
+            lcd_print_num(1000/display_periods[display_rate], 2, 0xC0);
+
+            //display the log interval (s) or OFF
+            lcd_clear_segment(7,0xC9);
+            lcd_print_string_progmem(log_string, sizeof(log_string)/sizeof(log_string[0]),0xC9);
+
+            if(log_interval == 0)
+            {
+                lcd_print_string_progmem(off_string, sizeof(off_string)/sizeof(off_string[0]),0xCD);
+            }
+
+            else
+            {
+                lcd_print_num(log_interval, 3, 0xCD);
+            }
+
+            //clear UPDATE_LCD flag
+            clear_flag(UPDATE_LCD);
+
+            return;
+        }
+
+        if(is_flag_set(APP_STATE_CHANGE))
+        {
+            //reset lcd
+            lcd_reset();
+            //write the headings of the current mode to lcd
+            MODE_HOOK(layout)();
+
+            //clear APP_STATE_CHANGE flag
+            clear_flag(APP_STATE_CHANGE);
+        }
+
+        if(is_flag_set(MEASURED_VALUE_CHANGE))
+        {
+            //print the new value of the current mode
+            MODE_HOOK(format)();
+
+            //the name of the statistics view and the number of readings replace the heading
+            if(stats_view != STATS_LIVE)
+            {
+                lcd_print_stats_view();
+            }
+
+            //clear MEASURED_VALUE_CHANGE flag
+            clear_flag(MEASURED_VALUE_CHANGE);
+        }
+
+        if(is_flag_set(FREQUENCY_VALUE_CHANGE))
+        {
+            char temp[12];
+
+            //frequency of dual mode (first line)
+            lcd_clear_segment(7,0x80);
+            sprintf(temp, "%lu", (unsigned long) filtered_frequency);
+            lcd_print_string(temp, 7, 0x80);
+
+            //clear FREQUENCY_VALUE_CHANGE flag
+            clear_flag(FREQUENCY_VALUE_CHANGE);
+        }
+
+        if(is_flag_set(RANGE_DISPLAY_UPDATE))
+        {
+            //display the selected range of the current mode
+            MODE_HOOK(format_range)();
+
+            if(is_flag_set(AUTORANGING))
+            {
+                //display character "A" to indicate autoranging
+                //(auto trigger of the oscilloscope, new captures are started automatically by the logic analyzer)
+                lcd_print_string_progmem(auto_range_string, sizeof(auto_range_string)/sizeof(auto_range_string[0]), 0xCF);
+            }
+
+            else
+            {
+                //display character "M" to indicate manual ranging
+                lcd_print_string_progmem(manual_range_string, sizeof(manual_range_string)/sizeof(manual_range_string[0]), 0xCF);
+            }
+
+            //clear RANGE_DISPLAY_UPDATE flag
+            clear_flag(RANGE_DISPLAY_UPDATE);
+        }
+
+        //clear UPDATE_LCD flag
+        clear_flag(UPDATE_LCD);
+    }
+}
+
+//lcd hooks of the modes
+//layout writes the headings after the lcd was reset (APP_STATE_CHANGE), format the new value (MEASURED_VALUE_CHANGE)
+//and format_range the selected range (RANGE_DISPLAY_UPDATE, lcd_task adds the "A" or "M" at the end of the second line)
+void frequency_layout(void)
+{
+    //write the appropriate heading string to lcd
+    lcd_print_string_progmem(frequency_string, sizeof(frequency_string)/sizeof(frequency_string[0]),0x80);
+    lcd_print_string_progmem(prescaler_string, sizeof(prescaler_string)/sizeof(prescaler_string[0]),0xC7);
+
+    return;
+}
+
+void voltage_layout(void)
+{
+    //write the appropriate heading string to lcd
+    lcd_print_string_progmem(voltage_string, sizeof(voltage_string)/sizeof(voltage_string[0]),0x80);
+    lcd_print_string_progmem(vref_string, sizeof(vref_string)/sizeof(vref_string[0]),0xC6);
+
+    return;
+}
+
+void resistance_layout(void)
+{
+    //write the appropriate heading string to lcd
+    lcd_print_string_progmem(resistance_string, sizeof(resistance_string)/sizeof(resistance_string[0]),0x80);
+    lcd_print_string_progmem(rref_string, sizeof(rref_string)/sizeof(rref_string[0]),0xC7);
+
+    return;
+}
+
+void capacitance_layout(void)
+{
+    //write the appropriate heading string to lcd
+    lcd_print_string_progmem(capacitance_string, sizeof(capacitance_string)/sizeof(capacitance_string[0]),0x80);
+    lcd_print_string_progmem(rref_string, sizeof(rref_string)/sizeof(rref_string[0]),0xC7);
+
+    return;
+}
+
+void ac_rms_layout(void)
+{
+    //rms and mean on the first line, peak to peak and reference on the second line
+    lcd_print_string_progmem(rms_string, sizeof(rms_string)/sizeof(rms_string[0]),0x80);
+    lcd_print_string_progmem(dc_string, sizeof(dc_string)/sizeof(dc_string[0]),0x89);
+    lcd_print_string_progmem(peak_to_peak_string, sizeof(peak_to_peak_string)/sizeof(peak_to_peak_string[0]),0xC0);
+
+    return;
+}
+
+void scope_layout(void)
+{
+    //capture on the second line, sample rate and trigger level next to it
+    lcd_print_string_progmem(scope_string, sizeof(scope_string)/sizeof(scope_string[0]),0x80);
+    lcd_print_string_progmem(trigger_string, sizeof(trigger_string)/sizeof(trigger_string[0]),0xC9);
+
+    return;
+}
+
+void tone_layout(void)
+{
+    //frequency and amplitude (peak) on the second line, reference on the first line
+    lcd_print_string_progmem(tone_string, sizeof(tone_string)/sizeof(tone_string[0]),0x80);
+    lcd_print_string_progmem(mv_string, sizeof(mv_string)/sizeof(mv_string[0]),0xCB);
+
+    return;
+}
+
+void logic_layout(void)
+{
+    //write the appropriate heading string to lcd
+    lcd_print_string_progmem(logic_string, sizeof(logic_string)/sizeof(logic_string[0]),0x80);
+
+    return;
+}
+
+void dual_layout(void)
+{
+    //frequency on the first line, voltage and reference on the second line
+    lcd_print_string_progmem(hz_string, sizeof(hz_string)/sizeof(hz_string[0]),0x87);
+    lcd_print_string_progmem(volt_string, sizeof(volt_string)/sizeof(volt_string[0]),0xC5);
+
+    return;
+}
+
+void frequency_format(void)
+{
+    char temp[12];
+
+    //clear the original number present
+    lcd_clear_segment(7,0xC0);
+    //print the new frequency value
+    //number of digits is 7 (max. measurable frequency is 8MHz, lcd_print_num() only takes 16 bits)
+    sprintf(temp, "%lu", (unsigned long) stats_reading(filtered_frequency));
+    lcd_print_string(temp, 7, 0xC0);
+
+    return;
+}
+
+void voltage_format(void)
+{
+    //print the new voltage value (in V with 3 decimals)
+    lcd_print_voltage(stats_reading(voltage), 0xC0);
+
+    return;
+}
+
+void ac_rms_format(void)
+{
+    lcd_print_voltage(ac_rms, 0x83);
+    lcd_print_voltage(ac_mean, 0x8B);
+    lcd_print_voltage(ac_peak_to_peak, 0xC2);
+
+    //"S" if the window covered a whole number of signal periods
+    lcd_clear_segment(1,0xC8);
+
+    if(ac_rms_synced)
+    {
+        lcd_print_string_progmem(synced_string, sizeof(synced_string)/sizeof(synced_string[0]), 0xC8);
+    }
+
+    return;
+}
+
+void scope_format(void)
+{
+    uint8_t count;
+
+    //load the rendered capture into the custom characters and show them at the start of the second line
+    for(count = 0; count < SCOPE_GLYPHS; count++)
+    {
+        lcd_create_char(count, scope_glyphs[count]);
+    }
+
+    lcd_cmd(0xC0);
+
+    for(count = 0; count < SCOPE_GLYPHS; count++)
+    {
+        lcd_data(count);
+    }
+
+    //trigger level (adc counts)
+    lcd_clear_segment(3,0xCA);
+    lcd_print_num(scope_trigger_level, 3, 0xCA);
+
+    return;
+}
+
+void tone_format(void)
+{
+    //clear the original numbers present
+    lcd_clear_segment(5,0xC0);
+    lcd_clear_segment(5,0xC6);
+
+    if(tone_detected)
+    {
+        char temp[12];
+
+        lcd_print_num(tone_frequency, 5, 0xC0);
+
+        //amplitude in mV with 2 decimals below 100mV
+        if(tone_amplitude < 100000)
+        {
+            sprintf(temp, "%lu.%02u", (unsigned long) (tone_amplitude/1000), (uint16_t) ((tone_amplitude%1000)/10));
+        }
+
+        else
+        {
+            sprintf(temp, "%lu", (unsigned long) (tone_amplitude/1000));
+        }
+
+        lcd_print_string(temp, 5, 0xC6);
+    }
+
+    else
+    {
+        lcd_print_string_progmem(no_tone_string, sizeof(no_tone_string)/sizeof(no_tone_string[0]), 0xC0);
+    }
+
+    return;
+}
+
+void logic_format(void)
+{
+    //number of edges of the last capture
+    lcd_clear_segment(5,0xC0);
+    lcd_print_num(logic_captured_edges, 5, 0xC0);
+
+    return;
+}
+
+void resistance_format(void)
+{
+    //clear the original number present
+    lcd_clear_segment(7,0xC0);
+    //print the resistance value (in Kohm with 3 decimals, 1 decimal above 1Mohm)
+    //number of digits is 6
+    //(open and shorted probes are only shown in the live view)
+    if((resistance_status == RESISTANCE_OPEN) && (stats_view == STATS_LIVE))
+    {
+        lcd_print_string_progmem(open_string, sizeof(open_string)/sizeof(open_string[0]), 0xC0);
+    }
+
+    else if((resistance_status == RESISTANCE_SHORT) && (stats_view == STATS_LIVE))
+    {
+        lcd_print_string_progmem(short_string, sizeof(short_string)/sizeof(short_string[0]), 0xC0);
+    }
+
+    else
+    {
+        char temp[12];
+        uint32_t ohm = stats_reading(resistance);
+
+        if(ohm < 1000000)
+        {
+            sprintf(temp, "%lu.%03u", (unsigned long) (ohm/1000), (uint16_t) (ohm%1000));
+        }
+
+        else
+        {
+            sprintf(temp, "%lu.%u", (unsigned long) (ohm/1000), (uint16_t) ((ohm%1000)/100));
+        }
+
+        lcd_print_string(temp, 7, 0xC0);
+    }
+
+    return;
+}
+
+void capacitance_format(void)
+{
+    //clear the original number present
+    lcd_clear_segment(7,0xC0);
+
+    if((capacitance_status == CAPACITANCE_OVERRANGE) && (stats_view == STATS_LIVE))
+    {
+        lcd_clear_segment(2,0x8E);
+        lcd_print_string_progmem(overrange_string, sizeof(overrange_string)/sizeof(overrange_string[0]), 0xC0);
+    }
+
+    else
+    {
+        //print the capacitance value in pF, nF (2 decimals) or uF (2 decimals)
+        //the unit is displayed at the end of the first line
+        char temp[12];
+        uint32_t pf = stats_reading(capacitance);
+
+        if(pf < 1000)
+        {
+            sprintf(temp, "%lu", (unsigned long) pf);
+            lcd_print_string_progmem(pf_string, sizeof(pf_string)/sizeof(pf_string[0]), 0x8E);
+        }
+
+        else if(pf < 1000000)
+        {
+            sprintf(temp, "%lu.%02u", (unsigned long) (pf/1000), (uint16_t) ((pf%1000)/10));
+            lcd_print_string_progmem(nf_string, sizeof(nf_string)/sizeof(nf_string[0]), 0x8E);
+        }
+
+        else
+        {
+            sprintf(temp, "%lu.%02u", (unsigned long) (pf/1000000), (uint16_t) ((pf%1000000)/10000));
+            lcd_print_string_progmem(uf_string, sizeof(uf_string)/sizeof(uf_string[0]), 0x8E);
+        }
+
+        lcd_print_string(temp, 7, 0xC0);
+    }
+
+    return;
+}
+
+void frequency_format_range(void)
+{
+    //clear the portion of the display used for displaying the prescaler value
+    lcd_clear_segment(4,0xCA);
+
+    //display the selected prescaler
+    lcd_print_num(prescaler, 4, 0xCA);
+
+    return;
+}
+
+void vref_format_range(void)
+{
+    //clear the portion of the display used for displaying the vref value
+    lcd_clear_segment(4,0xCA);
+
+    //display the calibrated value of the selected reference
+    lcd_print_vref(0xCA);
+
+    return;
+}
+
+void scope_format_range(void)
+{
+    //clear the portion of the display used for displaying the sample rate
+    lcd_clear_segment(5,0x8B);
+
+    //display the sample rate of the selected timebase
+    lcd_print_num(scope_sample_rate(), 5, 0x8B);
+
+    return;
+}
+
+void tone_format_range(void)
+{
+    //clear the portion of the display used for displaying the vref value
+    lcd_clear_segment(4,0x8B);
+    lcd_print_vref(0x8B);
+
+    return;
+}
+
+void dual_format_range(void)
+{
+    //frequency range (prescaler) on the first line
+    //the frequency is always autoranged in dual mode, AUTORANGING applies to the voltage
+    lcd_clear_segment(4,0x8A);
+    lcd_print_num(prescaler, 4, 0x8A);
+    lcd_print_string_progmem(auto_range_string, sizeof(auto_range_string)/sizeof(auto_range_string[0]), 0x8F);
+
+    //voltage range (reference) on the second line
+    lcd_clear_segment(4,0xCA);
+    lcd_print_vref(0xCA);
+
+    return;
+}
+
+void resistance_format_range(void)
+{
+    //clear the portion of the display used for displaying the rref value
+    lcd_clear_segment(4,0xCB);
+
+    //display the selected reference resistor (at most 4 characters)
+    lcd_print_string_progmem(ref_resistors[ref_resistance].name, 4, 0xCB);
+
+    return;
+}
+
+void capacitance_format_range(void)
+{
+    //clear the portion of the display used for displaying the rref value
+    lcd_clear_segment(4,0xCB);
+
+    //display the reference resistor used for charging
+    lcd_print_string_progmem(ref_resistors[NUM_REF_RESISTORS - 1 - cap_range].name, 4, 0xCB);
+
+    return;
+}
+
+//print a voltage given in uV (in V with 3 decimals, 5 characters) at the given lcd address
+void lcd_print_voltage(uint32_t uv, uint8_t address)
+{
+    char temp[8];
+    uint16_t mv = (uv + 500)/1000;
+
+    //clear the original number present
+    lcd_clear_segment(5,address);
+    sprintf(temp, "%u.%03u", mv/1000, mv%1000);
+    lcd_print_string(temp, 5, address);
+
+    return;
+}
+
+//print the calibrated value of the selected reference (in V with 2 decimals, 4 characters) at the given lcd address
+void lcd_print_vref(uint8_t address)
+{
+    char temp[8];
+    uint16_t mv = (vref_range == RANGE_VREF_5V0) ? (avcc_uv/1000) : calibration.bandgap_mv;
+
+    sprintf(temp, "%u.%02u", mv/1000, (mv%1000)/10);
+    lcd_print_string(temp, 4, address);
+
+    return;
+}
+
+//print the name of the selected statistics view and the number of readings on the first line
+//(the end of the line is kept for the unit of the capacitance mode)
+void lcd_print_stats_view(void)
+{
+    char temp[12];
+    uint32_t count = (measurement_stats.count < 9999999) ? measurement_stats.count : 9999999;
+
+    lcd_clear_segment(14,0x80);
+    lcd_print_string_progmem(stats_view_names[stats_view], 4, 0x80);
+
+    //sign of the relative reading
+    if(stats_negative)
+    {
+        lcd_cmd(0x84);
+        lcd_data('-');
+    }
+
+    lcd_print_string_progmem(count_string, sizeof(count_string)/sizeof(count_string[0]), 0x86);
+    sprintf(temp, "%lu", (unsigned long) count);
+    lcd_print_string(temp, 7, 0x87);
+
+    return;
+}
+
+//resistance measurement
+//convert a decimated adc code to ohm using the selected reference resistor
+//returns RESISTANCE_OPEN or RESISTANCE_SHORT (ohm is not changed) if the code is too close to the ends of the adc range
+uint8_t resistance_from_code(uint16_t code, uint32_t* ohm)
+{
+    uint16_t full_scale = adc_full_scale();
+    int32_t value;
+
+    //ratiometric measurement, R = Rref * code / (full scale - code)
+    //(the reference resistor is driven from AVCC, so the result does not depend on AVCC)
+    if((code >= full_scale - (full_scale >> RESISTANCE_OPEN_SHIFT)) && (ref_resistance == NUM_REF_RESISTORS - 1 || !is_flag_set(AUTORANGING)))
+    {
+        return (RESISTANCE_OPEN);
+    }
+
+    if((code <= (full_scale >> RESISTANCE_SHORT_SHIFT)) && (ref_resistance == 0 || !is_flag_set(AUTORANGING)))
+    {
+        return (RESISTANCE_SHORT);
+    }
+
+    value = ((ref_resistance_cal[ref_resistance] * code) / (full_scale - code)) - calibration.offset[adc_range()];
+    *ohm = (value > 0) ? value : 0;
+
+    return (RESISTANCE_OK);
+}
+
+//switch to another reference resistor
+//the old resistor is switched off (high impedance input) before the new one is driven high
+void select_ref_resistor(uint8_t index)
+{
+    if(index == ref_resistance)
+    {
+        return;
+    }
+
+    //disable the old reference resistor
+    *ref_resistors[ref_resistance].port &= ~(1<<ref_resistors[ref_resistance].loc);
+    *ref_resistors[ref_resistance].config &= ~(1<<ref_resistors[ref_resistance].loc);
+    //enable the new reference resistor
+    *ref_resistors[index].config |= (1<<ref_resistors[index].loc);
+    *ref_resistors[index].port |= (1<<ref_resistors[index].loc);
+
+    ref_resistance = index;
+    range_switch_count[RANGE_RREF_BASE + index]++;
+
+    //filtered values of the old range are meaningless in the new one
+    measurement_filter_reset();
+    //discard samples taken with the old resistor
+    adc_start();
+    adc_discard_samples = ADC_SETTLE_SAMPLES;
+
+    return;
+}
+
+//select the reference resistor which keeps the code closest to mid scale
+//the code of every reference resistor is predicted from the current one (code = full scale * R / (R + Rref))
+uint8_t resistance_autorange(uint16_t code)
+{
+    uint16_t full_scale = adc_full_scale();
+    uint16_t mid_scale = full_scale/2;
+    uint16_t distance;
+    uint16_t best_distance;
+    uint8_t best = ref_resistance;
+    uint64_t predicted;
+    uint32_t r;
+    uint8_t count;
+
+    //open probe, the largest resistor gives the best chance of a valid reading
+    if(code >= full_scale - 1)
+    {
+        return (NUM_REF_RESISTORS - 1);
+    }
+
+    //shorted probe, the smallest resistor gives the best chance of a valid reading
+    if(code == 0)
+    {
+        return (0);
+    }
+
+    //unknown resistance relative to the current reference resistor (r = R / Rref * 2^16)
+    r = (((uint32_t) code) << 16) / (full_scale - code);
+
+    best_distance = (code > mid_scale) ? (code - mid_scale) : (mid_scale - code);
+
+    for(count = 0; count < NUM_REF_RESISTORS; count++)
+    {
+        if(count == ref_resistance)
+        {
+            continue;
+        }
+
+        //R / Rref(count) = r * Rref(current) / Rref(count)
+        predicted = (((uint64_t) r) * ref_resistors[ref_resistance].value) / ref_resistors[count].value;
+        predicted = (full_scale * predicted) / (predicted + 65536);
+
+        distance = (predicted > mid_scale) ? (predicted - mid_scale) : (mid_scale - predicted);
+
+        //hysteresis, the new resistor has to be clearly better
+        if(distance + (full_scale >> RESISTANCE_AUTORANGE_MARGIN_SHIFT) < best_distance)
+        {
+            best_distance = distance;
+            best = count;
+        }
+    }
+
+    return (best);
+}
+
+//capacitance measurement
+//a charge in progress is abandoned, the next cycle starts with a discharge
+void capacitance_trigger(void)
+{
+    cap_state = CAP_START;
+
+    return;
+}
+
+//this task runs the discharge/charge cycle without blocking the scheduler (mode task of capacitance mode)
+void capacitance_task(void)
+{
+    const ref_resistor_t* resistor;
+    uint32_t counts;
+    uint32_t pf;
+
+    resistor = &ref_resistors[NUM_REF_RESISTORS - 1 - cap_range];
+
+    switch(cap_state)
+    {
+        case CAP_START:
+        {
+            //switch off the reference resistor and discharge the capacitor through the probe pin
+            *resistor->port &= ~(1<<resistor->loc);
+            *resistor->config &= ~(1<<resistor->loc);
+            PORTC &= ~(1<<PC0);
+            DDRC |= (1<<PC0);
+
+            if(cap_discharge_time < CAP_MIN_DISCHARGE_MS)
+            {
+                cap_discharge_time = CAP_MIN_DISCHARGE_MS;
+            }
+
+            cap_state = CAP_DISCHARGE;
+
+            break;
+        }
+
+        case CAP_DISCHARGE:
+        {
+            if(cap_discharge_time > MODE_TASK_TIMEOUT)
+            {
+                cap_discharge_time -= MODE_TASK_TIMEOUT;
+
+                break;
+            }
+
+            //start charging, timer1 counts from 0 at F_CPU
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+            {
+                clear_flag(CAP_CHARGED);
+                cap_overflows = 0;
+                TCNT1 = 0;
+                hal_clear_flags(&TIFR1, (1<<ICF1) | (1<<TOV1));
+                //release the probe pin and drive the reference resistor high
+                DDRC &= ~(1<<PC0);
+                *resistor->config |= (1<<resistor->loc);
+                *resistor->port |= (1<<resistor->loc);
+            }
+
+            cap_state = CAP_CHARGE;
+
+            break;
+        }
+
+        case CAP_CHARGE:
+        {
+            if(is_flag_set(CAP_CHARGED))
+            {
+                ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+                {
+                    counts = cap_counts;
+                }
+
+                //the next discharge lasts at least as long as this charge
+                cap_discharge_time = counts/(F_CPU/1000);
+
+                if(is_flag_set(AUTORANGING))
+                {
+                    uint8_t range = autorange_select(cap_autorange_table, NUM_REF_RESISTORS, cap_range, counts);
+
+                    if(range != cap_range)
+                    {
+                        //the reading is dropped, the next cycle uses the new resistor
+                        capacitance_select_range(range);
+                        //update range display on lcd
+                        set_flag(RANGE_DISPLAY_UPDATE);
+                        //set UPDATE_LCD flag
+                        set_flag(UPDATE_LCD);
+
+                        break;
+                    }
+                }
+
+                //C = t / (R * ln(2))
+                pf = (((uint64_t) counts) * CAP_PF_FACTOR) / ref_resistance_cal[NUM_REF_RESISTORS - 1 - cap_range];
+                //(values above 2^30 pF are far beyond the measurable range of the smallest resistor)
+                pf = (pf < (1UL<<30)) ? pf : (1UL<<30);
+                stats_update(&measurement_stats, pf);
+                telemetry_send(CAPACITANCE, cap_range, counts, pf);
+                pf = filter_update(&measurement_channel.filter, pf);
+                capacitance_status = CAPACITANCE_OK;
+
+                //only update the display if the filtered value moved by more than the threshold
+                //(the statistics views change with every reading)
+                if(measurement_filter_changed(&measurement_channel, CAPACITANCE, pf) || (stats_view != STATS_LIVE))
+                {
+                    capacitance = pf;
+                    //set MEASURED_VALUE_CHANGE
+                    set_flag(MEASURED_VALUE_CHANGE);
+                    //set UPDATE_LCD flag
+                    set_flag(UPDATE_LCD);
+                }
+
+                cap_state = CAP_START;
+            }
+
+            else if((((uint32_t) cap_overflows) << 16) > CAP_MAX_COUNTS)
+            {
+                cap_discharge_time = CAP_MAX_COUNTS/(F_CPU/1000);
+
+                //capacitor too large for this resistor, try the next smaller one
+                if(is_flag_set(AUTORANGING) && (cap_range < NUM_REF_RESISTORS - 1))
+                {
+                    capacitance_select_range(cap_range + 1);
+                    //update range display on lcd
+                    set_flag(RANGE_DISPLAY_UPDATE);
+                }
+
+                else
+                {
+                    capacitance_status = CAPACITANCE_OVERRANGE;
+                    //set MEASURED_VALUE_CHANGE
+                    set_flag(MEASURED_VALUE_CHANGE);
+                    measurement_channel.displayed_value_valid = false;
+                }
+
+                //set UPDATE_LCD flag
+                set_flag(UPDATE_LCD);
+
+                cap_state = CAP_START;
+            }
+
+            break;
+        }
+    }
+
+    return;
+}
+
+//set up the comparator and timer1 for capacitance measurement
+void capacitance_enter(void)
+{
+    //the adc has to be switched off for the comparator to use the adc multiplexer (ADC0 = capacitor)
+    adc_stop();
+    ADCSRA &= ~(1<<ADEN);
+    ADCSRB |= (1<<ACME);
+
+    //the resistance measurement reference resistor is not used
+    *ref_resistors[ref_resistance].port &= ~(1<<ref_resistors[ref_resistance].loc);
+    *ref_resistors[ref_resistance].config &= ~(1<<ref_resistors[ref_resistance].loc);
+
+    //timer1 without prescaler, capture on the falling edge of the comparator output (capacitor voltage rises above VCC/2)
+    TCCR1B &= ~((1<<ICES1) | 0x07);
+    TCCR1B |= (1<<CS10);
+
+    cap_discharge_time = 0;
+    cap_state = CAP_START;
+
+    return;
+}
+
+//restore the frequency, voltage and resistance measurement setup
+void capacitance_exit(void)
+{
+    const ref_resistor_t* resistor = &ref_resistors[NUM_REF_RESISTORS - 1 - cap_range];
+
+    //switch off the charging resistor and release the probe pin
+    *resistor->port &= ~(1<<resistor->loc);
+    *resistor->config &= ~(1<<resistor->loc);
+    DDRC &= ~(1<<PC0);
+    PORTC &= ~(1<<PC0);
+
+    //enable the resistance measurement reference resistor again
+    *ref_resistors[ref_resistance].config |= (1<<ref_resistors[ref_resistance].loc);
+    *ref_resistors[ref_resistance].port |= (1<<ref_resistors[ref_resistance].loc);
+
+    //give the adc multiplexer back to the adc
+    ADCSRB &= ~(1<<ACME);
+    ADCSRA |= (1<<ADEN);
+
+    //timer1 back to frequency measurement (positive edge, selected prescaler)
+    TCCR1B &= ~(0x07);
+    TCCR1B |= ((1<<ICES1) | (0x07 & (prescaler_index+1)));
+
+    clear_flag(CAP_CHARGED);
+
+    return;
+}
+
+//select another charging resistor, the measurement cycle starts again with a discharge
+void capacitance_select_range(uint8_t range)
+{
+    const ref_resistor_t* resistor = &ref_resistors[NUM_REF_RESISTORS - 1 - cap_range];
+
+    //switch off the old resistor
+    *resistor->port &= ~(1<<resistor->loc);
+    *resistor->config &= ~(1<<resistor->loc);
+
+    if(range != cap_range)
+    {
+        range_switch_count[SWITCH_CAPACITANCE_BASE + range]++;
+    }
+
+    cap_range = range;
+    cap_state = CAP_START;
+
+    //filtered values of the old range are not comparable
+    measurement_filter_reset();
+
+    return;
+}
+
+//true rms measurement
+//switch the adc to the fixed ac rms sample rate (every conversion is used, no oversampling)
+void ac_rms_enter(void)
+{
+    //adc clock 250kHz (prescaler 32), a conversion takes 52us
+    ADCSRA = (ADCSRA & ~ADC_PRESCALER_MASK) | AC_ADC_PRESCALER_BITS;
+
+    //timer0 at 1MHz (prescaler 8) triggers a conversion every 100us
+    adc_timer0_prescaler_bits = (1<<CS01);
+    adc_timer0_ocr = (F_CPU/(8UL*AC_SAMPLE_RATE)) - 1;
+
+    adc_isr_ticks_max = 0;
+    adc_start();
+
+    return;
+}
+
+//restore the adc clock and the timer0 settings of the selected oversampling
+void ac_rms_exit(void)
+{
+    adc_stop();
+    ADCSRA = (ADCSRA & ~ADC_PRESCALER_MASK) | ADC_PRESCALER_BITS;
+    adc_configure(adc_oversample_bits, adc_output_rate);
+
+    return;
+}
+
+//discard the current window and wait for the next rising edge (called with interrupts disabled from adc_start())
+void ac_rms_reset(void)
+{
+    ac_sum = 0;
+    ac_sum_sq = 0;
+    ac_count = 0;
+    ac_min = UINT16_MAX;
+    ac_max = 0;
+    ac_synced = false;
+    ac_state = AC_WAIT_EDGE;
+
+    return;
+}
+
+//calculate rms, mean and peak to peak value of a completed window and start the next one
+//rms is the rms of the ac component, sqrt(n*sum(x^2) - sum(x)^2)/n
+void ac_rms_update(void)
+{
+    uint32_t sum;
+    uint32_t sum_sq;
+    uint16_t count;
+    uint16_t min;
+    uint16_t max;
+    bool synced;
+    uint32_t scale_q8;
+    uint64_t variance;
+    uint32_t rms_q8;
+    int32_t mean;
+
+    //acquisition was stopped (e.g. for measuring AVCC), adc_start() also restarts the window
+    if(~ADCSRA & (1<<ADATE))
+    {
+        adc_start();
+
+        return;
+    }
+
+    //the ISRs do not touch the window once it is done
+    if(ac_state != AC_DONE)
+    {
+        return;
+    }
+
+    sum = ac_sum;
+    sum_sq = ac_sum_sq;
+    count = ac_count;
+    min = ac_min;
+    max = ac_max;
+    synced = ac_synced;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ac_rms_reset();
+    }
+
+    //calibrated uV per adc code (Q8), voltage_scale_q8 is given per count of an oversampled block
+    scale_q8 = voltage_scale_q8[vref_range] << adc_oversample_bits;
+
+    //autoranging is based on the peak value, so that the signal is never clipped
+    if(is_flag_set(AUTORANGING))
+    {
+        uint8_t index = (vref_range == voltage_autorange_ranges[0]) ? 0 : 1;
+        uint8_t new_index = autorange_select(voltage_autorange_table, 2, index, (((uint64_t) max) * scale_q8) >> 8);
+
+        if(new_index != index)
+        {
+            //the reference switch restarts the window
+            adc_select_vref(voltage_autorange_ranges[new_index]);
+            //update range display on lcd
+            set_flag(RANGE_DISPLAY_UPDATE);
+            //set UPDATE_LCD flag
+            set_flag(UPDATE_LCD);
+
+            return;
+        }
+    }
+
+    //n^2 times the variance (at most 2^42 for 4096 samples of 10 bits), shifted by 16 for a Q8 root
+    variance = (((uint64_t) count) * sum_sq) - (((uint64_t) sum) * sum);
+    rms_q8 = isqrt64(variance << 16) / count;
+
+    ac_rms = (((uint64_t) rms_q8) * scale_q8) >> 16;
+    ac_peak_to_peak = (((uint64_t) (max - min)) * scale_q8) >> 8;
+
+    //the offset correction of the voltage range only applies to the dc component
+    mean = ((((uint64_t) sum) * scale_q8) / count >> 8) - calibration.offset[vref_range];
+    ac_mean = (mean > 0) ? mean : 0;
+
+    ac_rms_synced = synced;
+    telemetry_send(VOLTAGE, vref_range, count, ac_rms);
+
+    //set MEASURED_VALUE_CHANGE
+    set_flag(MEASURED_VALUE_CHANGE);
+    //set UPDATE_LCD flag
+    set_flag(UPDATE_LCD);
+
+    return;
+}
+
+//oscilloscope
+//switch the adc to 8 bit free running conversions and start a capture
+void scope_enter(void)
+{
+    adc_stop();
+
+    //left adjusted result (8 bit samples are read from ADCH), free running mode (ADTS2:0 = 000)
+    ADMUX |= (1<<ADLAR);
+    ADCSRB &= ~((1<<ADTS2) | (1<<ADTS1) | (1<<ADTS0));
+    scope_select_timebase(scope_timebase);
+
+    return;
+}
+
+//stop capturing and restore the adc configuration used by the other modes
+void scope_exit(void)
+{
+    scope_state = SCOPE_DONE;
+    ADCSRA &= ~(1<<ADATE);
+    //wait for the last conversion (it is dropped by the ISR)
+    loop_until_bit_is_clear(ADCSRA, ADSC);
+
+    ADMUX &= ~(1<<ADLAR);
+    ADCSRB |= ((1<<ADTS1) | (1<<ADTS0));
+    ADCSRA = (ADCSRA & ~ADC_PRESCALER_MASK) | ADC_PRESCALER_BITS;
+
+    return;
+}
+
+//start a new capture, the pre-trigger part of the buffer is filled before the trigger is armed
+void scope_arm(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        scope_index = 0;
+        scope_remaining = SCOPE_PRE_TRIGGER;
+        scope_previous = scope_trigger_level;
+        scope_state = SCOPE_ARMING;
+        scope_wait_ms = 0;
+    }
+
+    //start free running conversions
+    ADCSRA |= ((1<<ADATE) | (1<<ADSC));
+
+    return;
+}
+
+//select the adc prescaler of a timebase, the capture is started again
+void scope_select_timebase(uint8_t timebase)
+{
+    scope_state = SCOPE_DONE;
+    ADCSRA &= ~(1<<ADATE);
+    loop_until_bit_is_clear(ADCSRA, ADSC);
+
+    scope_timebase = timebase;
+    ADCSRA = (ADCSRA & ~ADC_PRESCALER_MASK) | scope_prescaler_bits[timebase];
+
+    scope_arm();
+
+    return;
+}
+
+//samples per second of the selected timebase (a conversion takes 13 adc clock cycles)
+uint16_t scope_sample_rate(void)
+{
+    return (F_CPU/(13UL << (scope_timebase + 4)));
+}
+
+//handle a completed capture (render it and send it over the serial port) and start the next one
+//with the auto trigger (AUTORANGING flag) a capture is forced if no trigger occurs
+void scope_update(void)
+{
+    uint16_t start;
+
+    if(scope_state == SCOPE_WAIT_TRIGGER)
+    {
+        scope_wait_ms += display_periods[display_rate];
+
+        if(is_flag_set(AUTORANGING) && (scope_wait_ms >= SCOPE_AUTO_MS))
+        {
+            //the trigger is placed at the next sample
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+            {
+                if(scope_state == SCOPE_WAIT_TRIGGER)
+                {
+                    scope_remaining = SCOPE_BUFFER_SIZE - SCOPE_PRE_TRIGGER;
+                    scope_state = SCOPE_POST_TRIGGER;
+                }
+            }
+        }
+
+        return;
+    }
+
+    if(scope_state != SCOPE_DONE)
+    {
+        return;
+    }
+
+    //the ISR does not write to the buffer once the capture is done
+    start = scope_index;
+
+    scope_render(start);
+    scope_dump(start);
+
+    scope_arm();
+
+    //set MEASURED_VALUE_CHANGE
+    set_flag(MEASURED_VALUE_CHANGE);
+    //set UPDATE_LCD flag
+    set_flag(UPDATE_LCD);
+
+    return;
+}
+
+//render a capture into the custom character patterns
+//every column shows the range (min to max) of its samples, so short spikes are not lost
+//with the auto trigger the trigger level is moved to the middle of the captured signal
+void scope_render(uint16_t start)
+{
+    uint8_t column;
+    uint8_t row;
+    uint8_t min;
+    uint8_t max;
+    uint8_t capture_min = UINT8_MAX;
+    uint8_t capture_max = 0;
+    uint16_t index = start;
+    uint16_t count;
+    uint16_t end;
+
+    for(column = 0; column < SCOPE_GLYPHS; column++)
+    {
+        for(row = 0; row < 8; row++)
+        {
+            scope_glyphs[column][row] = 0;
+        }
+    }
+
+    count = 0;
+
+    for(column = 0; column < SCOPE_COLUMNS; column++)
+    {
+        min = UINT8_MAX;
+        max = 0;
+        end = (((uint32_t) (column + 1)) * SCOPE_BUFFER_SIZE) / SCOPE_COLUMNS;
+
+        for(; count < end; count++)
+        {
+            uint8_t sample = scope_buffer[index];
+
+            if(sample < min)
+            {
+                min = sample;
+            }
+
+            if(sample > max)
+            {
+                max = sample;
+            }
+
+            if(++index == SCOPE_BUFFER_SIZE)
+            {
+                index = 0;
+            }
+        }
+
+        if(min < capture_min)
+        {
+            capture_min = min;
+        }
+
+        if(max > capture_max)
+        {
+            capture_max = max;
+        }
+
+        //row 0 is the top of the character, each row covers 32 adc counts
+        for(row = (UINT8_MAX - max) >> 5; row <= ((UINT8_MAX - min) >> 5); row++)
+        {
+            scope_glyphs[column/5][row] |= (0x10 >> (column%5));
+        }
+    }
+
+    if(is_flag_set(AUTORANGING))
+    {
+        scope_trigger_level = (((uint16_t) capture_min) + capture_max + 1) / 2;
+    }
+
+    return;
+}
+
+//send a capture over the serial port at full rate (one byte per sample)
+//frame: SCOPE_FRAME_SYNC, number of samples, sample rate, number of pre-trigger samples (16 bit, little endian),
+//reference (0 = AVCC, 1 = 1.1V), followed by the samples (oldest first)
+void scope_dump(uint16_t start)
+{
+    uint16_t header[3] = {SCOPE_BUFFER_SIZE, scope_sample_rate(), SCOPE_PRE_TRIGGER};
+
+    uart_putc(SCOPE_FRAME_SYNC);
+    uart_write((const uint8_t*) header, sizeof(header));
+    uart_putc(vref_range);
+
+    //the buffer is sent in two parts, from the oldest sample to the end and from the beginning
+    uart_write((const uint8_t*) &scope_buffer[start], SCOPE_BUFFER_SIZE - start);
+    uart_write((const uint8_t*) scope_buffer, start);
+
+    return;
+}
+
+//logic analyzer
+//run timer1 at F_CPU for the best time resolution and start a capture
+void logic_enter(void)
+{
+    TCCR1B &= ~(0x07);
+    TCCR1B |= (1<<CS10);
+
+    logic_arm();
+
+    return;
+}
+
+//stop capturing, timer1 back to frequency measurement (positive edge, selected prescaler)
+void logic_exit(void)
+{
+    logic_state = LOGIC_IDLE;
+
+    TCCR1B &= ~(0x07);
+    TCCR1B |= ((1<<ICES1) | (0x07 & (prescaler_index+1)));
+
+    return;
+}
+
+//start a new capture, the timestamps start at 0
+//the comparator output (ACO) is high while the probe (AIN1) is below the divider voltage on AIN0, so it is the inverted signal
+void logic_arm(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        TCNT1 = 0;
+        hal_clear_flags(&TIFR1, (1<<TOV1));
+        logic_overflows = 0;
+        logic_last_time = 0;
+        logic_index = 0;
+        logic_edges = 0;
+        logic_capture_ms = 0;
+
+        //wait for the edge that leaves the current level
+        if(ACSR & (1<<ACO))
+        {
+            logic_initial_level = 0;
+            TCCR1B &= ~(1<<ICES1);
+        }
+
+        else
+        {
+            logic_initial_level = 1;
+            TCCR1B |= (1<<ICES1);
+        }
+
+        hal_clear_flags(&TIFR1, (1<<ICF1));
+        logic_state = LOGIC_CAPTURE;
+    }
+
+    return;
+}
+
+//end the capture after LOGIC_CAPTURE_MS, send a completed capture over the serial port
+//and start the next one (if AUTORANGING is set)
+void logic_update(void)
+{
+    if(logic_state == LOGIC_CAPTURE)
+    {
+        logic_capture_ms += display_periods[display_rate];
+
+        if(logic_capture_ms < LOGIC_CAPTURE_MS)
+        {
+            return;
+        }
+
+        logic_state = LOGIC_DONE;
+    }
+
+    if(logic_state != LOGIC_DONE)
+    {
+        return;
+    }
+
+    logic_captured_edges = logic_edges;
+    logic_dump();
+
+    if(is_flag_set(AUTORANGING))
+    {
+        logic_arm();
+    }
+
+    else
+    {
+        logic_state = LOGIC_IDLE;
+    }
+
+    //set MEASURED_VALUE_CHANGE
+    set_flag(MEASURED_VALUE_CHANGE);
+    //set UPDATE_LCD flag
+    set_flag(UPDATE_LCD);
+
+    return;
+}
+
+//send a capture over the serial port
+//frame: LOGIC_FRAME_SYNC, number of data bytes, number of edges (16 bit), initial level (8 bit),
+//timer clock in Hz (32 bit), all little endian, followed by the varint encoded deltas
+//tools/logic2vcd.c converts the frame to a vcd file
+void logic_dump(void)
+{
+    uint16_t length = logic_index;
+    uint16_t header[2] = {length, logic_captured_edges};
+    uint32_t clock = F_CPU;
+
+    uart_putc(LOGIC_FRAME_SYNC);
+    uart_write((const uint8_t*) header, sizeof(header));
+    uart_putc(logic_initial_level);
+    uart_write((const uint8_t*) &clock, sizeof(clock));
+    uart_write((const uint8_t*) logic_buffer, length);
+
+    return;
+}
+
+//tone detection
+//sample the probe at TONE_SAMPLE_RATE and start a sweep at the lowest bin
+void tone_enter(void)
+{
+    uint8_t count;
+
+    //timer0 at 1MHz (prescaler 8) triggers a conversion every 200us, the adc clock stays at 125kHz
+    adc_timer0_prescaler_bits = (1<<CS01);
+    adc_timer0_ocr = (F_CPU/(8UL*TONE_SAMPLE_RATE)) - 1;
+
+    tone_reset();
+    tone_offset_valid = false;
+
+    for(count = 0; count < TONE_BINS_PER_BLOCK; count++)
+    {
+        goertzel_init(&tone_bins[count], pgm_read_word(&tone_coeffs[tone_first_bin + count - 1]));
+    }
+
+    adc_isr_ticks_max = 0;
+    adc_start();
+
+    return;
+}
+
+//restore the timer0 settings of the selected oversampling
+void tone_exit(void)
+{
+    adc_stop();
+    adc_configure(adc_oversample_bits, adc_output_rate);
+
+    return;
+}
+
+//forget the current sweep, the next blocks start at the lowest bin
+void tone_reset(void)
+{
+    tone_first_bin = 1;
+    tone_sweep_bin = 0;
+    tone_sweep_magnitude = 0;
+    tone_sweep_before = 0;
+    tone_sweep_after = 0;
+    tone_previous_magnitude = 0;
+    tone_peak = 0;
+
+    return;
+}
+
+//restart the block of the current bins (called with interrupts disabled from adc_start())
+void tone_start_block(void)
+{
+    uint8_t count;
+
+    for(count = 0; count < TONE_BINS_PER_BLOCK; count++)
+    {
+        goertzel_reset(&tone_bins[count]);
+    }
+
+    tone_count = 0;
+    tone_sum = 0;
+    tone_state = TONE_ACQUIRE;
+
+    return;
+}
+
+//this task collects the bins of a completed block and starts the block of the next bins (mode task of tone mode)
+//it runs more often than measurement_task, so that little time is lost between blocks (a block takes 25ms)
+void tone_task(void)
+{
+    uint8_t count;
+    uint8_t bin;
+    uint8_t range;
+    uint32_t magnitude;
+
+    //acquisition was stopped (e.g. for measuring AVCC), adc_start() also restarts the block
+    if(~ADCSRA & (1<<ADATE))
+    {
+        adc_start();
+
+        return;
+    }
+
+    //the ISR does not touch the bins once the block is done
+    if(tone_state != TONE_DONE)
+    {
+        return;
+    }
+
+    //the mean of this block is the dc offset of the next one
+    //a block acquired without a valid offset is repeated
+    tone_offset = (tone_sum + (TONE_BLOCK_SIZE/2)) / TONE_BLOCK_SIZE;
+
+    if(!tone_offset_valid)
+    {
+        tone_offset_valid = true;
+
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            tone_start_block();
+        }
+
+        return;
+    }
+
+    //keep the largest bin of the sweep and its neighbours (bins are collected in increasing order)
+    for(count = 0; count < TONE_BINS_PER_BLOCK; count++)
+    {
+        bin = tone_first_bin + count;
+        magnitude = goertzel_magnitude(&tone_bins[count]);
+
+        if(magnitude > tone_sweep_magnitude)
+        {
+            tone_sweep_bin = bin;
+            tone_sweep_magnitude = magnitude;
+            tone_sweep_before = tone_previous_magnitude;
+            tone_sweep_after = 0;
+        }
+
+        else if(bin == tone_sweep_bin + 1)
+        {
+            tone_sweep_after = magnitude;
+        }
+
+        tone_previous_magnitude = magnitude;
+    }
+
+    range = vref_range;
+    tone_first_bin += TONE_BINS_PER_BLOCK;
+
+    if(tone_first_bin > TONE_NUM_BINS)
+    {
+        range = tone_sweep_done();
+    }
+
+    //coefficients of the next bins (PROGMEM table)
+    for(count = 0; count < TONE_BINS_PER_BLOCK; count++)
+    {
+        goertzel_init(&tone_bins[count], pgm_read_word(&tone_coeffs[tone_first_bin + count - 1]));
+    }
+
+    if(range != vref_range)
+    {
+        //the reference switch restarts the block, its mean is measured again first
+        tone_offset_valid = false;
+        adc_select_vref(range);
+        //update range display on lcd
+        set_flag(RANGE_DISPLAY_UPDATE);
+        //set UPDATE_LCD flag
+        set_flag(UPDATE_LCD);
+    }
+
+    else
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            tone_start_block();
+        }
+    }
+
+    return;
+}
+
+//calculate frequency and amplitude of the largest bin of a completed sweep and start a new sweep
+//returns the reference to be used for the next sweep (autoranging is based on the peak adc code of the sweep)
+uint8_t tone_sweep_done(void)
+{
+    //calibrated uV per adc code (Q8)
+    uint32_t scale_q8 = voltage_scale_q8[vref_range] << adc_oversample_bits;
+    int32_t offset_q8 = 0;
+    uint16_t correction;
+    uint8_t range = vref_range;
+
+    tone_detected = (tone_sweep_magnitude >= TONE_MIN_MAGNITUDE);
+
+    if(tone_detected)
+    {
+        //interpolation with the larger neighbouring bin, offset from the largest bin in 1/256 bins (at most half a bin)
+        //for a rectangular window the ratio of the two bins is offset/(1 - offset)
+        if((tone_sweep_bin < TONE_NUM_BINS) && (tone_sweep_after > tone_sweep_before))
+        {
+            offset_q8 = (256 * tone_sweep_after) / (tone_sweep_magnitude + tone_sweep_after);
+        }
+
+        else if(tone_sweep_bin > 1)
+        {
+            offset_q8 = -(int32_t) ((256 * tone_sweep_before) / (tone_sweep_magnitude + tone_sweep_before));
+        }
+
+        tone_frequency = ((((int32_t) tone_sweep_bin * 256) + offset_q8) * (TONE_SAMPLE_RATE/TONE_BLOCK_SIZE)) / 256;
+
+        //amplitude = 2 * magnitude / block size, corrected for the loss of a tone between two bins
+        correction = pgm_read_word(&tone_amplitude_correction[(labs(offset_q8) + 8) / 16]);
+        tone_amplitude = (((uint64_t) tone_sweep_magnitude) * 2 * correction * scale_q8) / (((uint32_t) TONE_BLOCK_SIZE) << 16);
+
+        //the amplitude (uV) is sent as the raw value
+        telemetry_send(FREQUENCY, vref_range, tone_amplitude, tone_frequency);
+    }
+
+    if(is_flag_set(AUTORANGING))
+    {
+        uint8_t index = (vref_range == voltage_autorange_ranges[0]) ? 0 : 1;
+        uint8_t new_index = autorange_select(voltage_autorange_table, 2, index, (((uint64_t) tone_peak) * scale_q8) >> 8);
+
+        range = voltage_autorange_ranges[new_index];
+    }
+
+    tone_reset();
+
+    //set MEASURED_VALUE_CHANGE
+    set_flag(MEASURED_VALUE_CHANGE);
+    //set UPDATE_LCD flag
+    set_flag(UPDATE_LCD);
+
+    return (range);
+}
+
+//statistics
+//statistics views are available in the modes that show a single reading
+bool stats_available(void)
+{
+    return (MODE_HOOK(reading) != NULL);
+}
+
+//select a statistics view
+//the current reading is held (STATS_HOLD) or used as the reference (STATS_REL)
+void stats_select_view(uint8_t view)
+{
+    stats_view = view;
+    stats_reference = stats_live_reading();
+
+    //redraw the heading (or the name of the view) and the reading
+    set_flag(APP_STATE_CHANGE);
+    set_flag(MEASURED_VALUE_CHANGE);
+    set_flag(RANGE_DISPLAY_UPDATE);
+    set_flag(UPDATE_LCD);
+
+    return;
+}
+
+//filtered reading of the current mode
+uint32_t stats_live_reading(void)
+{
+    return (*MODE_HOOK(reading));
+}
+
+//reading shown in the selected view (the live reading is given in the unit of the mode)
+//the relative view shows the magnitude of the difference, stats_negative is set if the reading is below the reference
+uint32_t stats_reading(uint32_t live)
+{
+    stats_negative = false;
+
+    switch(stats_view)
+    {
+        case STATS_MIN:
+        {
+            return ((uint32_t) measurement_stats.min);
+        }
+
+        case STATS_MAX:
+        {
+            return ((uint32_t) measurement_stats.max);
+        }
+
+        case STATS_AVG:
+        {
+            return ((uint32_t) stats_mean(&measurement_stats));
+        }
+
+        case STATS_SDEV:
+        {
+            return (stats_deviation(&measurement_stats));
+        }
+
+        case STATS_HOLD:
+        {
+            return (stats_reference);
+        }
+
+        case STATS_REL:
+        {
+            if(live < stats_reference)
+            {
+                stats_negative = true;
+
+                return (stats_reference - live);
+            }
+
+            return (live - stats_reference);
+        }
+    }
+
+    return (live);
+}
+
+//filtering
+//quantity measured in the current app state (the other adc based modes measure voltage)
+uint8_t measurement_quantity(void)
+{
+    return (MODE_BYTE(quantity));
+}
+
+//drop everything acquired so far and take the next reading one display period from now
+void measurement_trigger(void)
+{
+    measurement_filter_reset();
+    frequency_restart();
+    measurement_time_count = display_periods[display_rate];
+
+    return;
+}
+
+//restart the filters with the settings of the current app state
+//the next filtered values are always displayed
+void measurement_filter_reset(void)
+{
+    filter_init(&measurement_channel.filter, filter_type[measurement_quantity()], filter_iir_shift[measurement_quantity()]);
+    measurement_channel.displayed_value_valid = false;
+
+    filter_init(&frequency_channel.filter, filter_type[FREQUENCY], filter_iir_shift[FREQUENCY]);
+    frequency_channel.displayed_value_valid = false;
+
+    //blocks collected for the current reading belong to the old settings
+    adc_reading_sum = 0;
+    adc_reading_blocks = 0;
+
+    return;
+}
+
+//check if a filtered value differs from the displayed one by more than the change threshold of the quantity
+//the value is remembered as the displayed value if it does
+bool measurement_filter_changed(measurement_channel_t* channel, uint8_t quantity, int32_t value)
+{
+    int32_t difference = value - channel->displayed_value;
+
+    if(channel->displayed_value_valid && (difference <= (int32_t) change_threshold[quantity]) && (-difference <= (int32_t) change_threshold[quantity]))
+    {
+        return (false);
+    }
+
+    channel->displayed_value = value;
+    channel->displayed_value_valid = true;
+
+    return (true);
+}
+
+//autoranging
+//generic threshold table based autoranging
+//returns the index of the range to be used for the given value (index of the current range if no switch is needed)
+uint8_t autorange_select(const autorange_threshold_t* table, uint8_t num_ranges, uint8_t index, uint32_t value)
+{
+    if((value > table[index].up) && (index < num_ranges - 1))
+    {
+        return (index + 1);
+    }
+
+    if((value < table[index].down) && (index > 0))
+    {
+        return (index - 1);
+    }
+
+    return (index);
+}
+
+//adc acquisition
+//select the number of extra bits obtained by oversampling and the rate at which decimated blocks are produced
+//returns false (and leaves the configuration unchanged) if the resulting sample rate cannot be generated
+bool adc_configure(uint8_t oversample_bits, uint16_t output_rate)
+{
+    uint32_t sample_rate;
+    uint32_t ocr;
+
+    if(oversample_bits > ADC_MAX_OVERSAMPLE_BITS || output_rate == 0)
+    {
+        return (false);
+    }
+
+    sample_rate = ((uint32_t) output_rate) << (2*oversample_bits);
+
+    if(sample_rate > ADC_MAX_SAMPLE_RATE)
+    {
+        return (false);
+    }
+
+    //timer0 in ctc mode, try prescaler 8 first and fall back to prescaler 64 for low sample rates
+    ocr = F_CPU/(8*sample_rate);
+
+    if(ocr <= 256)
+    {
+        adc_timer0_prescaler_bits = (1<<CS01);
+    }
+
+    else
+    {
+        ocr = F_CPU/(64*sample_rate);
+
+        if(ocr > 256)
+        {
+            return (false);
+        }
+
+        adc_timer0_prescaler_bits = ((1<<CS01) | (1<<CS00));
+    }
+
+    adc_timer0_ocr = ocr - 1;
+    adc_oversample_bits = oversample_bits;
+    adc_output_rate = output_rate;
+
+    //the voltage scale depends on the full scale value of a block
+    calibration_update();
+
+    //apply the new configuration if acquisition is running
+    if(ADCSRA & (1<<ADATE))
+    {
+        adc_start();
+    }
+
+    return (true);
+}
+
+//start (or restart) free running acquisition, any partially accumulated block and buffered blocks are discarded
+void adc_start(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        //stop timer0 and reset it
+        TCCR0B = 0;
+        TCNT0 = 0;
+        //timer0 in ctc mode
+        TCCR0A = (1<<WGM01);
+        OCR0A = adc_timer0_ocr;
+
+        //reset the block accumulator, the ring buffer, the ac rms window and the goertzel block
+        //(conversions still to be discarded for a reference switch are kept)
+        adc_accumulator = 0;
+        adc_samples_remaining = (1 << (2*adc_oversample_bits));
+        adc_block_head = 0;
+        adc_block_tail = 0;
+        ac_rms_reset();
+        tone_start_block();
+
+        //enable auto triggering and start timer0
+        hal_clear_flags(&TIFR0, (1<<OCF0A));
+        ADCSRA |= (1<<ADATE);
+        TCCR0B = adc_timer0_prescaler_bits;
+    }
+
+    return;
+}
+
+//stop free running acquisition
+void adc_stop(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        TCCR0B = 0;
+        ADCSRA &= ~(1<<ADATE);
+    }
+
+    return;
+}
+
+//get the oldest decimated block from the ring buffer
+//returns false if no complete block is available
+bool adc_read_block(uint16_t* code)
+{
+    uint8_t tail = adc_block_tail;
+
+    if(tail == adc_block_head)
+    {
+        return (false);
+    }
+
+    *code = adc_blocks[tail];
+    adc_block_tail = (tail + 1) & (ADC_BLOCK_BUFFER_SIZE - 1);
+
+    return (true);
+}
+
+//pass the decimated blocks in the ring buffer through the filter and the statistics
+//and add them to the reading of the current display period
+void adc_collect_blocks(void)
+{
+    uint16_t block;
+
+    while(adc_read_block(&block))
+    {
+        adc_reading_sum += filter_update(&measurement_channel.filter, block);
+        adc_reading_blocks++;
+
+        MODE_HOOK(block)(block);
+    }
+
+    return;
+}
+
+//statistics and telemetry of a decimated block
+void mode_block_nothing(uint16_t block)
+{
+    (void) block;
+
+    return;
+}
+
+void voltage_block(uint16_t block)
+{
+    uint32_t uv = adc_code_to_uv(block);
+
+    stats_update(&measurement_stats, uv);
+    telemetry_send(VOLTAGE, adc_range(), block, uv);
+
+    return;
+}
+
+//the voltage of dual mode has no statistics
+void dual_block(uint16_t block)
+{
+    telemetry_send(VOLTAGE, adc_range(), block, adc_code_to_uv(block));
+
+    return;
+}
+
+void resistance_block(uint16_t block)
+{
+    uint32_t ohm;
+    uint8_t status = resistance_from_code(block, &ohm);
+
+    //open and shorted probes are not counted
+    if(status == RESISTANCE_OK)
+    {
+        stats_update(&measurement_stats, ohm);
+        telemetry_send(RESISTANCE, adc_range(), block, ohm);
+    }
+
+    else
+    {
+        telemetry_send(RESISTANCE, adc_range(), block, (status == RESISTANCE_OPEN) ? TELEMETRY_OPEN : TELEMETRY_SHORT);
+    }
+
+    return;
+}
+
+//full scale value of a decimated block (1024 * 2^n)
+uint16_t adc_full_scale(void)
+{
+    return (1024U << adc_oversample_bits);
+}
+
+//convert a decimated block to uV using the calibrated scale of the selected reference
+//the offset correction of the voltage range is applied in the voltage based modes (not for resistance)
+uint32_t adc_code_to_uv(uint16_t code)
+{
+    int32_t uv = (code * voltage_scale_q8[vref_range]) >> 8;
+
+    if(measurement_quantity() == VOLTAGE)
+    {
+        uv -= calibration.offset[vref_range];
+    }
+
+    return ((uv > 0) ? uv : 0);
+}
+
+//switch the adc reference (RANGE_VREF_5V0 or RANGE_VREF_1V1)
+//the ring buffer is flushed and conversions are discarded until the new reference has settled
+void adc_select_vref(uint8_t range)
+{
+    if(range == vref_range)
+    {
+        return;
+    }
+
+    if(range == RANGE_VREF_1V1)
+    {
+        ADMUX |= (1<<REFS1);
+    }
+
+    else
+    {
+        ADMUX &= ~(1<<REFS1);
+    }
+
+    vref_range = range;
+    range_switch_count[range]++;
+
+    //filtered values of the old range are meaningless in the new one
+    measurement_filter_reset();
+
+    //discard samples taken with the old reference
+    adc_start();
+    adc_discard_samples = ADC_SETTLE_SAMPLES;
+
+    return;
+}
+
+//get the sum of a number of polled conversions of the given adc input and reference
+//free running acquisition is stopped and the ADC interrupt is disabled during the measurement
+uint16_t adc_measure_polled(uint8_t admux, uint8_t samples)
+{
+    uint8_t old_admux = ADMUX;
+    uint16_t sum = 0;
+    uint8_t count;
+
+    adc_stop();
+    ADCSRA &= ~(1<<ADIE);
+    ADMUX = admux;
+
+    //the first conversions after switching the multiplexer are discarded
+    for(count = 0; count < CAL_SETTLE_SAMPLES + samples; count++)
+    {
+        ADCSRA |= (1<<ADSC);
+        loop_until_bit_is_clear(ADCSRA, ADSC);
+
+        if(count >= CAL_SETTLE_SAMPLES)
+        {
+            sum += ADC;
+        }
+    }
+
+    //restore multiplexer, clear the pending interrupt flag and enable the interrupt again
+    ADMUX = old_admux;
+    hal_write_flags(&ADCSRA, ADCSRA | (1<<ADIF), (1<<ADIF));
+    ADCSRA |= (1<<ADIE);
+
+    return (sum);
+}
+
+//get the range the adc is currently used in
+uint8_t adc_range(void)
+{
+    if(app_state == RESISTANCE)
+    {
+        return (RANGE_RREF_BASE + ref_resistance);
+    }
+
+    return (vref_range);
+}
+
+//check if precision acquisition is selected for the current range
+bool adc_precision_selected(void)
+{
+    //e.g. not in dual mode, sleeping halts the timer1 clock and would corrupt the frequency measurement
+    if(!(MODE_BYTE(flags) & MODE_PRECISION))
+    {
+        return (false);
+    }
+
+    return ((precision_ranges & (1<<adc_range())) != 0);
+}
+
+//acquire one block (4^n conversions) with every conversion started from SLEEP_MODE_ADC
+//the block ends up in the ring buffer just like a free running block
+void adc_precision_burst(void)
+{
+    uint8_t timer1_clock;
+    uint16_t conversions = (1 << (2*adc_oversample_bits)) + adc_discard_samples;
+
+    //stop free running acquisition, every conversion is now started by entering sleep mode
+    adc_stop();
+
+    //pause timer1 (frequency measurement is not used while measuring voltage or resistance)
+    timer1_clock = TCCR1B & 0x07;
+    TCCR1B &= ~(0x07);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_accumulator = 0;
+        adc_samples_remaining = (1 << (2*adc_oversample_bits));
+        adc_block_head = 0;
+        adc_block_tail = 0;
+    }
+
+    set_sleep_mode(SLEEP_MODE_ADC);
+
+    //sleep until the ADC ISR has stored the complete block
+    //interrupts are enabled right before sleep_cpu() so the wake up interrupt cannot be missed
+    cli();
+    while(adc_block_head == adc_block_tail)
+    {
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+        cli();
+    }
+    sei();
+
+    //resume timer1
+    TCCR1B |= timer1_clock;
+
+    //timer2 is clocked from clkIO, so it was halted during every conversion
+    scheduler_compensate(conversions * ADC_CONVERSION_US);
+
+    return;
+}
+
+//calibration
+//copy the calibration data from EEPROM to sram
+void calibration_load(void)
+{
+    uint8_t count;
+
+    eeprom_cache_pause();
+    eeprom_read_block(&calibration, &calibration_eeprom, sizeof(calibration));
+    eeprom_cache_resume();
+
+    //fall back to nominal values if the EEPROM was erased or holds implausible data
+    if(calibration.bandgap_mv < BANDGAP_MIN_MV || calibration.bandgap_mv > BANDGAP_MAX_MV)
+    {
+        calibration.bandgap_mv = BANDGAP_NOMINAL_MV;
+
+        for(count = 0; count < NUM_RANGES; count++)
+        {
+            calibration.offset[count] = 0;
+            calibration.gain[count] = CAL_GAIN_ONE;
+        }
+    }
+
+    calibration_update();
+
+    return;
+}
+
+//store the calibration data in EEPROM (only modified bytes are written, 3.4ms per byte, the EEPROM cache waits)
+void calibration_save(void)
+{
+    eeprom_cache_pause();
+    eeprom_update_block(&calibration, &calibration_eeprom, sizeof(calibration));
+    eeprom_cache_resume();
+
+    return;
+}
+
+//recalculate the scale factors used by measurement_task
+//must be called whenever the calibration data, AVCC or the oversampling configuration changes
+void calibration_update(void)
+{
+    uint32_t full_scale = adc_full_scale();
+    uint8_t count;
+
+    voltage_scale_q8[RANGE_VREF_5V0] = (((uint64_t) avcc_uv) * calibration.gain[RANGE_VREF_5V0] * 256) / (full_scale * CAL_GAIN_ONE);
+    voltage_scale_q8[RANGE_VREF_1V1] = (((uint64_t) calibration.bandgap_mv) * 1000 * calibration.gain[RANGE_VREF_1V1] * 256) / (full_scale * CAL_GAIN_ONE);
+
+    for(count = 0; count < NUM_REF_RESISTORS; count++)
+    {
+        ref_resistance_cal[count] = (ref_resistors[count].value * calibration.gain[RANGE_RREF_BASE + count]) / CAL_GAIN_ONE;
+    }
+
+    return;
+}
+
+//measure AVCC against the bandgap (AVCC = bandgap * 1024 / code)
+//returns false if the result is not plausible, AVCC is then left unchanged
+bool calibration_measure_avcc(void)
+{
+    uint16_t sum = adc_measure_polled((1<<REFS0) | ADC_MUX_BANDGAP, CAL_SAMPLES);
+    uint32_t uv;
+
+    if(sum == 0)
+    {
+        return (false);
+    }
+
+    uv = (((uint64_t) calibration.bandgap_mv) * 1000 * 1024 * CAL_SAMPLES) / sum;
+
+    //AVCC must be between 2.7V and 5.5V
+    if(uv < 2700000 || uv > 5500000)
+    {
+        return (false);
+    }
+
+    avcc_uv = uv;
+    calibration_update();
+
+    return (true);
+}
+
+//user calibration of the bandgap
+//CAL_KNOWN_MV has to be applied to the probe, both the probe and the bandgap are then measured against AVCC
+//bandgap = known voltage * code(bandgap) / code(probe)
+void calibration_user_bandgap(void)
+{
+    uint16_t sum_bandgap = adc_measure_polled((1<<REFS0) | ADC_MUX_BANDGAP, CAL_SAMPLES);
+    uint16_t sum_probe = adc_measure_polled((1<<REFS0), CAL_SAMPLES);
+    //not narrowed before the range check (a probe far below the known voltage gives more than 16 bits)
+    uint32_t bandgap_mv;
+
+    if(sum_probe == 0)
+    {
+        return;
+    }
+
+    bandgap_mv = (((uint32_t) CAL_KNOWN_MV) * sum_bandgap) / sum_probe;
+
+    if(bandgap_mv >= BANDGAP_MIN_MV && bandgap_mv <= BANDGAP_MAX_MV)
+    {
+        calibration.bandgap_mv = (uint16_t) bandgap_mv;
+        calibration_save();
+        calibration_update();
+    }
+
+    //display the result
+    lcd_reset();
+    lcd_print_string_progmem(bandgap_cal_string, sizeof(bandgap_cal_string)/sizeof(bandgap_cal_string[0]), 0x80);
+    lcd_print_num(calibration.bandgap_mv, 4, 0xC0);
+    delayms(2000);
+
+    return;
+}
+
+//this task is used to measure AVCC periodically
+void calibration_task(void)
+{
+    //reset calibration_time_count
+    calibration_time_count = CALIBRATION_TIMEOUT;
+
+    //measuring AVCC requires AVCC as adc reference, skip this while the 1.1V reference is in use
+    //(switching the reference back and forth would require the reference to settle again)
+    if((measurement_quantity() == VOLTAGE) && (vref_range == RANGE_VREF_1V1))
+    {
+        return;
+    }
+
+    //the adc is switched off in capacitance mode (its multiplexer is used by the comparator)
+    //and a polled measurement would corrupt an oscilloscope capture
+    if(MODE_BYTE(flags) & MODE_ADC_BUSY)
+    {
+        return;
+    }
+
+    //the adc is shut down in the modes that do not use it (AVCC is measured again in the next mode using it)
+    if(PRR & POWER_ADC)
+    {
+        return;
+    }
+
+    if(calibration_measure_avcc())
+    {
+        //AVCC is displayed as the reference value in voltage and dual mode
+        if(measurement_quantity() == VOLTAGE)
+        {
+            set_flag(RANGE_DISPLAY_UPDATE);
+            set_flag(UPDATE_LCD);
+        }
+    }
+
+    //free running acquisition is restarted by measurement_task
+
+    return;
+}
+
+//remote commands
+//this task is used to execute a request received over the serial port (see COMMAND_SET_MODE ...)
+void command_task(void)
+{
+    uint8_t encoded[UART_RX_FRAME_SIZE];
+    uint8_t request[UART_RX_FRAME_SIZE];
+    uint8_t data[COMMAND_MAX_DATA];
+    uint8_t data_length = 0;
+    uint8_t status = COMMAND_OK;
+    uint8_t crc = 0;
+    uint8_t count;
+    int16_t length;
+
+    //reset command_time_count
+    command_time_count = COMMAND_TIMEOUT;
+
+    length = uart_read_frame(encoded);
+
+    if(length == 0)
+    {
+        return;
+    }
+
+    length = cobs_decode(encoded, length, request);
+
+    //command, sequence number and crc at least
+    if((length < 3) || (length > COMMAND_REQUEST_SIZE))
+    {
+        return;
+    }
+
+    for(count = 0; count < length - 1; count++)
+    {
+        crc = _crc8_ccitt_update(crc, request[count]);
+    }
+
+    if(crc != request[length - 1])
+    {
+        return;
+    }
+
+    //number of argument bytes
+    length -= 3;
+
+    switch(request[0])
+    {
+        case COMMAND_SET_MODE:
+        {
+            if((length != 1) || (request[2] >= NUM_APP_STATES))
+            {
+                status = COMMAND_INVALID;
+
+                break;
+            }
+
+            select_app_state(request[2]);
+
+            break;
+        }
+
+        case COMMAND_SET_RANGE:
+        {
+            //autoranging has to be off to keep the range (the auto trigger of scope mode is not affected)
+            if((length != 1) || !select_range(request[2]))
+            {
+                status = COMMAND_INVALID;
+
+                break;
+            }
+
+            if(!(MODE_BYTE(flags) & MODE_AUTO_TRIGGER))
+            {
+                clear_flag(AUTORANGING);
+            }
+
+            break;
+        }
+
+        case COMMAND_SET_AUTORANGING:
+        {
+            if((length != 1) || (request[2] > 1))
+            {
+                status = COMMAND_INVALID;
+
+                break;
+            }
+
+            if(request[2])
+            {
+                set_flag(AUTORANGING);
+            }
+
+            else
+            {
+                clear_flag(AUTORANGING);
+            }
+
+            //set RANGE_DISPLAY_UPDATE flag
+            set_flag(RANGE_DISPLAY_UPDATE);
+            //set UPDATE_LCD flag
+            set_flag(UPDATE_LCD);
+
+            break;
+        }
+
+        case COMMAND_SET_RATE:
+        {
+            if((length != 1) || (request[2] >= NUM_DISPLAY_RATES))
+            {
+                status = COMMAND_INVALID;
+
+                break;
+            }
+
+            display_rate = request[2];
+            measurement_time_count = display_periods[display_rate];
+
+            break;
+        }
+
+        case COMMAND_TRIGGER:
+        {
+            MODE_HOOK(trigger)();
+
+            break;
+        }
+
+        case COMMAND_QUERY:
+        {
+            //the frame without type and crc
+            data_length = sizeof(telemetry_last) - 2;
+            memcpy(data, ((const uint8_t*) &telemetry_last) + 1, data_length);
+
+            break;
+        }
+
+        case COMMAND_PROFILER:
+        {
+            uint16_t value;
+
+            data[0] = adc_isr_ticks;
+            data[1] = adc_isr_ticks_max;
+
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+            {
+                value = adc_block_overruns;
+
+                if((length == 1) && (request[2] == 1))
+                {
+                    adc_isr_ticks_max = 0;
+                }
+            }
+
+            memcpy(&data[2], &value, 2);
+            memcpy(&data[4], &telemetry_dropped, 2);
+            data_length = 6;
+
+            break;
+        }
+
+        case COMMAND_STATS:
+        {
+            int32_t value;
+
+            data[0] = stats_view;
+            memcpy(&data[1], &measurement_stats.count, 4);
+            memcpy(&data[5], &measurement_stats.min, 4);
+            memcpy(&data[9], &measurement_stats.max, 4);
+            value = stats_mean(&measurement_stats);
+            memcpy(&data[13], &value, 4);
+            value = stats_deviation(&measurement_stats);
+            memcpy(&data[17], &value, 4);
+            data_length = 21;
+
+            break;
+        }
+
+        case COMMAND_LOG:
+        {
+            if(length != 1)
+            {
+                status = COMMAND_INVALID;
+
+                break;
+            }
+
+            log_start(request[2]);
+
+            data[0] = log_interval;
+            data[1] = log_page;
+            memcpy(&data[2], &log_sequence, 2);
+            data_length = 4;
+
+            break;
+        }
+
+        case COMMAND_LOG_DUMP:
+        {
+            log_dump();
+
+            break;
+        }
+
+        case COMMAND_RANGE_SWITCHES:
+        {
+            if((length != 1) || (request[2] >= NUM_RANGE_SWITCH_COUNTS))
+            {
+                status = COMMAND_INVALID;
+
+                break;
+            }
+
+            data_length = NUM_RANGE_SWITCH_COUNTS - request[2];
+
+            if(data_length > RANGE_SWITCH_REPLY)
+            {
+                data_length = RANGE_SWITCH_REPLY;
+            }
+
+            data_length *= 2;
+            memcpy(data, &range_switch_count[request[2]], data_length);
+
+            break;
+        }
+
+        case COMMAND_SCOPE_EDGE:
+        {
+            if((length != 1) || (request[2] > SCOPE_FALLING))
             {
-                ADMUX &= ~(1<<REFS1);
-                vref = 5.0;
+                status = COMMAND_INVALID;
+
+                break;
             }
+
+            scope_trigger_edge = request[2];
+
+            data[0] = scope_trigger_edge;
+            data_length = 1;
+
+            break;
+        }
+
+        default:
+        {
+            status = COMMAND_UNKNOWN;
+
+            break;
         }
+    }
+
+    command_respond(request[0], request[1], status, data, data_length);
+
+    return;
+}
+
+//send a response frame, waits if the transmit buffer is full (a response must not be dropped)
+void command_respond(uint8_t command, uint8_t sequence, uint8_t status, const uint8_t* data, uint8_t length)
+{
+    uint8_t frame[COMMAND_MAX_DATA + 5];
+    uint8_t encoded[COBS_ENCODED_LENGTH(COMMAND_MAX_DATA + 5) + 1];
+    uint8_t crc = 0;
+    uint8_t count;
+    uint8_t encoded_length;
+
+    frame[0] = TELEMETRY_RESPONSE;
+    frame[1] = command;
+    frame[2] = sequence;
+    frame[3] = status;
+    memcpy(&frame[4], data, length);
+    length += 4;
+
+    for(count = 0; count < length; count++)
+    {
+        crc = _crc8_ccitt_update(crc, frame[count]);
+    }
+
+    frame[length++] = crc;
+
+    encoded_length = cobs_encode(frame, length, encoded);
+    encoded[encoded_length++] = 0;
+    uart_write(encoded, encoded_length);
+
+    return;
+}
+
+//settings
+//this task saves the settings when they did not change since its last run
+void settings_task(void)
+{
+    settings_t current;
+
+    //reset settings_time_count
+    settings_time_count = SETTINGS_TIMEOUT;
+
+    settings_capture(&current);
+
+    //settings that are still changing (e.g. while autoranging) are saved in a later run
+    if(memcmp(&current, &settings_pending, sizeof(current)) != 0)
+    {
+        settings_pending = current;
 
-        //enable auto ranging by default
-        set_flag(AUTORANGING);
-        //set APP_STATE_CHANGE flag
-        set_flag(APP_STATE_CHANGE);
-        //set RANGE_DISPLAY_UPDATE flag
-        set_flag(RANGE_DISPLAY_UPDATE);
-        //set UPDATE_LCD flag
-        set_flag(UPDATE_LCD);
-        //cler BUTTON_0_EVENT flag
-        clear_flag(BUTTON_0_EVENT);
+        return;
     }
 
-    if(is_flag_set(BUTTON_1_EVENT))
+    //only the bytes that differ from the saved settings are written
+    if(memcmp(&current, &settings, sizeof(current)) != 0)
     {
-        //toggle autoranging
-        toggle_flag(AUTORANGING);
-        //set RANGE_DISPLAY_UPDATE flag
-        set_flag(RANGE_DISPLAY_UPDATE);
-        //set UPDATE_LCD flag
-        set_flag(UPDATE_LCD);
-        //clear BUTTON_1_EVENT flag
-        clear_flag(BUTTON_1_EVENT);
+        settings = current;
+        eeprom_cache_write_block(&settings, &settings_eeprom, sizeof(settings));
     }
 
-    if(is_flag_set(BUTTON_2_EVENT))
-    {
-        if(app_state == FREQUENCY)
-        {
-            //cycle through the available "prescaler" values
-            if(prescaler_index < ((sizeof(prescaler_values)/sizeof(prescaler_values[0]))-1))
-            {
-                //increase prescaler
-                prescaler = prescaler_values[++prescaler_index];
-                //modify TCCR1B register to set the appropriate prescaler
-                TCCR1B &= ~(0x07);
-                TCCR1B |= (0x07 & (prescaler_index+1));
-            }
+    return;
+}
 
-            else
-            {
-                //reset prescaler to initial value
-                prescaler_index = 0;
-                prescaler = prescaler_values[prescaler_index];
-                //modify TCCR1B register to set the appropriate prescaler
-                TCCR1B &= ~(0x07);
-                TCCR1B |= (0x07 & (prescaler_index+1));
-            }
-        }
+//copy the settings from EEPROM, returns false (the defaults are kept) if no valid settings were stored
+//(has to be called before settings_apply())
+bool settings_load(void)
+{
+    eeprom_cache_init(&settings_eeprom);
+    eeprom_cache_read_block(&settings, &settings_eeprom, sizeof(settings));
 
-        else if(app_state == VOLTAGE)
-        {
-            //cycle through the available vref values
-            if(vref == 5.0)
-            {
-                //change vref to 1.1v
-                ADMUX |= (1<<REFS1);
-                vref = 1.1;
-            }
+    if((settings.version != SETTINGS_VERSION) || (settings.crc != settings_crc(&settings)) ||
+       (settings.app_state >= NUM_APP_STATES) || (settings.display_rate >= NUM_DISPLAY_RATES))
+    {
+        settings_capture(&settings);
 
-            else
-            {
-                ADMUX &= ~(1<<REFS1);
-                vref = 5.0;
-            }
-        }
+        return (false);
+    }
 
-        else if(app_state == RESISTANCE)
-        {
-            //cycle through the available "ref_resistance_val" values
-            if(ref_resistance == R_0)
-            {
-                //change the reference resistance to 10Kohm
-                //disable 1Kohm resistance
-                R_0_PORT &= ~(1<<R_0_LOC);
-                R_0_CONFIG &= ~(1<<R_0_LOC);
-                //enable 10Kohm resistor
-                R_1_CONFIG |= (1<<R_1_LOC);
-                R_1_PORT |= (1<<R_1_LOC);
-                ref_resistance = R_1;
-                ref_resistance_val = 10000;
-            }
+    memcpy(mode_ranges, settings.range, sizeof(mode_ranges));
+    memcpy(filter_type, settings.filter_type, sizeof(filter_type));
+    memcpy(filter_iir_shift, settings.filter_iir_shift, sizeof(filter_iir_shift));
+    precision_ranges = settings.precision_ranges;
+    display_rate = settings.display_rate;
 
-            else
-            {
-                //change the reference resistance to 1Kohm
-                //disable 10Kohm resistance
-                R_1_PORT &= ~(1<<R_1_LOC);
-                R_1_CONFIG &= ~(1<<R_1_LOC);
-                //enable 10Kohm resistor
-                R_0_CONFIG |= (1<<R_0_LOC);
-                R_0_PORT |= (1<<R_0_LOC);
-                ref_resistance = R_0;
-                ref_resistance_val = 1000;
-            }
-        }
+    return (true);
+}
 
-        //update range display on lcd
-        set_flag(RANGE_DISPLAY_UPDATE);
-        //set UPDATE_LCD flag
-        set_flag(UPDATE_LCD);
-        //cler "BUTTON_2_EVENT" flag
-        clear_flag(BUTTON_2_EVENT);
+//switch to the mode and ranges of the loaded settings
+void settings_apply(void)
+{
+    //the range of the default mode is selected first, select_app_state() remembers it when leaving the mode
+    select_range(mode_ranges[app_state]);
+    select_app_state(settings.app_state);
+
+    if(!settings.autoranging)
+    {
+        clear_flag(AUTORANGING);
     }
+
+    settings_pending = settings;
+    measurement_time_count = display_periods[display_rate];
+
+    return;
 }
 
-//this task is used to measure frequency, voltage and resistance
-void measurement_task(void)
+//collect the current settings
+void settings_capture(settings_t* current)
+{
+    current->version = SETTINGS_VERSION;
+    current->app_state = app_state;
+    current->autoranging = is_flag_set(AUTORANGING);
+    current->display_rate = display_rate;
+    memcpy(current->range, mode_ranges, sizeof(mode_ranges));
+    current->range[app_state] = mode_range();
+    memcpy(current->filter_type, filter_type, sizeof(filter_type));
+    memcpy(current->filter_iir_shift, filter_iir_shift, sizeof(filter_iir_shift));
+    current->precision_ranges = precision_ranges;
+    current->crc = settings_crc(current);
+
+    return;
+}
+
+uint16_t settings_crc(const settings_t* current)
 {
-    //reset measurement_time_count
-    measurement_time_count = MEASUREMENT_TIMEOUT;
+    uint16_t crc = 0xFFFF;
+    uint8_t count;
 
-    if(app_state == FREQUENCY)
+    for(count = 0; count < sizeof(*current) - sizeof(current->crc); count++)
     {
-        //if the measured frequency changed, update it on lcd screen
-        if(frequency != old_frequency)
-        {
-            //set MEASURED_VALUE_CHANGE
-            set_flag(MEASURED_VALUE_CHANGE);
-            //set UPDATE_LCD flag
-            set_flag(UPDATE_LCD);
-            old_frequency = frequency;
-        }
+        crc = _crc16_update(crc, ((const uint8_t*) current)[count]);
     }
 
-    else if((app_state == VOLTAGE) | (app_state == RESISTANCE))
+    return (crc);
+}
+
+//measurement logger
+//this task writes the pending log bytes and adds an entry every log interval
+void log_task(void)
+{
+    uint8_t entry[LOG_FULL_ENTRY];
+    uint8_t count;
+    uint32_t now;
+    int32_t value;
+    int32_t delta;
+    uint32_t code;
+    uint16_t address;
+    log_header_t header;
+
+    //reset log_time_count
+    log_time_count = LOG_TIMEOUT;
+
+    //erase and write bytes as long as the EEPROM is ready (a changed byte starts a write, the loop ends until it completes)
+    //saved settings are written by the EEPROM cache first
+    while(eeprom_is_ready() && !eeprom_cache_busy())
     {
-        if(new_voltage != voltage)
+        if(log_erase_length > 0)
         {
-            voltage = new_voltage;
-
-            if(app_state == RESISTANCE)
-            {
-                //calculate the resistance value
-                resistance = (voltage * ref_resistance_val) / (5.0 - voltage);
-                //convert to Kohms
-                resistance = resistance/1000.0;
-            }
+            //from the start of the page, the header is erased first
+            log_erase_length--;
+            eeprom_update_byte(&log_eeprom[log_erase_address], LOG_ERASED);
+            log_erase_address++;
+        }
 
-            //set MEASURED_VALUE_CHANGE
-            set_flag(MEASURED_VALUE_CHANGE);
-            //set UPDATE_LCD flag
-            set_flag(UPDATE_LCD);
+        else if(log_pending_length > 0)
+        {
+            log_pending_length--;
+            eeprom_update_byte(&log_eeprom[log_pending_address + log_pending_length], log_pending[log_pending_length]);
         }
 
-        //if an ADC conversion is not currently going on, start a new conversion
-        if (~ADCSRA & (1<<ADSC))
+        else
         {
-            ADCSRA |= (1<<ADSC);
+            break;
         }
     }
-}
-
-//this task is used to perform autoranging
-void autoranging_task(void)
-{
-    //reset autoranging_time_count
-    autoranging_time_count = AUTORANGING_TIMEOUT;
 
-    if(is_flag_set(AUTORANGING))
+    //an entry waits until the previous one is written (a new page takes about 270ms)
+    if((log_interval == 0) || (log_erase_length > 0) || (log_pending_length > 0))
     {
-        switch(app_state)
-        {
-            case (FREQUENCY):
-            {
-                if(is_flag_set(INCREASE_PRESCALER))
-                {
-                    if(prescaler_index < ((sizeof(prescaler_values)/sizeof(prescaler_values[0]))-1))
-                    {
-                        //update the prescaler value
-                        //increase the prescaler value, since timer1 overflows before input capture occurs
-                        prescaler = prescaler_values[++prescaler_index];
-                        //modify TCCR1B register to set the appropriate prescaler
-                        TCCR1B &= ~(0x07);
-                        TCCR1B |= (0x07 & (prescaler_index+1));
-                        //update range display on lcd
-                        set_flag(RANGE_DISPLAY_UPDATE);
-                        //set UPDATE_LCD flag
-                        set_flag(UPDATE_LCD);
-                    }
+        return;
+    }
 
-                    //cler INCREASE_PRESCALER flag
-                    clear_flag(INCREASE_PRESCALER);
-                }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        now = time_ms;
+    }
 
-                else if(prescaler_index > 0)
-                {
-                    if(frequency > frequency_lower[prescaler_index-1])
-                    {
-                        //update the prescaler value
-                        //decrease prescaler value so that frequency can be measured with higher precision
-                        prescaler = prescaler_values[--prescaler_index];
-                        //modify TCCR1B register to set the appropriate prescaler
-                        TCCR1B &= ~(0x07);
-                        TCCR1B |= (0x07 & (prescaler_index+1));
-                        //update range display on lcd
-                        set_flag(RANGE_DISPLAY_UPDATE);
-                        //set UPDATE_LCD flag
-                        set_flag(UPDATE_LCD);
-                    }
-                }
+    if((int32_t) (now - log_next_ms) < 0)
+    {
+        return;
+    }
 
-                break;
-            }
+    //the other modes have no single reading, the next reading starts a new page (its time is in the header)
+    if(!stats_available())
+    {
+        log_offset = LOG_PAGE_SIZE;
+        log_next_ms += log_interval * 1000UL;
 
-            case (VOLTAGE):
-            {
-                if(voltage > 0.8)
-                {
-                    if(vref == 1.1)
-                    {
-                        //voltage is greater than 0.8v and vref is 1.1v, so change vref to 5.0v
-                        ADMUX &= ~(1<<REFS1);
-                        vref = 5.0;
-                        //update range display on lcd
-                        set_flag(RANGE_DISPLAY_UPDATE);
-                        //set UPDATE_LCD flag
-                        set_flag(UPDATE_LCD);
-                    }
-                }
+        return;
+    }
 
-                else if(voltage < 1.0)
-                {
-                    if(vref == 5.0)
-                    {
-                        //voltage is lesser than 1v and vref is 5.0v, so change vref to 1.1v
-                        ADMUX |= (1<<REFS1);
-                        vref = 1.1;
-                        //update range display on lcd
-                        set_flag(RANGE_DISPLAY_UPDATE);
-                        //set UPDATE_LCD flag
-                        set_flag(UPDATE_LCD);
-                    }
-                }
+    value = stats_live_reading();
+    delta = value - log_value;
+    //zigzag encoding (0, -1, 1, -2 ... map to 0, 1, 2, 3 ...)
+    code = (((uint32_t) delta) << 1) ^ ((uint32_t) (delta >> 31));
 
-                break;
-            }
+    entry[0] = LOG_ESCAPE;
+    memcpy(&entry[1], &value, sizeof(value));
 
-            case(RESISTANCE):
-            {
-                //if measured resistance is greater than 8Kohm, change reference resistance to 10Kohm
-                if(resistance > 8.0 && ref_resistance == R_0)
-                {
-                    //change the reference resistance to 10Kohm
-                    //disable 1Kohm resistance
-                    R_0_PORT &= ~(1<<R_0_LOC);
-                    R_0_CONFIG &= ~(1<<R_0_LOC);
-                    //enable 10Kohm resistor
-                    R_1_CONFIG |= (1<<R_1_LOC);
-                    R_1_PORT |= (1<<R_1_LOC);
-                    ref_resistance = R_1;
-                    ref_resistance_val = 10000;
-                    //update range display on lcd
-                    set_flag(RANGE_DISPLAY_UPDATE);
-                    //set UPDATE_LCD flag
-                    set_flag(UPDATE_LCD);
-                }
+    if((app_state == log_mode) && (code < LOG_ESCAPE) && (log_offset < LOG_PAGE_SIZE))
+    {
+        entry[0] = code;
+        log_write((log_page * LOG_PAGE_SIZE) + log_offset, entry, 1);
+        log_offset++;
+    }
 
-                //if measured resistance is lesser than 6Kohm, change reference resistance to 1Kohm
-                else if(resistance < 6.0 && ref_resistance == R_1)
-                {
-                    //change the reference resistance to 1Kohm
-                    //disable 10Kohm resistance
-                    R_1_PORT &= ~(1<<R_1_LOC);
-                    R_1_CONFIG &= ~(1<<R_1_LOC);
-                    //enable 10Kohm resistor
-                    R_0_CONFIG |= (1<<R_0_LOC);
-                    R_0_PORT |= (1<<R_0_LOC);
-                    ref_resistance = R_0;
-                    ref_resistance_val = 1000;
-                    //update range display on lcd
-                    set_flag(RANGE_DISPLAY_UPDATE);
-                    //set UPDATE_LCD flag
-                    set_flag(UPDATE_LCD);
-                }
+    else if((app_state == log_mode) && (log_offset <= LOG_PAGE_SIZE - LOG_FULL_ENTRY))
+    {
+        log_write((log_page * LOG_PAGE_SIZE) + log_offset, entry, LOG_FULL_ENTRY);
+        log_offset += LOG_FULL_ENTRY;
+    }
 
-                break;
-            }
+    else
+    {
+        //start the next page
+        log_page = (log_page + 1) % LOG_NUM_PAGES;
+        log_sequence++;
+        log_mode = app_state;
+
+        header.sequence = log_sequence;
+        header.time_ms = log_next_ms;
+        header.interval = log_interval;
+        header.mode = log_mode;
+        header.crc = 0;
+
+        for(count = 0; count < sizeof(header) - 1; count++)
+        {
+            header.crc = _crc8_ccitt_update(header.crc, ((const uint8_t*) &header)[count]);
         }
+
+        //the whole page is erased first (starting with the old header, so a page cut short by a power loss is not valid),
+        //then the header and the first entry are written
+        address = log_page * LOG_PAGE_SIZE;
+        log_erase_address = address;
+        log_erase_length = LOG_PAGE_SIZE;
+        log_write(address, (const uint8_t*) &header, sizeof(header));
+        log_write(address + sizeof(header), entry, LOG_FULL_ENTRY);
+        log_offset = sizeof(header) + LOG_FULL_ENTRY;
     }
+
+    log_value = value;
+    log_next_ms += log_interval * 1000UL;
+
+    return;
 }
 
-//this task is used to control the lcd
-void lcd_task(void)
+//find the newest page of the log (an empty log starts in the first page)
+void log_init(void)
 {
-    //reset lcd_time_count
-    lcd_time_count = LCD_TIMEOUT;
+    log_header_t header;
+    uint8_t page;
+    bool found = false;
 
-    //handle any flags if they are set
-    if(is_flag_set(UPDATE_LCD))
+    for(page = 0; page < LOG_NUM_PAGES; page++)
     {
-        if(is_flag_set(APP_STATE_CHANGE))
+        //sequence numbers are compared as differences, so they may wrap around
+        if(log_read_header(page, &header) && (!found || ((int16_t) (header.sequence - log_sequence) > 0)))
         {
-            if(app_state == FREQUENCY)
-            {
-                //reset the lcd screen
-                lcd_reset();
-                //write the appropriate heading string to lcd
-                lcd_print_string_progmem(frequency_string, sizeof(frequency_string)/sizeof(frequency_string[0]),0x80);
-                lcd_print_string_progmem(prescaler_string, sizeof(prescaler_string)/sizeof(prescaler_string[0]),0xC7);
-            }
+            log_page = page;
+            log_sequence = header.sequence;
+            found = true;
+        }
+    }
 
-            else if(app_state == VOLTAGE)
-            {
-                //reset lcd
-                lcd_reset();
-                //write the appropriate heading string to lcd
-                lcd_print_string_progmem(voltage_string, sizeof(voltage_string)/sizeof(voltage_string[0]),0x80);
-                lcd_print_string_progmem(vref_string, sizeof(vref_string)/sizeof(vref_string[0]),0xC6);
-            }
+    //entries are never appended to a page written before the last reset
+    log_offset = LOG_PAGE_SIZE;
 
-            else if(app_state == RESISTANCE)
-            {
-                //reset lcd
-                lcd_reset();
-                //write the appropriate heading string to lcd
-                lcd_print_string_progmem(resistance_string, sizeof(resistance_string)/sizeof(resistance_string[0]),0x80);
-                lcd_print_string_progmem(rref_string, sizeof(rref_string)/sizeof(rref_string[0]),0xC7);
-            }
+    return;
+}
 
-            //clear APP_STATE_CHANGE flag
-            clear_flag(APP_STATE_CHANGE);
-        }
+//start logging with the given interval (s), 0 stops logging
+//the first entry is added now and starts a new page
+void log_start(uint8_t interval)
+{
+    log_interval = interval;
+    log_offset = LOG_PAGE_SIZE;
 
-        if(is_flag_set(MEASURED_VALUE_CHANGE))
-        {
-            if(app_state == FREQUENCY)
-            {
-                //clear the original number present
-                lcd_clear_segment(7,0xC0);
-                //print the new frequency value
-                //number of digits is 7 (max. measurable frequency is 8MHz)
-                lcd_print_num(frequency,7,0xC0);
-            }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        log_next_ms = time_ms;
+    }
 
-            else if(app_state == VOLTAGE)
-            {
-                //clear the original number present
-                lcd_clear_segment(6,0xC0);
-                //print the new voltage value
-                //number of digits is 4
-                char temp[6];
-                dtostrf(voltage, 4, 3, temp);
-                lcd_print_string(temp, 5, 0xC0);
-            }
+    return;
+}
 
-            else if(app_state == RESISTANCE)
-            {
-                //clear the original number present
-                lcd_clear_segment(6,0xC0);
-                //print the resistance value
-                //number of digits is 5
-                char temp[7];
-                dtostrf(resistance, 5, 3, temp);
-                lcd_print_string(temp, 6, 0xC0);
-            }
+//read the header of a page, returns false if it is not valid (erased or cut short by a power loss)
+bool log_read_header(uint8_t page, log_header_t* header)
+{
+    uint8_t crc = 0;
+    uint8_t count;
 
-            //clear MEASURED_VALUE_CHANGE flag
-            clear_flag(MEASURED_VALUE_CHANGE);
-        }
+    eeprom_cache_pause();
+    eeprom_read_block(header, &log_eeprom[page * LOG_PAGE_SIZE], sizeof(*header));
+    eeprom_cache_resume();
 
-        if(is_flag_set(RANGE_DISPLAY_UPDATE))
-        {
-            if(app_state == FREQUENCY)
-            {
-                //clear the portion of the display used for displaying the prescaler value
-                lcd_clear_segment(4,0xCA);
+    for(count = 0; count < sizeof(*header) - 1; count++)
+    {
+        crc = _crc8_ccitt_update(crc, ((const uint8_t*) header)[count]);
+    }
 
-                if(is_flag_set(AUTORANGING))
-                {
-                    //display character "A" to indicate autoranging
-                    lcd_print_string_progmem(auto_range_string, sizeof(auto_range_string)/sizeof(auto_range_string[0]), 0xCF);
-                }
+    return ((crc == header->crc) && (header->interval != 0));
+}
 
-                else
-                {
-                    //display character "M" to indicate autoranging
-                    lcd_print_string_progmem(manual_range_string, sizeof(manual_range_string)/sizeof(manual_range_string[0]), 0xCF);
-                }
+//queue bytes for log_task (they follow the bytes already queued)
+void log_write(uint16_t address, const uint8_t* data, uint8_t length)
+{
+    if(log_pending_length == 0)
+    {
+        log_pending_address = address;
+    }
 
-                //display the selected prescaler
-                lcd_print_num(prescaler, 4, 0xCA);
-            }
+    memcpy(&log_pending[log_pending_length], data, length);
+    log_pending_length += length;
 
-            else if(app_state == VOLTAGE)
-            {
-                //clear the portion of the display used for displaying the vref value
-                lcd_clear_segment(4,0xCA);
+    return;
+}
 
-                if(is_flag_set(AUTORANGING))
-                {
-                    //display character "A" to indicate autoranging
-                    lcd_print_string_progmem(auto_range_string, sizeof(auto_range_string)/sizeof(auto_range_string[0]), 0xCF);
-                }
+//send the log region over the serial port (771 bytes, about 31ms at 250kbaud, the caller waits about 26ms for the transmit buffer)
+void log_dump(void)
+{
+    uint8_t buffer[LOG_PAGE_SIZE];
+    uint8_t page;
 
-                else
-                {
-                    //display character "M" to indicate autoranging
-                    lcd_print_string_progmem(manual_range_string, sizeof(manual_range_string)/sizeof(manual_range_string[0]), 0xCF);
-                }
+    uart_putc(LOG_FRAME_SYNC);
+    uart_putc(LOG_NUM_PAGES);
+    uart_putc(LOG_PAGE_SIZE);
 
-                //display the selected vref value
-                char temp[5];
-                dtostrf(vref, 3, 2, temp);
-                lcd_print_string(temp, 4, 0xCA);
-            }
+    for(page = 0; page < LOG_NUM_PAGES; page++)
+    {
+        eeprom_cache_pause();
+        eeprom_read_block(buffer, &log_eeprom[page * LOG_PAGE_SIZE], LOG_PAGE_SIZE);
+        eeprom_cache_resume();
+        uart_write(buffer, LOG_PAGE_SIZE);
+    }
 
-            else if(app_state == RESISTANCE)
-            {
-                //clear the portion of the display used for displaying the rref value
-                lcd_clear_segment(3,0xCB);
+    return;
+}
 
-                if(is_flag_set(AUTORANGING))
-                {
-                    //display character "A" to indicate autoranging
-                    lcd_print_string_progmem(auto_range_string, sizeof(auto_range_string)/sizeof(auto_range_string[0]), 0xCF);
-                }
+//telemetry
+//send a reading over the serial port as a cobs encoded frame (see telemetry_frame_t)
+//the frame is dropped if the transmit buffer is full
+void telemetry_send(uint8_t quantity, uint8_t range, uint32_t raw, int32_t value)
+{
+    telemetry_frame_t frame;
+    uint8_t encoded[COBS_ENCODED_LENGTH(sizeof(telemetry_frame_t)) + 1];
+    uint8_t length;
+    uint8_t count;
+    uint8_t crc = 0;
 
-                else
-                {
-                    //display character "M" to indicate autoranging
-                    lcd_print_string_progmem(manual_range_string, sizeof(manual_range_string)/sizeof(manual_range_string[0]), 0xCF);
-                }
+    frame.type = TELEMETRY_READING;
 
-                //display the selected vref value
-                if(ref_resistance == R_0)
-                {
-                    lcd_print_string_progmem(r_0_string, sizeof(r_0_string)/sizeof(r_0_string[0]), 0xCB);
-                }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        frame.time_ms = time_ms;
+    }
 
-                else
-                {
-                    lcd_print_string_progmem(r_1_string, sizeof(r_1_string)/sizeof(r_1_string[0]), 0xCB);
-                }
-            }
+    frame.mode = app_state;
+    frame.quantity = quantity;
+    frame.range = range;
+    frame.raw = raw;
+    frame.value = value;
 
-            //clear RANGE_DISPLAY_UPDATE flag
-            clear_flag(RANGE_DISPLAY_UPDATE);
-        }
+    for(count = 0; count < sizeof(frame) - 1; count++)
+    {
+        crc = _crc8_ccitt_update(crc, ((const uint8_t*) &frame)[count]);
+    }
 
-        //clear UPDATE_LCD flag
-        clear_flag(UPDATE_LCD);
+    frame.crc = crc;
+    telemetry_last = frame;
+
+    //the captures of scope and logic mode are sent as raw frames
+    if(MODE_BYTE(flags) & MODE_RAW_FRAMES)
+    {
+        return;
+    }
+
+    //encoded frame and the zero byte that ends it
+    length = cobs_encode((const uint8_t*) &frame, sizeof(frame), encoded);
+    encoded[length++] = 0;
+
+    if(!uart_try_write(encoded, length))
+    {
+        telemetry_dropped++;
     }
+
+    return;
 }
 
 //inter task communication using flags
+//the ISRs set flags too (e.g. CAP_CHARGED, INCREASE_PRESCALER), the read-modify-write of the 16 bit flags
+//must not be interrupted or the bit set by the ISR is lost
 void set_flag(uint8_t val)
 {
-    flags |= (1<<val);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        flags |= (1<<val);
+    }
 }
 
 void clear_flag(uint8_t val)
 {
-    flags &= ~(1<<val);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        flags &= ~(1<<val);
+    }
 }
 
 bool is_flag_set(uint8_t val)
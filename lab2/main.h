@@ -12,13 +12,28 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 //_____Custom libraries_____
 #include "lcd.h"
 #include "avr_delay.h"
+#include "filter.h"
+#include "isqrt.h"
+#include "goertzel.h"
+#include "uart.h"
+#include "stats.h"
+#include "cobs.h"
+#include "eeprom_cache.h"
+#include "fsm.h"
+#include "hal.h"
 
 
 //_____Constants_____
@@ -27,29 +42,330 @@
 #define BUTTON_TIMEOUT 30
 //interval for handling button events (100ms)
 #define BUTTON_EVENT_HANDLER_TIMEOUT 100
-//interval for updating measured value (200ms)
+//interval for updating measured value at the default display rate (200ms)
+//measurement_task then runs once per display period (see display_periods)
 #define MEASUREMENT_TIMEOUT 200
+//interval for collecting decimated adc blocks (20ms, the ring buffer holds 80ms of blocks)
+#define ACQUISITION_TIMEOUT 20
 //interval for autoranging (300ms)
 #define AUTORANGING_TIMEOUT 300
-//interval for updating lcd (500ms)
-#define LCD_TIMEOUT 500
+//interval for checking for lcd updates (50ms), new readings are requested by measurement_task at the display rate
+#define LCD_TIMEOUT 50
+//interval for the periodic task of the current mode (5ms, the capacitance measurement state machine and collecting
+//a completed goertzel block)
+#define MODE_TASK_TIMEOUT 5
+//interval for handling remote commands (10ms)
+#define COMMAND_TIMEOUT 10
+//interval for writing the measurement log to EEPROM (5ms)
+#define LOG_TIMEOUT 5
+//interval for saving changed settings (10s)
+#define SETTINGS_TIMEOUT 10000
 
-//application states (frequency, voltage or resistance measurement)
+//adc acquisition
+//the adc runs in auto trigger mode, each conversion is started by a timer0 compare match
+//4^n consecutive samples are summed and decimated to give n extra bits of resolution
+//default number of extra bits (3 => 64 samples per block, 13 bit result)
+#define ADC_OVERSAMPLE_BITS 3
+//largest supported number of extra bits (64 samples * 1023 still fits in 16 bits)
+#define ADC_MAX_OVERSAMPLE_BITS 3
+//default rate at which decimated blocks are produced (100 blocks per second => 6400 samples per second)
+#define ADC_OUTPUT_RATE 100
+//max. sample rate with adc prescaler 64 is 8MHz/64/13 = 9615 samples per second
+#define ADC_MAX_SAMPLE_RATE 9600
+//number of decimated blocks that can be buffered (must be a power of 2)
+#define ADC_BLOCK_BUFFER_SIZE 8
+//number of conversions discarded after the adc reference is switched (5ms at 6400 samples per second)
+//this covers the reference start up time, the charging of the AREF capacitor and the first (invalid) conversion
+#define ADC_SETTLE_SAMPLES 32
+
+//precision acquisition
+//in precision mode a block is acquired as a burst of conversions started from SLEEP_MODE_ADC (cpu and clkIO halted)
+//the usart is halted too (64 conversions = 6.7ms with 3 oversampling bits), a burst only starts while nothing is
+//being sent and no request is partly received (see the latency of the remote commands)
+//duration of one conversion in micro-seconds (13 adc clock cycles, adc prescaler 64)
+#define ADC_CONVERSION_US ((13UL*64UL*1000000UL)/F_CPU)
+//duration of one timer2 count in micro-seconds (timer2 prescaler 64)
+#define TIMER2_COUNT_US ((64UL*1000000UL)/F_CPU)
+
+//measurement ranges of the adc based modes
+//(used as bit positions in precision_ranges and to index the calibration data)
+#define RANGE_VREF_5V0 0
+#define RANGE_VREF_1V1 1
+//one range per reference resistor, starting at RANGE_RREF_BASE
+#define RANGE_RREF_BASE 2
+#define NUM_RANGES (RANGE_RREF_BASE + NUM_REF_RESISTORS)
+
+//calibration
+//AVCC is measured against the internal bandgap (which is also the 1.1V adc reference)
+//nominal value of the bandgap in mV
+#define BANDGAP_NOMINAL_MV 1100
+//limits for a plausible bandgap value (datasheet: 1.0V to 1.2V)
+#define BANDGAP_MIN_MV 1000
+#define BANDGAP_MAX_MV 1200
+//adc multiplexer setting used to measure the bandgap (MUX3:0 = 1110)
+#define ADC_MUX_BANDGAP ((1<<MUX3) | (1<<MUX2) | (1<<MUX1))
+//conversions discarded after switching the multiplexer and conversions averaged per calibration measurement
+#define CAL_SETTLE_SAMPLES 4
+#define CAL_SAMPLES 16
+//gain corrections are stored in Q14 fixed point (16384 = 1.0)
+#define CAL_GAIN_ONE 16384
+//known voltage that has to be applied to the probe for the user calibration of the bandgap
+//(user calibration is done by holding button 0 while powering up)
+#define CAL_KNOWN_MV 2500
+//interval for measuring AVCC again (10s)
+#define CALIBRATION_TIMEOUT 10000
+
+//application states (frequency, voltage, resistance or capacitance measurement)
 #define FREQUENCY 0
 #define VOLTAGE 1
 #define RESISTANCE 2
+#define CAPACITANCE 3
+//dual mode (frequency and voltage are measured at the same time and shown on one line each)
+#define DUAL 4
+//true rms measurement of ac voltages
+#define AC_RMS 5
+//oscilloscope (triggered capture of the probe voltage)
+#define SCOPE 6
+//logic analyzer (edge timestamps of the frequency probe)
+#define LOGIC 7
+//tone detection (dominant frequency and amplitude of small signals on the adc probe)
+#define TONE 8
+#define NUM_APP_STATES 9
+//measured quantities (the first app states, the other modes use the voltage settings)
+#define NUM_QUANTITIES 4
+
+//peripherals used by a measurement mode (power reduction register bits, see power_select())
+#define POWER_ADC (1<<PRADC)
+#define POWER_TIMER0 (1<<PRTIM0)
+#define POWER_TIMER1 (1<<PRTIM1)
+//peripherals powered up and shut down with the mode (timer2 and the usart are always used, twi and spi never)
+#define POWER_SWITCHED (POWER_ADC | POWER_TIMER0 | POWER_TIMER1)
+#define POWER_ALWAYS_OFF ((1<<PRTWI) | (1<<PRSPI))
 
 //resistors used to form voltage divider (used for resistance measurement)
-//R_0 (1 Kohm)
-#define R_0 0
-#define R_0_CONFIG DDRD
-#define R_0_PORT PORTD
-#define R_0_LOC PD5
-//R_1 (10 Kohm)
-#define R_1 1
-#define R_1_CONFIG DDRC
-#define R_1_PORT PORTC
-#define R_1_LOC PC1
+//the selected reference resistor is driven high, the unknown resistor is connected between the probe and GND
+//(see ref_resistors[] for the pins and values)
+#define NUM_REF_RESISTORS 3
+//resistance status
+#define RESISTANCE_OK 0
+//probe open (code close to full scale on the largest reference resistor)
+#define RESISTANCE_OPEN 1
+//probe shorted (code close to 0 on the smallest reference resistor)
+#define RESISTANCE_SHORT 2
+//open and short limits, full scale/128 and full scale/256 away from the ends of the adc range
+#define RESISTANCE_OPEN_SHIFT 7
+#define RESISTANCE_SHORT_SHIFT 8
+//a different reference resistor is only selected if it moves the code closer to mid scale by at least full scale/16
+#define RESISTANCE_AUTORANGE_MARGIN_SHIFT 4
+
+//capacitance measurement
+//the capacitor (between probe and GND) is discharged through PC0 and then charged through a reference resistor
+//the analog comparator compares the capacitor voltage (ADC0 through the adc multiplexer) with the VCC/2 divider on AIN0,
+//timer1 input capture records the time at which VCC/2 is reached, t = R * C * ln(2)
+//states of the measurement
+#define CAP_START 0
+#define CAP_DISCHARGE 1
+#define CAP_CHARGE 2
+//capacitance status
+#define CAPACITANCE_OK 0
+#define CAPACITANCE_OVERRANGE 1
+//minimum discharge time (ms), the discharge time is at least the last charge time
+//(the pin discharges the capacitor more than 20 times faster than the smallest reference resistor charges it)
+#define CAP_MIN_DISCHARGE_MS 10
+//charge time limit in timer1 counts (2s), longer charges are over range
+#define CAP_MAX_COUNTS (2UL*F_CPU)
+//capacitance in pF = counts * CAP_PF_FACTOR / R (timer1 runs at F_CPU)
+#define CAP_PF_FACTOR ((uint32_t) (1e12/(F_CPU*0.693147)))
+
+//true rms measurement
+//every conversion is used (no oversampling), the sample rate is fixed
+#define AC_SAMPLE_RATE 10000
+//adc prescaler bits (ADPS2:0) for the normal adc clock (125kHz) and the faster ac rms adc clock (250kHz)
+#define ADC_PRESCALER_MASK ((1<<ADPS2) | (1<<ADPS1) | (1<<ADPS0))
+#define ADC_PRESCALER_BITS ((1<<ADPS2) | (1<<ADPS1))
+#define AC_ADC_PRESCALER_BITS ((1<<ADPS2) | (1<<ADPS0))
+//a window is closed on the first rising edge after AC_MIN_SAMPLES samples (100ms)
+#define AC_MIN_SAMPLES 1000
+//the sum of squares of 10 bit samples fits in 32 bits for up to 4096 samples
+//windows without an edge (dc or signals below about 3Hz) are closed unsynchronised after AC_MAX_SAMPLES samples
+#define AC_MAX_SAMPLES 4096
+//window states
+#define AC_WAIT_EDGE 0
+#define AC_ACQUIRE 1
+#define AC_DONE 2
+
+//oscilloscope
+//8 bit samples (ADLAR) in free running mode, the adc prescaler selects the timebase
+//prescaler 16 (500kHz adc clock, 38.5kSa/s) is the fastest setting, faster adc clocks lose more than 2 bits of accuracy
+//and leave too few cycles per sample for the ISR (104 cycles at prescaler 8)
+#define NUM_SCOPE_TIMEBASES 4
+//capture buffer size and number of samples before the trigger
+#define SCOPE_BUFFER_SIZE 384
+#define SCOPE_PRE_TRIGGER 64
+//capture states
+#define SCOPE_ARMING 0
+#define SCOPE_WAIT_TRIGGER 1
+#define SCOPE_POST_TRIGGER 2
+#define SCOPE_DONE 3
+//trigger edges (COMMAND_SCOPE_EDGE, used from the next sample on)
+#define SCOPE_RISING 0
+#define SCOPE_FALLING 1
+//auto trigger, a capture is forced if there was no trigger for this time (ms)
+#define SCOPE_AUTO_MS 400
+//coarse lcd rendering, 8 custom characters side by side (40 x 8 pixels)
+#define SCOPE_GLYPHS 8
+#define SCOPE_COLUMNS (SCOPE_GLYPHS*5)
+//first byte of a capture sent over the serial port (followed by the header and the samples)
+#define SCOPE_FRAME_SYNC 0xA5
+
+//logic analyzer
+//timer1 runs at F_CPU (125ns resolution), every edge is stored as the time since the previous edge
+//(varint, 7 bits per byte, least significant group first, bit 7 set if more bytes follow)
+#define LOGIC_BUFFER_SIZE 512
+//longest varint of a 32 bit delta, the capture ends when less space is left
+#define LOGIC_MAX_VARINT 5
+//a capture ends after this time (ms) if the buffer did not fill up
+#define LOGIC_CAPTURE_MS 1000
+//capture states
+#define LOGIC_IDLE 0
+#define LOGIC_CAPTURE 1
+#define LOGIC_DONE 2
+//first byte of a capture sent over the serial port (followed by the header and the encoded deltas)
+#define LOGIC_FRAME_SYNC 0xA6
+
+//display rates
+//every capture and every decimated block is used, measurement_task reduces everything acquired during a display period
+//into one reading (2Hz, 5Hz or 10Hz, selected in the menu opened by a long press of button 0)
+#define NUM_DISPLAY_RATES 3
+
+//tone detection
+//the probe is sampled at a fixed rate, every block of samples is fed to a few goertzel bins
+//successive blocks sweep through all bins, the largest bin of a sweep gives the dominant frequency
+//bins are TONE_SAMPLE_RATE/TONE_BLOCK_SIZE = 40Hz apart, bins 1 to TONE_NUM_BINS cover 40Hz to 2400Hz
+#define TONE_SAMPLE_RATE 5000
+#define TONE_BLOCK_SIZE 125
+#define TONE_NUM_BINS 60
+//cycle budget :- 1600 cycles per sample at 5kSa/s, the ISR needs about 4*90 cycles for the bins
+//and about 120 cycles for entry, exit, the dc offset and the peak detection (about 30% cpu load)
+#define TONE_BINS_PER_BLOCK 4
+#if (TONE_NUM_BINS % TONE_BINS_PER_BLOCK) != 0
+#error "the blocks of a sweep must end at TONE_NUM_BINS (table of the goertzel coefficients)"
+#endif
+//smallest bin magnitude treated as a tone (0.25 adc counts amplitude, magnitude = amplitude * TONE_BLOCK_SIZE / 2)
+#define TONE_MIN_MAGNITUDE 16
+//block states
+#define TONE_ACQUIRE 0
+#define TONE_DONE 1
+
+//serial port
+#define UART_BAUD 250000UL
+
+//telemetry
+//every reading is sent over the serial port as a cobs encoded frame followed by a zero byte (tools/telemetry.c decodes them)
+//a frame is dropped if it does not fit in the transmit buffer, the scheduler never waits for the serial port
+//19 bytes per frame at 100 blocks per second use less than 10% of the 250kbaud link
+//(there is no telemetry in scope and logic mode, the captures are sent as raw frames)
+//frame types (first byte of a frame)
+#define TELEMETRY_READING 0x01
+#define TELEMETRY_RESPONSE 0x02
+//resistance values sent for an open or shorted probe
+#define TELEMETRY_OPEN (-1)
+#define TELEMETRY_SHORT (-2)
+
+//remote commands
+//a request is a cobs encoded frame followed by a zero byte :- command, sequence number, argument (if any), crc8 of the bytes before
+//every request with a valid crc is answered with a response frame (same framing as the telemetry) :-
+//TELEMETRY_RESPONSE, command, sequence number, status, data (see the commands), crc8 of the bytes before
+//the uart receive ISR collects the bytes of a request, command_task decodes and executes it
+//latency :- command_task runs every COMMAND_TIMEOUT, a request is handled at most 10ms plus the longest other task after its end
+//(a logic or scope capture sent over the serial port, at most 16ms waiting for the transmit buffer, see uart.h)
+//and the response is sent after the bytes already in the transmit buffer (at most 128 bytes = 5ms at 250kbaud),
+//so requests are answered within 35ms, except COMMAND_LOG_DUMP (the worst case) :- the 771 bytes of the log are sent
+//before the response (26ms waiting for the transmit buffer), it is answered within 60ms (10 + 16 + 26 + 5 + 1ms for the response)
+//in precision mode (voltage and resistance mode, by default on the 1.1V range) the usart is halted for the bursts of
+//conversions (6.7ms every display period), a burst is skipped while a request is partly received, but the bytes of a
+//request that starts during a burst are lost (no response, the request has to be sent again after the bounds above),
+//a response or telemetry frame is never stretched (the transmitter is idle before a burst)
+//select the app state (argument :- app state)
+#define COMMAND_SET_MODE 0x10
+//select a range of the current mode and switch autoranging off (argument :- prescaler index, reference, reference resistor,
+//capacitance range or scope timebase)
+#define COMMAND_SET_RANGE 0x11
+//switch autoranging on or off (argument :- 1 or 0), the auto trigger in scope mode and continuous captures in logic mode
+#define COMMAND_SET_AUTORANGING 0x12
+//select the display rate (argument :- index of display_periods)
+#define COMMAND_SET_RATE 0x13
+//start a new measurement, the next reading only uses data acquired after the request (a new capture in scope and logic mode)
+#define COMMAND_TRIGGER 0x14
+//data :- last reading sent as telemetry (time, mode, quantity, range, raw and scaled value as in telemetry_frame_t)
+#define COMMAND_QUERY 0x15
+//data :- last and longest ADC ISR (timer0 ticks), blocks dropped by the adc ring buffer (16 bit), dropped telemetry frames (16 bit)
+//argument (optional) :- 1 resets the longest ISR
+#define COMMAND_PROFILER 0x16
+//data :- statistics view, number of values (32 bit), min, max, mean and standard deviation (32 bit each)
+#define COMMAND_STATS 0x17
+//start logging (argument :- log interval in s, 0 stops logging), data :- log interval, page being written, its sequence number (16 bit)
+#define COMMAND_LOG 0x18
+//the log region is sent as a raw frame (see log_dump) before the response
+#define COMMAND_LOG_DUMP 0x19
+//number of switches to each range (argument :- index of the first counter, see range_switch_count),
+//data :- up to RANGE_SWITCH_REPLY counters from that index (16 bit each)
+#define COMMAND_RANGE_SWITCHES 0x1A
+#define RANGE_SWITCH_REPLY 10
+//select the trigger edge of scope mode (argument :- SCOPE_RISING or SCOPE_FALLING), data :- trigger edge
+#define COMMAND_SCOPE_EDGE 0x1B
+//status of a response
+#define COMMAND_OK 0
+#define COMMAND_UNKNOWN 1
+#define COMMAND_INVALID 2
+//largest decoded request and largest data of a response
+#define COMMAND_REQUEST_SIZE 8
+#define COMMAND_MAX_DATA 21
+
+//measurement logger
+//the reading of the current mode (frequency, voltage, resistance or capacitance) is stored in EEPROM every log interval
+//the log region is a ring of pages that are written in turn (wear levelling), a page is erased before it is written,
+//so every cell takes two erase/write cycles per pass (eeprom_update_byte() always uses the atomic erase and write mode)
+//page :- header (see log_header_t), then one entry per log interval, the first entry of a page is a full value
+//entry :- zigzag encoded difference to the previous reading (0x00 to 0xFD, -127 to +126)
+//or LOG_ESCAPE followed by the 32 bit reading, erased bytes (LOG_ERASED) end the page
+//a new page is started when the page is full, the mode changes or a log interval passes without a reading
+//the newest page with a valid header (highest sequence number) is found at power up, logging continues in the page after it
+//the bytes are written by log_task while the EEPROM is ready (3.4ms per byte), the scheduler never waits for the EEPROM
+//bytes are written from the end of an entry to its start, an entry cut short by a power loss still reads as erased
+#define LOG_PAGE_SIZE 64
+#define LOG_NUM_PAGES 12
+#define LOG_ESCAPE 0xFE
+#define LOG_ERASED 0xFF
+//length of an escaped entry
+#define LOG_FULL_ENTRY 5
+//log interval used when logging is started from the menu (s)
+#define LOG_DEFAULT_INTERVAL 10
+//first byte of the log region sent over the serial port (followed by the number of pages, the page size and the pages)
+#define LOG_FRAME_SYNC 0xA7
+
+//settings
+//the mode, autoranging, display rate, filter settings and the last range of every mode are kept in EEPROM (see settings_t)
+//and restored at power up, so the first reading is taken in the range that was used last and shown after one display period
+//settings_task saves them when they did not change for a whole SETTINGS_TIMEOUT (so not on every autoranging step),
+//through the write-behind EEPROM cache (only the changed bytes are written, the scheduler never waits)
+//settings with a wrong version or crc (never saved or cut short by a power loss) are replaced by the defaults
+#define SETTINGS_VERSION 1
+//the power up message is only shown if no settings were restored (lcd_task starts after it, measurements start at once)
+#define SPLASH_MS 2000
+
+//statistics of the displayed quantity (frequency, voltage, resistance or capacitance mode)
+//every reading is added (every decimated block for voltage and resistance), the views replace the live reading
+#define STATS_LIVE 0
+#define STATS_MIN 1
+#define STATS_MAX 2
+#define STATS_AVG 3
+#define STATS_SDEV 4
+//reading at the time the view was selected
+#define STATS_HOLD 5
+//difference between the live reading and the reading at the time the view was selected
+#define STATS_REL 6
+#define NUM_STATS_VIEWS 7
 
 //button configuration (used to get input from user)
 //button 0 (used to chang application state i.e the quantity being measured : frequency, voltage or resistance)
@@ -61,6 +377,151 @@
 //button 2 (used to change measurement range manually when autoranging is disabled)
 #define BUTTON_2_PORT PIND
 #define BUTTON_2_LOC PD3
+//a button held for 1s gives a long press event instead of the normal event
+//(button 0 :- open the menu, button 1 :- start new statistics, button 2 :- select the next statistics view)
+#define BUTTON_LONG_PRESS (1000/BUTTON_TIMEOUT)
+
+//autoranging thresholds of one range (ranges are ordered from the most to the least sensitive one)
+//the gap between the "down" threshold of a range and the "up" threshold of the range below it is the hysteresis
+typedef struct
+{
+    //switch to the next (less sensitive) range above this value
+    uint32_t up;
+    //switch to the previous (more sensitive) range below this value
+    uint32_t down;
+} autorange_threshold_t;
+
+//reference resistor (used for resistance measurement)
+typedef struct
+{
+    volatile uint8_t* config;
+    volatile uint8_t* port;
+    uint8_t loc;
+    //nominal value in ohm
+    uint32_t value;
+    //string displayed as the selected range
+    const prog_uchar* name;
+} ref_resistor_t;
+
+//calibration data (stored in EEPROM, a copy is kept in sram)
+typedef struct
+{
+    //measured value of the internal bandgap in mV
+    uint16_t bandgap_mv;
+    //offset correction of every range (uV for voltage ranges, ohm for resistance ranges)
+    int16_t offset[NUM_RANGES];
+    //gain correction of every range (Q14)
+    uint16_t gain[NUM_RANGES];
+} calibration_t;
+
+//filtered measurement of one quantity
+typedef struct
+{
+    filter_t filter;
+    //last filtered value that was displayed
+    int32_t displayed_value;
+    bool displayed_value_valid;
+} measurement_channel_t;
+
+//telemetry frame (before cobs encoding, multi byte values are little endian, packed so the host build sends the same bytes)
+typedef struct
+{
+    uint8_t type;
+    //time since power up (ms)
+    uint32_t time_ms;
+    //app state and measured quantity (the quantities of dual mode are sent in separate frames)
+    uint8_t mode;
+    uint8_t quantity;
+    //range (prescaler index for frequency, adc range for voltage and resistance, capacitance range)
+    uint8_t range;
+    //raw measurement (timer1 counts, decimated adc block, window samples ...)
+    uint32_t raw;
+    //scaled value (Hz, uV, ohm or pF)
+    int32_t value;
+    //crc8 (polynomial 0x07) of the bytes before
+    uint8_t crc;
+} __attribute__((packed)) telemetry_frame_t;
+
+//settings stored in EEPROM (at most EEPROM_CACHE_SIZE bytes)
+typedef struct
+{
+    uint8_t version;
+    uint8_t app_state;
+    uint8_t autoranging;
+    uint8_t display_rate;
+    //last range of every mode (argument of select_range)
+    uint8_t range[NUM_APP_STATES];
+    uint8_t filter_type[NUM_QUANTITIES];
+    uint8_t filter_iir_shift[NUM_QUANTITIES];
+    uint8_t precision_ranges;
+    //crc16 (avr-libc _crc16_update, initial value 0xFFFF) of the bytes before
+    uint16_t crc;
+} settings_t;
+
+//the settings are kept by the EEPROM cache (see settings_load)
+_Static_assert(sizeof(settings_t) <= EEPROM_CACHE_SIZE, "settings_t does not fit in the EEPROM cache");
+
+//header of a page of the measurement log (multi byte values are little endian, packed as in the telemetry frame)
+typedef struct
+{
+    //incremented for every page (the newest page has the highest number)
+    uint16_t sequence;
+    //time since power up of the first entry (ms)
+    uint32_t time_ms;
+    //time between two entries (s)
+    uint8_t interval;
+    //app state of the readings
+    uint8_t mode;
+    //crc8 (polynomial 0x07) of the bytes before
+    uint8_t crc;
+} __attribute__((packed)) log_header_t;
+
+//measurement mode descriptor (one per app state in modes[], called through MODE_HOOK())
+//the tasks dispatch to the hooks of the current mode, a hook with nothing to do is mode_nothing
+typedef struct
+{
+    //set up the mode after its peripherals were powered up, restore the shared peripherals before leaving it
+    void (*enter)(void);
+    void (*exit)(void);
+    //peripherals used by the mode (POWER_ bits), the others are shut down while the mode is selected
+    uint8_t power;
+    //one reading per display period (measurement_task)
+    void (*sample)(void);
+    //collect the decimated adc blocks (acquisition_task)
+    void (*acquire)(void);
+    //autoranging (autoranging_task)
+    void (*autorange)(void);
+    //select a range (false if it does not exist), the selected range and the next range (button 2)
+    bool (*set_range)(uint8_t range);
+    uint8_t (*get_range)(void);
+    void (*next_range)(void);
+    //lcd: headings (APP_STATE_CHANGE), measured value (MEASURED_VALUE_CHANGE) and range (RANGE_DISPLAY_UPDATE)
+    void (*layout)(void);
+    void (*format)(void);
+    void (*format_range)(void);
+    //periodic task of the mode, every MODE_TASK_TIMEOUT (mode_task)
+    void (*task)(void);
+    //quantity measured (FREQUENCY to CAPACITANCE), selects the filter settings
+    uint8_t quantity;
+    //reading added to the statistics, NULL if the mode has no statistics views
+    uint32_t* reading;
+    //use a decimated adc block (statistics and telemetry, adc_collect_blocks)
+    void (*block)(uint16_t block);
+    //start a new measurement (COMMAND_TRIGGER)
+    void (*trigger)(void);
+    //MODE_ bits
+    uint8_t flags;
+} measurement_mode_t;
+
+//flags of a measurement mode
+//the adc must not be polled to measure AVCC (calibration_task)
+#define MODE_ADC_BUSY 0x01
+//the readings are sent as raw frames (captures) instead of telemetry frames
+#define MODE_RAW_FRAMES 0x02
+//precision acquisition may be selected (nothing else needs clkIO while sleeping, adc_precision_selected)
+#define MODE_PRECISION 0x04
+//AUTORANGING is the auto trigger and not autoranging, a selected range keeps it (COMMAND_SET_RANGE)
+#define MODE_AUTO_TRIGGER 0x08
 
 //button debounce state machine
 //states
@@ -85,13 +546,27 @@
 #define INCREASE_PRESCALER 4
 //display selected range on lcd
 #define RANGE_DISPLAY_UPDATE 5
-//button events
-//button 0 event
-#define BUTTON_0_EVENT 6
-//button 1 event
-#define BUTTON_1_EVENT 7
-//button 2 event
-#define BUTTON_2_EVENT 8
+//capacitor has been charged to VCC/2 (set by timer1 capture ISR in capacitance mode)
+#define CAP_CHARGED 6
+//frequency changed (dual mode, MEASURED_VALUE_CHANGE is used for the voltage)
+#define FREQUENCY_VALUE_CHANGE 7
+
+//user interface state machine (ui_fsm, see fsm.h)
+//states
+//the screen of the current mode is shown
+#define UI_MEASURE 0
+//the menu is shown (button 2 selects the display rate, button 1 starts or stops logging, button 0 closes the menu)
+#define UI_MENU 1
+#define NUM_UI_STATES 2
+//button events (posted by button_task, handled by button_event_handler_task)
+//(there is no release event after a long press)
+#define BUTTON_0_EVENT 0
+#define BUTTON_1_EVENT 1
+#define BUTTON_2_EVENT 2
+#define BUTTON_0_LONG_EVENT 3
+#define BUTTON_1_LONG_EVENT 4
+#define BUTTON_2_LONG_EVENT 5
+#define NUM_UI_EVENTS 6
 
 
 //_____Global variables_____
@@ -107,14 +582,54 @@ const prog_uchar resistance_string[] PROGMEM = {"RESISTANCE(Kohm)"};
 const prog_uchar rref_string[] PROGMEM = {"Rref"};
 const prog_uchar r_0_string[] PROGMEM = {"1K"};
 const prog_uchar r_1_string[] PROGMEM = {"10K"};
+const prog_uchar r_2_string[] PROGMEM = {"100K"};
+const prog_uchar capacitance_string[] PROGMEM = {"CAPACITANCE:-"};
+const prog_uchar pf_string[] PROGMEM = {"pF"};
+const prog_uchar nf_string[] PROGMEM = {"nF"};
+const prog_uchar uf_string[] PROGMEM = {"uF"};
+const prog_uchar overrange_string[] PROGMEM = {"OL"};
+const prog_uchar open_string[] PROGMEM = {"OPEN"};
+const prog_uchar short_string[] PROGMEM = {"SHORT"};
+const prog_uchar bandgap_cal_string[] PROGMEM = {"BANDGAP CAL(mV)"};
+const prog_uchar hz_string[] PROGMEM = {"Hz"};
+const prog_uchar volt_string[] PROGMEM = {"V"};
+const prog_uchar rms_string[] PROGMEM = {"RMS"};
+const prog_uchar dc_string[] PROGMEM = {"DC"};
+const prog_uchar peak_to_peak_string[] PROGMEM = {"PP"};
+const prog_uchar synced_string[] PROGMEM = {"S"};
+const prog_uchar scope_string[] PROGMEM = {"SCOPE(Sa/s)"};
+const prog_uchar trigger_string[] PROGMEM = {"T"};
+const prog_uchar logic_string[] PROGMEM = {"LOGIC(edges):-"};
+const prog_uchar tone_string[] PROGMEM = {"TONE(Hz)"};
+const prog_uchar mv_string[] PROGMEM = {"mV"};
+const prog_uchar no_tone_string[] PROGMEM = {"----"};
+const prog_uchar min_string[] PROGMEM = {"MIN"};
+const prog_uchar max_string[] PROGMEM = {"MAX"};
+const prog_uchar avg_string[] PROGMEM = {"AVG"};
+const prog_uchar sdev_string[] PROGMEM = {"SDEV"};
+const prog_uchar hold_string[] PROGMEM = {"HOLD"};
+const prog_uchar rel_string[] PROGMEM = {"REL"};
+const prog_uchar count_string[] PROGMEM = {"n"};
+const prog_uchar rate_string[] PROGMEM = {"UPDATE RATE(Hz)"};
+const prog_uchar log_string[] PROGMEM = {"LOG"};
+const prog_uchar off_string[] PROGMEM = {"OFF"};
 
 //application
 //set default application state to frequency measurement
 uint8_t app_state = FREQUENCY;
 
 //frequency measurement
-volatile uint32_t frequency = 0;
-volatile uint32_t old_frequency = 0;
+//frequency of all periods captured during the last display period
+uint32_t frequency = 0;
+//sum of the captured periods (timer1 counts) and number of periods since the last reading
+volatile uint32_t frequency_ticks = 0;
+volatile uint32_t frequency_periods = 0;
+//timer1 overflowed since the last reading (no signal or the prescaler is too small)
+volatile bool frequency_overflow = false;
+//the next capture does not give a whole period (after an overflow or a prescaler change)
+volatile bool frequency_discard = true;
+//filtered frequency (displayed value)
+uint32_t filtered_frequency = 0;
 volatile uint16_t tick_val = 0;
 //autoranging values
 const uint16_t prescaler_values[5] = {1, 8, 64, 256, 1024};
@@ -124,36 +639,282 @@ const uint16_t frequency_lower[5] = {2000, 1000, 500, 100, 0};
 uint8_t prescaler_index = 0;
 uint16_t prescaler = 1;
 
-//voltage measurement
-volatile uint16_t adch = 0;
-volatile uint16_t adcl = 0;
-volatile float voltage = 0;
-volatile float new_voltage = 0;
-//default value of VREF is 5.0V
-volatile float vref = 5.0;
+//adc acquisition
+//ring buffer of decimated blocks (written by ADC ISR, read by measurement_task)
+volatile uint16_t adc_blocks[ADC_BLOCK_BUFFER_SIZE];
+volatile uint8_t adc_block_head = 0;
+volatile uint8_t adc_block_tail = 0;
+//number of blocks dropped because the ring buffer was full
+volatile uint16_t adc_block_overruns = 0;
+//running sum of the samples of the current block
+volatile uint16_t adc_accumulator = 0;
+//samples still needed to complete the current block
+volatile uint8_t adc_samples_remaining = 0;
+//conversions still to be discarded while the reference settles
+volatile uint8_t adc_discard_samples = 0;
+//oversampling configuration (see adc_configure())
+uint8_t adc_oversample_bits = ADC_OVERSAMPLE_BITS;
+uint16_t adc_output_rate = ADC_OUTPUT_RATE;
+//timer0 settings used to trigger conversions at the required sample rate
+uint8_t adc_timer0_ocr = 0;
+uint8_t adc_timer0_prescaler_bits = 0;
+//sum and number of the filtered blocks collected for the reading of the current display period
+uint32_t adc_reading_sum = 0;
+uint16_t adc_reading_blocks = 0;
 
-//resistance measurement
-float resistance = 0;
-//reference resistor selected initially is R_0 (1 Kohm)
-uint8_t ref_resistance = R_0;
-//reference resistance value is by default set to 1Kohm
-uint16_t ref_resistance_val = 1000;
+//filtering of the measured values
+//filter type, iir shift (alpha = 1/2^shift) and display change threshold for every measured quantity
+//thresholds are in Hz for frequency and in counts of a decimated adc block for voltage and resistance
+//(capacitance values can exceed the range of the iir and moving average filters, so the median filter is used)
+uint8_t filter_type[NUM_QUANTITIES] = {FILTER_MEDIAN, FILTER_IIR, FILTER_MOVING_AVERAGE, FILTER_MEDIAN};
+uint8_t filter_iir_shift[NUM_QUANTITIES] = {2, 2, 2, 2};
+uint16_t change_threshold[NUM_QUANTITIES] = {0, 2, 2, 0};
+//filter state and last displayed value of the current quantity (the voltage in dual mode)
+//the filter is reset on every mode or range change
+measurement_channel_t measurement_channel;
+//frequency channel of dual mode
+measurement_channel_t frequency_channel;
+
+//precision acquisition is always used on the 1.1V reference by default
+uint8_t precision_ranges = (1<<RANGE_VREF_1V1);
+
+//calibration
+//calibration data in EEPROM (defaults are used until a calibration is stored)
+calibration_t EEMEM calibration_eeprom = {BANDGAP_NOMINAL_MV, {0, 0, 0, 0, 0}, {CAL_GAIN_ONE, CAL_GAIN_ONE, CAL_GAIN_ONE, CAL_GAIN_ONE, CAL_GAIN_ONE}};
+//copy of the calibration data in sram
+calibration_t calibration;
+//value of AVCC measured against the bandgap (uV)
+uint32_t avcc_uv = 5000000;
+//values derived from the calibration data (updated by calibration_update())
+//uV per count of a decimated block for the 5.0V and 1.1V references (Q8)
+uint32_t voltage_scale_q8[2];
+//value of each reference resistor after gain correction (ohm)
+uint32_t ref_resistance_cal[NUM_REF_RESISTORS];
+
+//voltage measurement (uV)
+uint32_t voltage = 0;
+uint32_t new_voltage = 0;
+//default reference is AVCC (5.0V range)
+uint8_t vref_range = RANGE_VREF_5V0;
+//voltage autoranging (uV), 1.1V reference below 0.85V, 5.0V reference above 0.95V
+const uint8_t voltage_autorange_ranges[2] = {RANGE_VREF_1V1, RANGE_VREF_5V0};
+const autorange_threshold_t voltage_autorange_table[2] = {{950000, 0}, {UINT32_MAX, 850000}};
+
+//autoranging statistics (number of times each range was switched to, automatically or not, COMMAND_RANGE_SWITCHES)
+//the adc ranges (RANGE_ indices) are followed by the frequency prescalers and the capacitance ranges
+#define SWITCH_FREQUENCY_BASE NUM_RANGES
+#define SWITCH_CAPACITANCE_BASE (SWITCH_FREQUENCY_BASE + sizeof(prescaler_values)/sizeof(prescaler_values[0]))
+#define NUM_RANGE_SWITCH_COUNTS (SWITCH_CAPACITANCE_BASE + NUM_REF_RESISTORS)
+uint16_t range_switch_count[NUM_RANGE_SWITCH_COUNTS];
+
+//resistance measurement (ohm)
+uint32_t resistance = 0;
+uint8_t resistance_status = RESISTANCE_OK;
+//reference resistors, ordered by increasing value
+//with the code kept close to mid scale this covers about 100ohm to 1Mohm
+const ref_resistor_t ref_resistors[NUM_REF_RESISTORS] =
+{
+    {&DDRD, &PORTD, PD5, 1000, r_0_string},
+    {&DDRC, &PORTC, PC1, 10000, r_1_string},
+    {&DDRD, &PORTD, PD4, 100000, r_2_string}
+};
+//reference resistor selected initially is the 1 Kohm resistor
+uint8_t ref_resistance = 0;
+
+//capacitance measurement (pF)
+uint32_t capacitance = 0;
+uint8_t capacitance_status = CAPACITANCE_OK;
+volatile uint8_t cap_state = CAP_START;
+//timer1 overflows since the start of the charge
+volatile uint16_t cap_overflows = 0;
+//charge time in timer1 counts (written by the timer1 capture ISR)
+volatile uint32_t cap_counts = 0;
+//remaining discharge time (ms)
+uint16_t cap_discharge_time = 0;
+//capacitance range, 0 is the largest reference resistor (smallest capacitors)
+uint8_t cap_range = 0;
+//autoranging thresholds in timer1 counts, switch to a 10 times smaller resistor above 0.25s
+//and back to the larger one below 12.5ms
+const autorange_threshold_t cap_autorange_table[NUM_REF_RESISTORS] = {{2000000, 0}, {2000000, 100000}, {UINT32_MAX, 100000}};
+
+//true rms measurement
+//window accumulators (written by the ADC and timer1 capture ISRs until the window is done)
+volatile uint8_t ac_state = AC_WAIT_EDGE;
+volatile uint32_t ac_sum = 0;
+volatile uint32_t ac_sum_sq = 0;
+volatile uint16_t ac_count = 0;
+volatile uint16_t ac_min = 0;
+volatile uint16_t ac_max = 0;
+//window started and ended on a rising edge (whole number of signal periods)
+volatile bool ac_synced = false;
+//results of the last window (uV), rms of the ac component, mean (dc offset) and peak to peak value
+uint32_t ac_rms = 0;
+uint32_t ac_mean = 0;
+uint32_t ac_peak_to_peak = 0;
+bool ac_rms_synced = false;
+//ADC ISR profiler (ac rms and tone mode), duration of the last and the longest ISR in timer0 ticks (1us)
+//the budget at 10kSa/s is 100 ticks per sample
+volatile uint8_t adc_isr_ticks = 0;
+volatile uint8_t adc_isr_ticks_max = 0;
+
+//oscilloscope
+//circular capture buffer (one byte per sample), written by the ADC ISR until the capture is done
+volatile uint8_t scope_buffer[SCOPE_BUFFER_SIZE];
+volatile uint16_t scope_index = 0;
+volatile uint16_t scope_remaining = 0;
+volatile uint8_t scope_state = SCOPE_DONE;
+volatile uint8_t scope_previous = 0;
+uint8_t scope_trigger_level = 128;
+uint8_t scope_trigger_edge = SCOPE_RISING;
+//time spent waiting for a trigger (ms)
+uint16_t scope_wait_ms = 0;
+//timebase (adc prescaler 16, 32, 64 or 128)
+uint8_t scope_timebase = 0;
+const uint8_t scope_prescaler_bits[NUM_SCOPE_TIMEBASES] = {(1<<ADPS2), ((1<<ADPS2) | (1<<ADPS0)), ((1<<ADPS2) | (1<<ADPS1)), ((1<<ADPS2) | (1<<ADPS1) | (1<<ADPS0))};
+//lcd rendering of the last capture (custom character patterns)
+uint8_t scope_glyphs[SCOPE_GLYPHS][8];
+
+//logic analyzer
+//delta encoded edge timestamps, written by the timer1 capture ISR while capturing
+volatile uint8_t logic_buffer[LOGIC_BUFFER_SIZE];
+volatile uint16_t logic_index = 0;
+volatile uint16_t logic_edges = 0;
+volatile uint8_t logic_state = LOGIC_IDLE;
+//timer1 overflows since the start of the capture
+volatile uint16_t logic_overflows = 0;
+//time of the previous edge (timer1 counts since the start of the capture)
+volatile uint32_t logic_last_time = 0;
+//signal level at the start of the capture
+uint8_t logic_initial_level = 0;
+//time since the start of the capture (ms)
+uint16_t logic_capture_ms = 0;
+//edges of the last completed capture (displayed)
+uint16_t logic_captured_edges = 0;
+
+//tone detection
+//goertzel bins of the current block, updated by the ADC ISR
+goertzel_t tone_bins[TONE_BINS_PER_BLOCK];
+volatile uint8_t tone_state = TONE_DONE;
+volatile uint8_t tone_count = 0;
+//largest adc code of the current sweep (used for autoranging)
+volatile uint16_t tone_peak = 0;
+//sum of the adc codes of the current block and the dc offset subtracted from the samples (mean of the previous block)
+//the offset is not valid after a reference switch, the first block then only measures the offset
+volatile uint32_t tone_sum = 0;
+int16_t tone_offset = 512;
+bool tone_offset_valid = false;
+//first bin of the current block
+uint8_t tone_first_bin = 1;
+//largest bin of the current sweep and the magnitudes of its neighbours
+uint8_t tone_sweep_bin = 0;
+uint32_t tone_sweep_magnitude = 0;
+uint32_t tone_sweep_before = 0;
+uint32_t tone_sweep_after = 0;
+uint32_t tone_previous_magnitude = 0;
+//result of the last sweep, frequency (Hz) and amplitude (uV)
+uint16_t tone_frequency = 0;
+uint32_t tone_amplitude = 0;
+bool tone_detected = false;
+//amplitude correction of a tone between two bins (1/sinc of the offset from the bin in 1/16 bins, Q8)
+const uint16_t tone_amplitude_correction[9] PROGMEM = {256, 258, 263, 271, 284, 302, 326, 359, 402};
+//goertzel coefficients of bins 1 to TONE_NUM_BINS (Q14, computed at compile time, see GOERTZEL_COEFF())
+#define TONE_COEFF(bin) GOERTZEL_COEFF(bin, TONE_BLOCK_SIZE)
+const int16_t tone_coeffs[TONE_NUM_BINS] PROGMEM =
+{
+    TONE_COEFF(1), TONE_COEFF(2), TONE_COEFF(3), TONE_COEFF(4), TONE_COEFF(5), TONE_COEFF(6),
+    TONE_COEFF(7), TONE_COEFF(8), TONE_COEFF(9), TONE_COEFF(10), TONE_COEFF(11), TONE_COEFF(12),
+    TONE_COEFF(13), TONE_COEFF(14), TONE_COEFF(15), TONE_COEFF(16), TONE_COEFF(17), TONE_COEFF(18),
+    TONE_COEFF(19), TONE_COEFF(20), TONE_COEFF(21), TONE_COEFF(22), TONE_COEFF(23), TONE_COEFF(24),
+    TONE_COEFF(25), TONE_COEFF(26), TONE_COEFF(27), TONE_COEFF(28), TONE_COEFF(29), TONE_COEFF(30),
+    TONE_COEFF(31), TONE_COEFF(32), TONE_COEFF(33), TONE_COEFF(34), TONE_COEFF(35), TONE_COEFF(36),
+    TONE_COEFF(37), TONE_COEFF(38), TONE_COEFF(39), TONE_COEFF(40), TONE_COEFF(41), TONE_COEFF(42),
+    TONE_COEFF(43), TONE_COEFF(44), TONE_COEFF(45), TONE_COEFF(46), TONE_COEFF(47), TONE_COEFF(48),
+    TONE_COEFF(49), TONE_COEFF(50), TONE_COEFF(51), TONE_COEFF(52), TONE_COEFF(53), TONE_COEFF(54),
+    TONE_COEFF(55), TONE_COEFF(56), TONE_COEFF(57), TONE_COEFF(58), TONE_COEFF(59), TONE_COEFF(60)
+};
+
+//statistics
+stats_t measurement_stats;
+uint8_t stats_view = STATS_LIVE;
+//reading held (STATS_HOLD) or used as the reference (STATS_REL)
+uint32_t stats_reference = 0;
+//the relative reading is below the reference
+bool stats_negative = false;
+//names of the views (shown instead of the heading)
+const prog_uchar* const stats_view_names[NUM_STATS_VIEWS] = {NULL, min_string, max_string, avg_string, sdev_string, hold_string, rel_string};
+
+//telemetry
+//frames dropped because the transmit buffer was full
+uint16_t telemetry_dropped = 0;
+//last reading (answer to COMMAND_QUERY)
+telemetry_frame_t telemetry_last;
+
+//settings
+//settings in EEPROM (erased until the first save)
+settings_t EEMEM settings_eeprom;
+//settings last saved or restored and the settings seen by the last run of settings_task
+settings_t settings;
+settings_t settings_pending;
+//last range of every mode, the range of a mode is selected again when the mode is entered
+uint8_t mode_ranges[NUM_APP_STATES] = {0};
+
+//measurement logger
+//log region in EEPROM
+uint8_t EEMEM log_eeprom[LOG_NUM_PAGES * LOG_PAGE_SIZE];
+//log interval (s), logging is off if it is 0
+uint8_t log_interval = 0;
+//page being written, its sequence number and the offset of the next entry
+uint8_t log_page = LOG_NUM_PAGES - 1;
+uint16_t log_sequence = 0;
+uint8_t log_offset = LOG_PAGE_SIZE;
+//mode of the page and the last reading written to it
+uint8_t log_mode;
+int32_t log_value;
+//time of the next entry (ms)
+uint32_t log_next_ms;
+//bytes waiting to be written (from the end), a page header followed by a full entry at most
+uint8_t log_pending[sizeof(log_header_t) + LOG_FULL_ENTRY];
+uint16_t log_pending_address;
+uint8_t log_pending_length = 0;
+//bytes waiting to be erased (from the start, the address is advanced)
+uint16_t log_erase_address;
+uint8_t log_erase_length = 0;
+
+//display rate
+//interval between two readings (ms)
+const uint16_t display_periods[NUM_DISPLAY_RATES] = {500, 200, 100};
+uint8_t display_rate = 1;
 
 //scheduler related variables
+//time since power up (ms)
+volatile uint32_t time_ms = 0;
 volatile uint16_t button_time_count = BUTTON_TIMEOUT;
 volatile uint16_t button_event_handler_time_count = BUTTON_EVENT_HANDLER_TIMEOUT;
 volatile uint16_t measurement_time_count = MEASUREMENT_TIMEOUT;
+volatile uint16_t acquisition_time_count = ACQUISITION_TIMEOUT;
 volatile uint16_t autoranging_time_count = AUTORANGING_TIMEOUT;
 volatile uint16_t lcd_time_count = LCD_TIMEOUT;
+volatile uint16_t calibration_time_count = CALIBRATION_TIMEOUT;
+volatile uint16_t mode_time_count = MODE_TASK_TIMEOUT;
+volatile uint16_t command_time_count = COMMAND_TIMEOUT;
+volatile uint16_t log_time_count = LOG_TIMEOUT;
+volatile uint16_t settings_time_count = SETTINGS_TIMEOUT;
 
 //flags (used for inter task communication)
 volatile uint16_t flags = 0;
 
+//user interface state machine (tables after the function prototypes)
+fsm_t ui_fsm;
+
 //push buttons
 //declare initial state of all three buttons
 uint8_t button_0_push_state = NO_PUSH;
 uint8_t button_1_push_state = NO_PUSH;
 uint8_t button_2_push_state = NO_PUSH;
+//number of button_task periods the buttons have been held for (long press detection)
+uint8_t button_0_hold_count = 0;
+uint8_t button_1_hold_count = 0;
+uint8_t button_2_hold_count = 0;
 
 
 //_____Function prototypes_____
@@ -167,10 +928,204 @@ void button_task(void);
 void button_event_handler_task(void);
 //task used to perform frequency, voltage or resistance measuement
 void measurement_task(void);
+//task used to collect decimated adc blocks
+void acquisition_task(void);
 //task used to perform autoranging
 void autoranging_task(void);
+void frequency_autorange(void);
+void frequency_select_prescaler(uint8_t index);
+void frequency_restart(void);
+uint32_t frequency_read(uint32_t* ticks);
 //task used to handle lcd
 void lcd_task(void);
+void lcd_print_voltage(uint32_t uv, uint8_t address);
+void lcd_print_vref(uint8_t address);
+//task used to measure AVCC against the bandgap
+void calibration_task(void);
+//task used to run the periodic task of the current mode
+void mode_task(void);
+//task used to handle remote commands
+void command_task(void);
+void command_respond(uint8_t command, uint8_t sequence, uint8_t status, const uint8_t* data, uint8_t length);
+//task used to write the measurement log to EEPROM
+void log_task(void);
+//task used to save changed settings
+void settings_task(void);
+
+//user interface actions
+void mode_next(void);
+void autoranging_toggle(void);
+void range_next(void);
+void stats_restart(void);
+void stats_next_view(void);
+void menu_enter(void);
+void menu_exit(void);
+void display_rate_next(void);
+void log_toggle(void);
+
+//mode and range selection
+void select_app_state(uint8_t state);
+void power_select(uint8_t power);
+bool select_range(uint8_t range);
+uint8_t mode_range(void);
+
+//measurement mode hooks (see measurement_mode_t)
+void mode_nothing(void);
+void resistance_enter(void);
+void frequency_measure(void);
+void frequency_sample(void);
+void dual_sample(void);
+void ac_rms_sample(void);
+bool adc_reading(uint16_t* code);
+void voltage_sample(void);
+void resistance_sample(void);
+void adc_acquire(void);
+void frequency_autorange_optional(void);
+bool frequency_set_range(uint8_t range);
+uint8_t frequency_get_range(void);
+void frequency_next_range(void);
+bool vref_set_range(uint8_t range);
+uint8_t vref_get_range(void);
+void vref_next_range(void);
+bool resistance_set_range(uint8_t range);
+uint8_t resistance_get_range(void);
+void resistance_next_range(void);
+bool capacitance_set_range(uint8_t range);
+uint8_t capacitance_get_range(void);
+void capacitance_next_range(void);
+bool scope_set_range(uint8_t range);
+uint8_t scope_get_range(void);
+void scope_next_range(void);
+bool no_range_set(uint8_t range);
+uint8_t no_range_get(void);
+void frequency_layout(void);
+void voltage_layout(void);
+void resistance_layout(void);
+void capacitance_layout(void);
+void dual_layout(void);
+void ac_rms_layout(void);
+void scope_layout(void);
+void logic_layout(void);
+void tone_layout(void);
+void frequency_format(void);
+void voltage_format(void);
+void resistance_format(void);
+void capacitance_format(void);
+void ac_rms_format(void);
+void scope_format(void);
+void logic_format(void);
+void tone_format(void);
+void frequency_format_range(void);
+void vref_format_range(void);
+void resistance_format_range(void);
+void capacitance_format_range(void);
+void dual_format_range(void);
+void scope_format_range(void);
+void tone_format_range(void);
+void capacitance_task(void);
+void tone_task(void);
+void mode_block_nothing(uint16_t block);
+void voltage_block(uint16_t block);
+void dual_block(uint16_t block);
+void resistance_block(uint16_t block);
+void measurement_trigger(void);
+void capacitance_trigger(void);
+
+//scheduler
+void scheduler_tick(void);
+void scheduler_compensate(uint16_t lost_us);
+
+//resistance measurement
+uint8_t resistance_from_code(uint16_t code, uint32_t* ohm);
+void select_ref_resistor(uint8_t index);
+uint8_t resistance_autorange(uint16_t code);
+
+//capacitance measurement
+void capacitance_enter(void);
+void capacitance_exit(void);
+void capacitance_select_range(uint8_t range);
+
+//true rms measurement
+void ac_rms_enter(void);
+void ac_rms_exit(void);
+void ac_rms_reset(void);
+void ac_rms_update(void);
+
+//oscilloscope
+void scope_enter(void);
+void scope_exit(void);
+void scope_arm(void);
+void scope_select_timebase(uint8_t timebase);
+uint16_t scope_sample_rate(void);
+void scope_update(void);
+void scope_render(uint16_t start);
+void scope_dump(uint16_t start);
+
+//logic analyzer
+void logic_enter(void);
+void logic_exit(void);
+void logic_arm(void);
+void logic_update(void);
+void logic_dump(void);
+
+//tone detection
+void tone_enter(void);
+void tone_exit(void);
+void tone_reset(void);
+void tone_start_block(void);
+uint8_t tone_sweep_done(void);
+
+//statistics
+bool stats_available(void);
+void stats_select_view(uint8_t view);
+uint32_t stats_live_reading(void);
+uint32_t stats_reading(uint32_t live);
+void lcd_print_stats_view(void);
+
+//filtering
+void measurement_filter_reset(void);
+bool measurement_filter_changed(measurement_channel_t* channel, uint8_t quantity, int32_t value);
+uint8_t measurement_quantity(void);
+
+//autoranging
+uint8_t autorange_select(const autorange_threshold_t* table, uint8_t num_ranges, uint8_t index, uint32_t value);
+
+//adc acquisition
+bool adc_configure(uint8_t oversample_bits, uint16_t output_rate);
+void adc_start(void);
+void adc_stop(void);
+bool adc_read_block(uint16_t* code);
+void adc_collect_blocks(void);
+uint16_t adc_full_scale(void);
+uint32_t adc_code_to_uv(uint16_t code);
+void adc_select_vref(uint8_t range);
+uint16_t adc_measure_polled(uint8_t admux, uint8_t samples);
+uint8_t adc_range(void);
+bool adc_precision_selected(void);
+void adc_precision_burst(void);
+
+//calibration
+void calibration_load(void);
+void calibration_save(void);
+void calibration_update(void);
+bool calibration_measure_avcc(void);
+void calibration_user_bandgap(void);
+
+//settings
+bool settings_load(void);
+void settings_apply(void);
+void settings_capture(settings_t* current);
+uint16_t settings_crc(const settings_t* current);
+
+//measurement logger
+void log_init(void);
+void log_start(uint8_t interval);
+bool log_read_header(uint8_t page, log_header_t* header);
+void log_write(uint16_t address, const uint8_t* data, uint8_t length);
+void log_dump(void);
+
+//telemetry
+void telemetry_send(uint8_t quantity, uint8_t range, uint32_t raw, int32_t value);
 
 //inter task communication
 void set_flag(uint8_t val);
@@ -179,5 +1134,146 @@ bool is_flag_set(uint8_t val);
 void toggle_flag(uint8_t val);
 
 
+//_____State machines_____
+//user interface transitions [state][event] (events left out are ignored, see fsm.h)
+const fsm_transition_t ui_transitions[NUM_UI_STATES][NUM_UI_EVENTS] PROGMEM =
+{
+    [UI_MEASURE] =
+    {
+        //change to the next app_state
+        [BUTTON_0_EVENT] = FSM_TRANSITION(UI_MEASURE, mode_next),
+        //toggle autoranging
+        [BUTTON_1_EVENT] = FSM_TRANSITION(UI_MEASURE, autoranging_toggle),
+        //change the measurement range (manual ranging)
+        [BUTTON_2_EVENT] = FSM_TRANSITION(UI_MEASURE, range_next),
+        //open the menu (it replaces the screen of the current mode, measurements continue)
+        [BUTTON_0_LONG_EVENT] = FSM_TRANSITION(UI_MENU, NULL),
+        //start new statistics
+        [BUTTON_1_LONG_EVENT] = FSM_TRANSITION(UI_MEASURE, stats_restart),
+        //cycle through the statistics views
+        [BUTTON_2_LONG_EVENT] = FSM_TRANSITION(UI_MEASURE, stats_next_view),
+    },
+    [UI_MENU] =
+    {
+        [BUTTON_0_EVENT] = FSM_TRANSITION(UI_MEASURE, NULL),
+        [BUTTON_1_EVENT] = FSM_TRANSITION(UI_MENU, log_toggle),
+        [BUTTON_2_EVENT] = FSM_TRANSITION(UI_MENU, display_rate_next),
+    },
+};
+
+//user interface entry and exit actions [state]
+const fsm_state_t ui_states[NUM_UI_STATES] PROGMEM =
+{
+    [UI_MENU] = {menu_enter, menu_exit},
+};
+
+
+
+//_____Measurement modes_____
+//descriptors of the app states [app_state]
+const measurement_mode_t modes[NUM_APP_STATES] PROGMEM =
+{
+    //the adc is shut down (power_select() stops acquisition), timer1 measures the period
+    [FREQUENCY] =
+    {
+        .enter = mode_nothing, .exit = mode_nothing, .power = POWER_TIMER1,
+        .sample = frequency_sample, .acquire = mode_nothing, .autorange = frequency_autorange_optional,
+        .set_range = frequency_set_range, .get_range = frequency_get_range, .next_range = frequency_next_range,
+        .layout = frequency_layout, .format = frequency_format, .format_range = frequency_format_range,
+        .task = mode_nothing, .quantity = FREQUENCY, .reading = &filtered_frequency, .block = mode_block_nothing,
+        .trigger = measurement_trigger, .flags = 0,
+    },
+    //free running acquisition triggered by timer0, autoranged on every reading
+    [VOLTAGE] =
+    {
+        .enter = adc_start, .exit = mode_nothing, .power = POWER_ADC | POWER_TIMER0,
+        .sample = voltage_sample, .acquire = adc_acquire, .autorange = mode_nothing,
+        .set_range = vref_set_range, .get_range = vref_get_range, .next_range = vref_next_range,
+        .layout = voltage_layout, .format = voltage_format, .format_range = vref_format_range,
+        .task = mode_nothing, .quantity = VOLTAGE, .reading = &voltage, .block = voltage_block,
+        .trigger = measurement_trigger, .flags = MODE_PRECISION,
+    },
+    [RESISTANCE] =
+    {
+        .enter = resistance_enter, .exit = mode_nothing, .power = POWER_ADC | POWER_TIMER0,
+        .sample = resistance_sample, .acquire = adc_acquire, .autorange = mode_nothing,
+        .set_range = resistance_set_range, .get_range = resistance_get_range, .next_range = resistance_next_range,
+        .layout = resistance_layout, .format = resistance_format, .format_range = resistance_format_range,
+        .task = mode_nothing, .quantity = RESISTANCE, .reading = &resistance, .block = resistance_block,
+        .trigger = measurement_trigger, .flags = MODE_PRECISION,
+    },
+    //the comparator uses the adc multiplexer (the adc is powered but disabled), timer1 times the charge
+    //(capacitance_task takes the readings, the adc must not be polled)
+    [CAPACITANCE] =
+    {
+        .enter = capacitance_enter, .exit = capacitance_exit, .power = POWER_ADC | POWER_TIMER1,
+        .sample = mode_nothing, .acquire = mode_nothing, .autorange = mode_nothing,
+        .set_range = capacitance_set_range, .get_range = capacitance_get_range, .next_range = capacitance_next_range,
+        .layout = capacitance_layout, .format = capacitance_format, .format_range = capacitance_format_range,
+        .task = capacitance_task, .quantity = CAPACITANCE, .reading = &capacitance, .block = mode_block_nothing,
+        .trigger = capacitance_trigger, .flags = MODE_ADC_BUSY,
+    },
+    [DUAL] =
+    {
+        .enter = adc_start, .exit = mode_nothing, .power = POWER_ADC | POWER_TIMER0 | POWER_TIMER1,
+        .sample = dual_sample, .acquire = adc_acquire, .autorange = frequency_autorange,
+        .set_range = vref_set_range, .get_range = vref_get_range, .next_range = vref_next_range,
+        .layout = dual_layout, .format = voltage_format, .format_range = dual_format_range,
+        .task = mode_nothing, .quantity = VOLTAGE, .reading = NULL, .block = dual_block,
+        .trigger = measurement_trigger, .flags = 0,
+    },
+    //every conversion is used by the adc ISR, the frequency is measured for the synchronized window
+    [AC_RMS] =
+    {
+        .enter = ac_rms_enter, .exit = ac_rms_exit, .power = POWER_ADC | POWER_TIMER0 | POWER_TIMER1,
+        .sample = ac_rms_sample, .acquire = mode_nothing, .autorange = frequency_autorange,
+        .set_range = vref_set_range, .get_range = vref_get_range, .next_range = vref_next_range,
+        .layout = ac_rms_layout, .format = ac_rms_format, .format_range = vref_format_range,
+        .task = mode_nothing, .quantity = VOLTAGE, .reading = NULL, .block = mode_block_nothing,
+        .trigger = measurement_trigger, .flags = 0,
+    },
+    //the adc runs in true free running mode (ADTS2:0 = 000), timer0 is shut down
+    [SCOPE] =
+    {
+        .enter = scope_enter, .exit = scope_exit, .power = POWER_ADC,
+        .sample = scope_update, .acquire = mode_nothing, .autorange = mode_nothing,
+        .set_range = scope_set_range, .get_range = scope_get_range, .next_range = scope_next_range,
+        .layout = scope_layout, .format = scope_format, .format_range = scope_format_range,
+        .task = mode_nothing, .quantity = VOLTAGE, .reading = NULL, .block = mode_block_nothing,
+        .trigger = scope_arm, .flags = MODE_ADC_BUSY | MODE_RAW_FRAMES | MODE_AUTO_TRIGGER,
+    },
+    //the adc is shut down, button 2 starts a new capture
+    [LOGIC] =
+    {
+        .enter = logic_enter, .exit = logic_exit, .power = POWER_TIMER1,
+        .sample = logic_update, .acquire = mode_nothing, .autorange = mode_nothing,
+        .set_range = no_range_set, .get_range = no_range_get, .next_range = logic_arm,
+        .layout = logic_layout, .format = logic_format, .format_range = mode_nothing,
+        .task = mode_nothing, .quantity = FREQUENCY, .reading = NULL, .block = mode_block_nothing,
+        .trigger = logic_arm, .flags = MODE_RAW_FRAMES,
+    },
+    //tone_task takes the readings
+    [TONE] =
+    {
+        .enter = tone_enter, .exit = tone_exit, .power = POWER_ADC | POWER_TIMER0,
+        .sample = mode_nothing, .acquire = mode_nothing, .autorange = mode_nothing,
+        .set_range = vref_set_range, .get_range = vref_get_range, .next_range = vref_next_range,
+        .layout = tone_layout, .format = tone_format, .format_range = tone_format_range,
+        .task = tone_task, .quantity = VOLTAGE, .reading = NULL, .block = mode_block_nothing,
+        .trigger = measurement_trigger, .flags = 0,
+    },
+};
+
+//function pointers are 16 bits on the avr (older avr-libc versions have no pgm_read_ptr)
+#ifndef pgm_read_ptr
+#define pgm_read_ptr(address) ((void*) pgm_read_word(address))
+#endif
+
+//hook of the current mode, read from flash (call it like a function, e.g. MODE_HOOK(sample)())
+#define MODE_HOOK(hook) ((__typeof__(modes[0].hook)) pgm_read_ptr(&modes[app_state].hook))
+//byte field of the current mode (e.g. MODE_BYTE(flags))
+#define MODE_BYTE(field) pgm_read_byte(&modes[app_state].field)
+
+
 #endif // MAIN_H_INCLUDED
 
@@ -0,0 +1,15 @@
+#ifndef COBS_H_INCLUDED
+#define COBS_H_INCLUDED
+
+#include <stdint.h>
+
+//consistent overhead byte stuffing
+//the encoded block contains no zero bytes, so a zero byte can be used to delimit frames on a byte stream
+//size of the encoded block (at most one extra byte for every 254 bytes of data, plus one)
+//blocks are limited to 253 bytes, so that the encoded length fits in 8 bits
+#define COBS_ENCODED_LENGTH(length) ((length) + ((length)/254) + 1)
+
+uint8_t cobs_encode(const uint8_t* data, uint8_t length, uint8_t* output);
+int16_t cobs_decode(const uint8_t* data, uint8_t length, uint8_t* output);
+
+#endif // COBS_H_INCLUDED
@@ -0,0 +1,31 @@
+#ifndef EEPROM_CACHE_H_INCLUDED
+#define EEPROM_CACHE_H_INCLUDED
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//write-behind cache of EEPROM_CACHE_SIZE bytes of the EEPROM, starting at the address given to eeprom_cache_init()
+//the bytes are copied to sram by eeprom_cache_init(), reads come from the copy
+//writes change the copy and mark the changed bytes dirty, the EEPROM ready ISR programs one dirty byte per interrupt
+//(3.4ms per byte, no function ever waits for the EEPROM)
+//the addresses are those of EEMEM variables, bytes outside the cached region read as erased (0xFF) and are not written
+//(variables that have to be cached together are best kept in one EEMEM struct)
+//other EEPROM data (outside the cached region) is accessed directly with the avr-libc functions between
+//eeprom_cache_pause() and eeprom_cache_resume(), the ISR would otherwise start a write between the address and
+//the strobe of a direct access (pause waits for a write in progress, at most 3.4ms, the dirty bytes stay queued)
+#ifndef EEPROM_CACHE_SIZE
+#define EEPROM_CACHE_SIZE 32
+#endif
+
+void eeprom_cache_init(const void* address);
+uint8_t eeprom_cache_read_byte(const uint8_t* address);
+uint16_t eeprom_cache_read_word(const uint16_t* address);
+void eeprom_cache_read_block(void* data, const void* address, uint8_t length);
+void eeprom_cache_write_byte(uint8_t* address, uint8_t value);
+void eeprom_cache_write_word(uint16_t* address, uint16_t value);
+void eeprom_cache_write_block(const void* data, void* address, uint8_t length);
+bool eeprom_cache_busy(void);
+void eeprom_cache_pause(void);
+void eeprom_cache_resume(void);
+
+#endif // EEPROM_CACHE_H_INCLUDED
@@ -0,0 +1,41 @@
+#ifndef FILTER_H_INCLUDED
+#define FILTER_H_INCLUDED
+
+#include <stdint.h>
+
+//filter types
+//no filtering (output = input)
+#define FILTER_NONE 0
+//moving average over the last FILTER_AVERAGE_LENGTH values
+#define FILTER_MOVING_AVERAGE 1
+//first order iir (exponential smoothing), y += (x - y)/2^shift
+#define FILTER_IIR 2
+//median of the last FILTER_MEDIAN_LENGTH values
+#define FILTER_MEDIAN 3
+
+//length of the moving average (must be a power of 2)
+#define FILTER_AVERAGE_LENGTH 8
+//length of the median filter
+#define FILTER_MEDIAN_LENGTH 5
+
+//filter state
+//all values are integers, the iir state is kept in Q8 fixed point
+//input values must lie in +-2^23 for the iir filter (the state has to fit in 32 bits)
+typedef struct
+{
+    uint8_t type;
+    uint8_t iir_shift;
+    //number of values in the history (saturates at FILTER_AVERAGE_LENGTH)
+    uint8_t count;
+    //position of the next value in the history
+    uint8_t index;
+    int32_t history[FILTER_AVERAGE_LENGTH];
+    //sum of the history (moving average) or Q8 state (iir)
+    int32_t state;
+} filter_t;
+
+void filter_init(filter_t* filter, uint8_t type, uint8_t iir_shift);
+void filter_reset(filter_t* filter);
+int32_t filter_update(filter_t* filter, int32_t value);
+
+#endif // FILTER_H_INCLUDED
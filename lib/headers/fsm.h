@@ -0,0 +1,59 @@
+#ifndef FSM_H_INCLUDED
+#define FSM_H_INCLUDED
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//table driven finite state machine with an event queue
+//the transitions are a PROGMEM table [state][event], dispatching an event is one table lookup
+//every entry gives the next state and an action, entries left out (zero) ignore the event in that state,
+//so an event that is not expected (e.g. a bounced switch) never has to be cleared by hand
+//every state can have an entry and an exit action (PROGMEM table [state], NULL for none),
+//they run when the state changes, in the order exit, transition action, entry
+//events are posted by ISRs and tasks to a ring buffer and dispatched in order by fsm_run(),
+//an event posted twice is handled twice (events are only lost if the queue is full, see fsm_t.lost)
+
+//size of the event queue (must be a power of 2, at most 256)
+#ifndef FSM_QUEUE_SIZE
+#define FSM_QUEUE_SIZE 8
+#endif
+
+//table entry of a transition to next_state (the state is stored + 1, an entry of 0 is no transition)
+//a transition to the current state only runs the action (no exit and entry)
+#define FSM_TRANSITION(next_state, action) {(next_state) + 1, (action)}
+
+typedef void (*fsm_action_t)(void);
+
+typedef struct
+{
+    uint8_t next_state;
+    fsm_action_t action;
+} fsm_transition_t;
+
+typedef struct
+{
+    fsm_action_t entry;
+    fsm_action_t exit;
+} fsm_state_t;
+
+typedef struct
+{
+    //PROGMEM tables
+    const fsm_transition_t* transitions;
+    const fsm_state_t* states;
+    uint8_t num_events;
+    //current state (read by ISRs, only changed by fsm_run())
+    volatile uint8_t state;
+    //event queue, one entry is kept free to tell a full queue from an empty one
+    volatile uint8_t queue[FSM_QUEUE_SIZE];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+    //number of events dropped because the queue was full
+    volatile uint8_t lost;
+} fsm_t;
+
+void fsm_init(fsm_t* fsm, const fsm_transition_t* transitions, const fsm_state_t* states, uint8_t num_events, uint8_t state);
+bool fsm_post(fsm_t* fsm, uint8_t event);
+void fsm_run(fsm_t* fsm);
+
+#endif // FSM_H_INCLUDED
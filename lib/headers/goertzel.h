@@ -0,0 +1,33 @@
+#ifndef GOERTZEL_H_INCLUDED
+#define GOERTZEL_H_INCLUDED
+
+#include <stdint.h>
+#include <math.h>
+
+//goertzel filter for one dft bin of a block of samples
+//the coefficient is kept in Q14, the state in 32 bit integers
+//samples must lie in +-2^9 (centred 10 bit adc codes) and the block size should not exceed 256 samples,
+//so that the state stays below 2^21 for every bin (even with a dc offset at the lowest bins)
+
+//coefficient 2*cos(2*pi*bin/block_size) in Q14 of a bin (0 < bin < block_size/2),
+//the frequency of the bin is bin * sample_rate / block_size
+//only for constant arguments (e.g. the initializers of a PROGMEM table), gcc folds the cosine at compile time,
+//so no floating point code is linked (2.0 of bin 0 is not representable in Q14)
+#define GOERTZEL_COEFF(bin, block_size) ((int16_t) (GOERTZEL_COEFF_Q14(bin, block_size) + \
+    ((GOERTZEL_COEFF_Q14(bin, block_size) < 0) ? -0.5 : 0.5)))
+#define GOERTZEL_COEFF_Q14(bin, block_size) (2.0 * cos((2.0 * M_PI * (bin)) / (block_size)) * 16384.0)
+
+typedef struct
+{
+    //2*cos(2*pi*bin/block_size) in Q14
+    int16_t coeff;
+    int32_t s1;
+    int32_t s2;
+} goertzel_t;
+
+void goertzel_init(goertzel_t* goertzel, int16_t coeff);
+void goertzel_reset(goertzel_t* goertzel);
+void goertzel_update(goertzel_t* goertzel, int16_t sample);
+uint32_t goertzel_magnitude(const goertzel_t* goertzel);
+
+#endif // GOERTZEL_H_INCLUDED
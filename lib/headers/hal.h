@@ -0,0 +1,83 @@
+#ifndef HAL_H_INCLUDED
+#define HAL_H_INCLUDED
+
+#include <stdint.h>
+
+//hardware abstraction for the host build
+//on the avr the functions are the plain register accesses (inlined with a constant address, a single bit of
+//a low io register becomes sbi/cbi) and HAL_IDLE() is empty, so the firmware does not change
+//the host build (lib/host, compiled with gcc for linux) keeps the registers in memory and runs models of the
+//peripherals on a virtual clock, the functions tell the models about the writes they have to see as they happen:
+//pins driving an external device (the lcd), data registers (UDR) and interrupt flags, which are cleared by writing a one
+//HAL_IDLE() is called by the scheduler loops and in busy waits, it advances the virtual clock of the host build
+//(the avr-libc headers are replaced by lib/host, sei(), the delays and sleep_cpu() advance the clock too)
+
+#ifdef __AVR__
+#define HAL_IDLE()
+#else
+#include "host.h"
+#define HAL_IDLE() host_idle()
+#endif
+
+//write a port, its data direction register or a data register (UDR)
+static inline void hal_write(volatile uint8_t* reg, uint8_t value)
+{
+    *reg = value;
+
+#ifndef __AVR__
+    host_io_write(reg);
+#endif
+
+    return;
+}
+
+//set bits of a port
+static inline void hal_set_bits(volatile uint8_t* reg, uint8_t mask)
+{
+    *reg |= mask;
+
+#ifndef __AVR__
+    host_io_write(reg);
+#endif
+
+    return;
+}
+
+//clear bits of a port
+static inline void hal_clear_bits(volatile uint8_t* reg, uint8_t mask)
+{
+    *reg &= ~mask;
+
+#ifndef __AVR__
+    host_io_write(reg);
+#endif
+
+    return;
+}
+
+//clear interrupt flags of a flag register (TIFR, PCIFR ...), the flags written as zero are not changed
+static inline void hal_clear_flags(volatile uint8_t* reg, uint8_t flags)
+{
+#ifdef __AVR__
+    *reg = flags;
+#else
+    *reg &= ~flags;
+#endif
+
+    return;
+}
+
+//write a control register that also holds interrupt flags (flags are the bits of mask, e.g. ADIF in ADCSRA)
+//the flags set in value are cleared, the other flags are not changed
+static inline void hal_write_flags(volatile uint8_t* reg, uint8_t value, uint8_t mask)
+{
+#ifdef __AVR__
+    *reg = value;
+#else
+    *reg = (*reg & mask & ~value) | (value & ~mask);
+#endif
+
+    return;
+}
+
+#endif // HAL_H_INCLUDED
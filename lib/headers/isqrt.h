@@ -0,0 +1,9 @@
+#ifndef ISQRT_H_INCLUDED
+#define ISQRT_H_INCLUDED
+
+#include <stdint.h>
+
+//integer square root (rounded down)
+uint32_t isqrt64(uint64_t value);
+
+#endif // ISQRT_H_INCLUDED
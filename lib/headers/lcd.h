@@ -14,6 +14,7 @@ void lcd_print_string(const char* ptr, uint8_t num_chars, char loc);
 void lcd_print_string_progmem(const prog_uchar* ptr, uint8_t num_chars, char loc);
 void lcd_print_num(uint16_t val, uint8_t num_digits, char loc);
 void lcd_clear_segment(uint8_t num_segments, char loc);
+void lcd_create_char(uint8_t code, const uint8_t* pattern);
 
 #endif // LCD_H_INCLUDED
 
@@ -0,0 +1,26 @@
+#ifndef STATS_H_INCLUDED
+#define STATS_H_INCLUDED
+
+#include <stdint.h>
+
+//running statistics of a stream of values (welford's method)
+//the mean is kept exactly as an integer part and a remainder (sum = mean * count + remainder),
+//so only 32 bit additions and one division are needed per value
+//the sum of squared deviations needs a 32x32 bit product and is kept in 64 bits
+//values and the differences between them must lie in +-2^30
+typedef struct
+{
+    uint32_t count;
+    int32_t min;
+    int32_t max;
+    int32_t mean;
+    int32_t remainder;
+    uint64_t m2;
+} stats_t;
+
+void stats_reset(stats_t* stats);
+void stats_update(stats_t* stats, int32_t value);
+int32_t stats_mean(const stats_t* stats);
+uint32_t stats_deviation(const stats_t* stats);
+
+#endif // STATS_H_INCLUDED
@@ -0,0 +1,44 @@
+#ifndef UART_H_INCLUDED
+#define UART_H_INCLUDED
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//value of the baud rate register in double speed mode (U2X)
+//e.g. 3 for 250kbaud at 8MHz (exact, no baud rate error)
+#define UART_UBRR(baud) ((F_CPU/(8UL*(baud))) - 1)
+
+//size of the transmit ring buffer (must be a power of 2, at most 256)
+#ifndef UART_TX_BUFFER_SIZE
+#define UART_TX_BUFFER_SIZE 128
+#endif
+
+//size of the receive frame buffer, frames are delimited by zero bytes (e.g. cobs encoded frames)
+//longer frames are dropped
+#ifndef UART_RX_FRAME_SIZE
+#define UART_RX_FRAME_SIZE 32
+#endif
+
+//blocking :- uart_try_write() and uart_tx_idle() never wait, the other functions wait with interrupts enabled
+//(ISRs and the timer ticks go on, the calling task is held up)
+//uart_putc() and uart_write() wait while the ring buffer is full, a block of n bytes that finds f bytes free returns
+//after the last n - f bytes have been queued, (n - f) * 40us at 250kbaud (10 bits per byte)
+//uart_disable() waits until the ring buffer is empty and the last byte has been shifted out,
+//at most UART_TX_BUFFER_SIZE * 40us = 5.1ms at 250kbaud (it returns at once if uart_tx_idle() is true)
+//worst cases of the current callers at 250kbaud with an empty ring buffer (127 bytes free) :-
+//lab2 log dump (771 bytes) 25.8ms, logic analyzer capture (522 bytes) 15.8ms, scope capture (392 bytes) 10.6ms,
+//lab2 command responses (cobs frames of at most 28 bytes) wait only while telemetry frames fill the buffer, 1.1ms,
+//lab1 queues its export lines with uart_try_write() and switches the transmitter off once uart_tx_idle() is true
+
+void uart_init(uint16_t ubrr);
+void uart_disable(void);
+void uart_putc(uint8_t data);
+void uart_write(const uint8_t* data, uint16_t length);
+bool uart_try_write(const uint8_t* data, uint8_t length);
+bool uart_tx_idle(void);
+uint8_t uart_tx_free(void);
+void uart_rx_enable(void);
+uint8_t uart_read_frame(uint8_t* frame);
+bool uart_rx_busy(void);
+
+#endif // UART_H_INCLUDED
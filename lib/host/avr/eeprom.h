@@ -0,0 +1,36 @@
+#ifndef HOST_AVR_EEPROM_H_INCLUDED
+#define HOST_AVR_EEPROM_H_INCLUDED
+
+//EEPROM of the host build (replaces avr/eeprom.h)
+//EEMEM variables are collected in the section host_eeprom, their offset in the section is the EEPROM address
+//(also in EEAR, the EEPROM model of host.c maps the low 16 bits of the address)
+//the EEPROM starts with the initial values of the EEMEM variables, as if the .eep file had been programmed
+
+#include <stdint.h>
+#include <stddef.h>
+#include <avr/io.h>
+
+#define EEMEM __attribute__((section("host_eeprom"), used))
+
+#if defined(EEPE)
+#define eeprom_is_ready() bit_is_clear(EECR, EEPE)
+#else
+#define eeprom_is_ready() bit_is_clear(EECR, EEWE)
+#endif
+
+#define eeprom_busy_wait() do { host_idle(); } while(!eeprom_is_ready())
+
+uint8_t eeprom_read_byte(const uint8_t* address);
+uint16_t eeprom_read_word(const uint16_t* address);
+uint32_t eeprom_read_dword(const uint32_t* address);
+void eeprom_read_block(void* destination, const void* source, size_t length);
+void eeprom_write_byte(uint8_t* address, uint8_t value);
+void eeprom_write_word(uint16_t* address, uint16_t value);
+void eeprom_write_dword(uint32_t* address, uint32_t value);
+void eeprom_write_block(const void* source, void* destination, size_t length);
+void eeprom_update_byte(uint8_t* address, uint8_t value);
+void eeprom_update_word(uint16_t* address, uint16_t value);
+void eeprom_update_dword(uint32_t* address, uint32_t value);
+void eeprom_update_block(const void* source, void* destination, size_t length);
+
+#endif // HOST_AVR_EEPROM_H_INCLUDED
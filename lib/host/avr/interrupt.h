@@ -0,0 +1,22 @@
+#ifndef HOST_AVR_INTERRUPT_H_INCLUDED
+#define HOST_AVR_INTERRUPT_H_INCLUDED
+
+//interrupts of the host build (replaces avr/interrupt.h, see host.h)
+//an ISR is a function named after its vector (the vectors are macros in avr/io.h), host.c calls it
+//with the I bit of SREG cleared when its flag and enable bit are set while the virtual clock runs
+
+#include <avr/io.h>
+
+void host_sei(void);
+
+#define ISR(vector, ...) void vector(void); void vector(void)
+#define EMPTY_INTERRUPT(vector) void vector(void); void vector(void) {}
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+#define ISR_NAKED
+
+#define sei() host_sei()
+#define cli() (SREG &= ~0x80)
+#define reti()
+
+#endif // HOST_AVR_INTERRUPT_H_INCLUDED
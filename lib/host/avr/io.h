@@ -0,0 +1,436 @@
+#ifndef HOST_AVR_IO_H_INCLUDED
+#define HOST_AVR_IO_H_INCLUDED
+
+//registers of the host build (replaces avr/io.h, see host.h)
+//the registers are variables, the models of the peripherals (host.c) read and update them on the virtual clock
+//the device is selected like with avr-gcc -mmcu, by defining __AVR_ATmega8__ or __AVR_ATmega328P__
+
+#include <stdint.h>
+
+//host.c defines the registers, everybody else declares them
+//every register is also a macro of its own name, so the sources can test for it with #ifdef as with avr-libc
+#ifndef HOST_REGISTER
+#define HOST_REGISTER(name) extern volatile uint8_t name;
+#define HOST_REGISTER16(name) extern volatile uint16_t name;
+#endif
+
+#define _BV(bit) (1 << (bit))
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+//busy waits let the virtual clock run
+#define loop_until_bit_is_set(sfr, bit) do { host_idle(); } while(bit_is_clear(sfr, bit))
+#define loop_until_bit_is_clear(sfr, bit) do { host_idle(); } while(bit_is_set(sfr, bit))
+
+void host_idle(void);
+
+//registers and bits of both devices
+HOST_REGISTER(SREG)
+HOST_REGISTER(PORTB) HOST_REGISTER(DDRB) HOST_REGISTER(PINB)
+HOST_REGISTER(PORTC) HOST_REGISTER(DDRC) HOST_REGISTER(PINC)
+HOST_REGISTER(PORTD) HOST_REGISTER(DDRD) HOST_REGISTER(PIND)
+HOST_REGISTER(TCNT0)
+HOST_REGISTER(TCCR1A) HOST_REGISTER(TCCR1B)
+HOST_REGISTER16(TCNT1) HOST_REGISTER16(OCR1A) HOST_REGISTER16(OCR1B) HOST_REGISTER16(ICR1)
+HOST_REGISTER(TCNT2)
+HOST_REGISTER(ACSR)
+HOST_REGISTER(ADMUX) HOST_REGISTER(ADCSRA) HOST_REGISTER(ADCL) HOST_REGISTER(ADCH)
+HOST_REGISTER16(ADC)
+#define SREG SREG
+#define PORTB PORTB
+#define DDRB DDRB
+#define PINB PINB
+#define PORTC PORTC
+#define DDRC DDRC
+#define PINC PINC
+#define PORTD PORTD
+#define DDRD DDRD
+#define PIND PIND
+#define TCNT0 TCNT0
+#define TCCR1A TCCR1A
+#define TCCR1B TCCR1B
+#define TCNT1 TCNT1
+#define OCR1A OCR1A
+#define OCR1B OCR1B
+#define ICR1 ICR1
+#define TCNT2 TCNT2
+#define ACSR ACSR
+#define ADMUX ADMUX
+#define ADCSRA ADCSRA
+#define ADCL ADCL
+#define ADCH ADCH
+#define ADC ADC
+#define ADCW ADC
+HOST_REGISTER(EECR) HOST_REGISTER(EEDR)
+HOST_REGISTER16(EEAR)
+HOST_REGISTER(MCUCR)
+#define EECR EECR
+#define EEDR EEDR
+#define EEAR EEAR
+#define MCUCR MCUCR
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+#define CS00 0
+#define CS01 1
+#define CS02 2
+
+#define WGM10 0
+#define WGM11 1
+#define FOC1B 2
+#define FOC1A 3
+#define COM1B0 4
+#define COM1B1 5
+#define COM1A0 6
+#define COM1A1 7
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define WGM13 4
+#define ICES1 6
+#define ICNC1 7
+
+#define CS20 0
+#define CS21 1
+#define CS22 2
+
+#define ACIS0 0
+#define ACIS1 1
+#define ACIC 2
+#define ACIE 3
+#define ACI 4
+#define ACO 5
+#define ACBG 6
+#define ACD 7
+
+#define MUX0 0
+#define MUX1 1
+#define MUX2 2
+#define MUX3 3
+#define ADLAR 5
+#define REFS0 6
+#define REFS1 7
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE 3
+#define ADIF 4
+#define ADSC 6
+#define ADEN 7
+
+#define EERE 0
+#define EERIE 3
+
+#if defined(__AVR_ATmega8__)
+
+#define E2END 0x1FF
+#define RAMEND 0x45F
+
+HOST_REGISTER(TCCR0)
+HOST_REGISTER(TCCR2) HOST_REGISTER(OCR2)
+HOST_REGISTER(TIMSK) HOST_REGISTER(TIFR)
+HOST_REGISTER(GICR) HOST_REGISTER(GIFR) HOST_REGISTER(SFIOR)
+HOST_REGISTER(UCSRA) HOST_REGISTER(UCSRB) HOST_REGISTER(UCSRC) HOST_REGISTER(UDR)
+HOST_REGISTER(UBRRH) HOST_REGISTER(UBRRL)
+#define TCCR0 TCCR0
+#define TCCR2 TCCR2
+#define OCR2 OCR2
+#define TIMSK TIMSK
+#define TIFR TIFR
+#define GICR GICR
+#define GIFR GIFR
+#define SFIOR SFIOR
+#define UCSRA UCSRA
+#define UCSRB UCSRB
+#define UCSRC UCSRC
+#define UDR UDR
+#define UBRRH UBRRH
+#define UBRRL UBRRL
+
+#define TOIE0 0
+#define TOIE1 2
+#define OCIE1B 3
+#define OCIE1A 4
+#define TICIE1 5
+#define TOIE2 6
+#define OCIE2 7
+#define TOV0 0
+#define TOV1 2
+#define OCF1B 3
+#define OCF1A 4
+#define ICF1 5
+#define TOV2 6
+#define OCF2 7
+
+#define WGM21 3
+#define COM20 4
+#define COM21 5
+#define WGM20 6
+#define FOC2 7
+
+#define ADFR 5
+#define ACME 3
+
+#define EEWE 1
+#define EEMWE 2
+
+#define MPCM 0
+#define U2X 1
+#define PE 2
+#define DOR 3
+#define FE 4
+#define UDRE 5
+#define TXC 6
+#define RXC 7
+#define TXB8 0
+#define RXB8 1
+#define UCSZ2 2
+#define TXEN 3
+#define RXEN 4
+#define UDRIE 5
+#define TXCIE 6
+#define RXCIE 7
+#define UCPOL 0
+#define UCSZ0 1
+#define UCSZ1 2
+#define USBS 3
+#define UPM0 4
+#define UPM1 5
+#define UMSEL 6
+#define URSEL 7
+
+#define ISC00 0
+#define ISC01 1
+#define ISC10 2
+#define ISC11 3
+#define SM0 4
+#define SM1 5
+#define SM2 6
+#define SE 7
+#define INT0 6
+#define INT1 7
+
+//interrupt vectors (weak functions called by host.c)
+#define TIMER2_COMP_vect host_timer2_comp_vect
+#define TIMER2_OVF_vect host_timer2_ovf_vect
+#define TIMER1_CAPT_vect host_timer1_capt_vect
+#define TIMER1_COMPA_vect host_timer1_compa_vect
+#define TIMER1_COMPB_vect host_timer1_compb_vect
+#define TIMER1_OVF_vect host_timer1_ovf_vect
+#define TIMER0_OVF_vect host_timer0_ovf_vect
+#define USART_RXC_vect host_usart_rx_vect
+#define USART_UDRE_vect host_usart_udre_vect
+#define USART_TXC_vect host_usart_tx_vect
+#define ADC_vect host_adc_vect
+#define EE_RDY_vect host_ee_ready_vect
+#define ANA_COMP_vect host_analog_comp_vect
+
+#elif defined(__AVR_ATmega328P__)
+
+#define E2END 0x3FF
+#define RAMEND 0x8FF
+
+HOST_REGISTER(TCCR0A) HOST_REGISTER(TCCR0B) HOST_REGISTER(OCR0A) HOST_REGISTER(OCR0B)
+HOST_REGISTER(TIMSK0) HOST_REGISTER(TIFR0)
+HOST_REGISTER(TCCR1C) HOST_REGISTER(TIMSK1) HOST_REGISTER(TIFR1)
+HOST_REGISTER(TCCR2A) HOST_REGISTER(TCCR2B) HOST_REGISTER(OCR2A) HOST_REGISTER(OCR2B)
+HOST_REGISTER(TIMSK2) HOST_REGISTER(TIFR2)
+HOST_REGISTER(ADCSRB) HOST_REGISTER(DIDR0) HOST_REGISTER(DIDR1)
+HOST_REGISTER(SMCR) HOST_REGISTER(PRR)
+HOST_REGISTER(PCICR) HOST_REGISTER(PCIFR) HOST_REGISTER(PCMSK0) HOST_REGISTER(PCMSK1) HOST_REGISTER(PCMSK2)
+HOST_REGISTER(EICRA) HOST_REGISTER(EIMSK) HOST_REGISTER(EIFR)
+HOST_REGISTER(UCSR0A) HOST_REGISTER(UCSR0B) HOST_REGISTER(UCSR0C) HOST_REGISTER(UDR0)
+HOST_REGISTER(UBRR0H) HOST_REGISTER(UBRR0L)
+#define TCCR0A TCCR0A
+#define TCCR0B TCCR0B
+#define OCR0A OCR0A
+#define OCR0B OCR0B
+#define TIMSK0 TIMSK0
+#define TIFR0 TIFR0
+#define TCCR1C TCCR1C
+#define TIMSK1 TIMSK1
+#define TIFR1 TIFR1
+#define TCCR2A TCCR2A
+#define TCCR2B TCCR2B
+#define OCR2A OCR2A
+#define OCR2B OCR2B
+#define TIMSK2 TIMSK2
+#define TIFR2 TIFR2
+#define ADCSRB ADCSRB
+#define DIDR0 DIDR0
+#define DIDR1 DIDR1
+#define SMCR SMCR
+#define PRR PRR
+#define PCICR PCICR
+#define PCIFR PCIFR
+#define PCMSK0 PCMSK0
+#define PCMSK1 PCMSK1
+#define PCMSK2 PCMSK2
+#define EICRA EICRA
+#define EIMSK EIMSK
+#define EIFR EIFR
+#define UCSR0A UCSR0A
+#define UCSR0B UCSR0B
+#define UCSR0C UCSR0C
+#define UDR0 UDR0
+#define UBRR0H UBRR0H
+#define UBRR0L UBRR0L
+
+#define WGM00 0
+#define WGM01 1
+#define COM0B0 4
+#define COM0B1 5
+#define COM0A0 6
+#define COM0A1 7
+#define WGM02 3
+#define FOC0B 6
+#define FOC0A 7
+#define TOIE0 0
+#define OCIE0A 1
+#define OCIE0B 2
+#define TOV0 0
+#define OCF0A 1
+#define OCF0B 2
+
+#define TOIE1 0
+#define OCIE1A 1
+#define OCIE1B 2
+#define ICIE1 5
+#define TOV1 0
+#define OCF1A 1
+#define OCF1B 2
+#define ICF1 5
+
+#define WGM20 0
+#define WGM21 1
+#define COM2B0 4
+#define COM2B1 5
+#define COM2A0 6
+#define COM2A1 7
+#define WGM22 3
+#define FOC2B 6
+#define FOC2A 7
+#define TOIE2 0
+#define OCIE2A 1
+#define OCIE2B 2
+#define TOV2 0
+#define OCF2A 1
+#define OCF2B 2
+
+#define ADATE 5
+#define ADTS0 0
+#define ADTS1 1
+#define ADTS2 2
+#define ACME 6
+#define ADC0D 0
+#define ADC1D 1
+#define ADC2D 2
+#define ADC3D 3
+#define ADC4D 4
+#define ADC5D 5
+#define AIN0D 0
+#define AIN1D 1
+
+#define EEPE 1
+#define EEMPE 2
+#define EEPM0 4
+#define EEPM1 5
+
+#define SE 0
+#define SM0 1
+#define SM1 2
+#define SM2 3
+#define PRADC 0
+#define PRUSART0 1
+#define PRSPI 2
+#define PRTIM1 3
+#define PRTIM0 5
+#define PRTIM2 6
+#define PRTWI 7
+
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCIF0 0
+#define PCIF1 1
+#define PCIF2 2
+#define ISC00 0
+#define ISC01 1
+#define ISC10 2
+#define ISC11 3
+#define INT0 0
+#define INT1 1
+#define INTF0 0
+#define INTF1 1
+
+#define MPCM0 0
+#define U2X0 1
+#define UPE0 2
+#define DOR0 3
+#define FE0 4
+#define UDRE0 5
+#define TXC0 6
+#define RXC0 7
+#define TXB80 0
+#define RXB80 1
+#define UCSZ02 2
+#define TXEN0 3
+#define RXEN0 4
+#define UDRIE0 5
+#define TXCIE0 6
+#define RXCIE0 7
+#define UCPOL0 0
+#define UCSZ00 1
+#define UCSZ01 2
+#define USBS0 3
+#define UPM00 4
+#define UPM01 5
+#define UMSEL00 6
+#define UMSEL01 7
+
+//interrupt vectors (weak functions called by host.c)
+#define PCINT0_vect host_pcint0_vect
+#define PCINT1_vect host_pcint1_vect
+#define PCINT2_vect host_pcint2_vect
+#define TIMER2_COMPA_vect host_timer2_comp_vect
+#define TIMER2_OVF_vect host_timer2_ovf_vect
+#define TIMER1_CAPT_vect host_timer1_capt_vect
+#define TIMER1_COMPA_vect host_timer1_compa_vect
+#define TIMER1_COMPB_vect host_timer1_compb_vect
+#define TIMER1_OVF_vect host_timer1_ovf_vect
+#define TIMER0_COMPA_vect host_timer0_compa_vect
+#define TIMER0_OVF_vect host_timer0_ovf_vect
+#define USART_RX_vect host_usart_rx_vect
+#define USART_UDRE_vect host_usart_udre_vect
+#define USART_TX_vect host_usart_tx_vect
+#define ADC_vect host_adc_vect
+#define EE_READY_vect host_ee_ready_vect
+#define ANALOG_COMP_vect host_analog_comp_vect
+
+#else
+#error "host build: define __AVR_ATmega8__ or __AVR_ATmega328P__"
+#endif
+
+#endif // HOST_AVR_IO_H_INCLUDED
@@ -0,0 +1,32 @@
+#ifndef HOST_AVR_PGMSPACE_H_INCLUDED
+#define HOST_AVR_PGMSPACE_H_INCLUDED
+
+//program memory of the host build (replaces avr/pgmspace.h)
+//there is only one address space on the host, PROGMEM data stays in (read only) memory and is read directly
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+typedef unsigned char prog_uchar;
+typedef char prog_char;
+typedef uint8_t prog_uint8_t;
+typedef uint16_t prog_uint16_t;
+typedef uint32_t prog_uint32_t;
+
+#define pgm_read_byte(address) (*(const uint8_t*) (address))
+#define pgm_read_byte_near(address) pgm_read_byte(address)
+#define pgm_read_word(address) (*(const uint16_t*) (address))
+#define pgm_read_word_near(address) pgm_read_word(address)
+#define pgm_read_dword(address) (*(const uint32_t*) (address))
+#define pgm_read_ptr(address) (*(void* const*) (address))
+
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+
+#endif // HOST_AVR_PGMSPACE_H_INCLUDED
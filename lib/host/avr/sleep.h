@@ -0,0 +1,26 @@
+#ifndef HOST_AVR_SLEEP_H_INCLUDED
+#define HOST_AVR_SLEEP_H_INCLUDED
+
+//sleep modes of the host build (replaces avr/sleep.h)
+//sleep_cpu() runs the virtual clock until an interrupt has been executed (if sleeping is enabled),
+//in adc noise reduction mode the timers are halted and a conversion is started as on the avr
+
+#include <avr/io.h>
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_ADC 1
+#define SLEEP_MODE_PWR_DOWN 2
+#define SLEEP_MODE_PWR_SAVE 3
+#define SLEEP_MODE_STANDBY 6
+
+extern uint8_t host_sleep_mode;
+extern uint8_t host_sleep_enabled;
+void host_sleep(void);
+
+#define set_sleep_mode(mode) (host_sleep_mode = (mode))
+#define sleep_enable() (host_sleep_enabled = 1)
+#define sleep_disable() (host_sleep_enabled = 0)
+#define sleep_cpu() host_sleep()
+#define sleep_mode() do { sleep_enable(); sleep_cpu(); sleep_disable(); } while(0)
+
+#endif // HOST_AVR_SLEEP_H_INCLUDED
@@ -0,0 +1,1458 @@
+/* Host build of the firmware (linux, gcc), models of the peripherals on a virtual clock
+The firmware is compiled unchanged against the headers in lib/host, the registers are variables defined here.
+The models run in steps of 1us whenever the firmware waits (HAL_IDLE() in the scheduler loops, busy waits,
+delays and sleep_cpu()), interrupts are executed at the end of a step if the I bit is set.
+ISRs take no virtual time, timer edges and input capture are resolved to 1us.
+
+build :- gcc -std=gnu99 -o lab1_host -D__AVR_ATmega8__ -DF_CPU=8000000UL -Ilib/host -Ilib/headers lab1/main.c lib/src/[a-z]*.c lib/host/host.c -lm
+build :- gcc -std=gnu99 -o lab2_host -D__AVR_ATmega328P__ -DF_CPU=8000000UL -Ilib/host -Ilib/headers -Ilab2 lab2/main.c lib/src/[a-z]*.c lib/host/host.c -lm
+build :- gcc -std=gnu99 -o lib_test -D__AVR_ATmega328P__ -DF_CPU=8000000UL -Ilib/host -Ilib/headers lib/host/test.c lib/src/[a-z]*.c lib/host/host.c -lm
+(from the top of the repository, the builds are free of warnings with -Wall -Wextra, lib_test runs the tests of
+the library in test.c and exits with status 1 if one fails)
+usage :- lab2_host [-s script] [-t ms] [-u uart_file] [-e eeprom_file]
+-s script of input changes (see below), -t run time in ms (default 10000)
+-u file receiving the bytes sent by the usart, -e file holding the EEPROM (loaded if it exists, saved at the end)
+the lcd is printed whenever its contents have changed and settled for 5ms :- lcd <ms> |<line 1>|<line 2>|
+(custom characters are printed as #, other characters outside ascii as ?)
+
+script :- one command per line, "<ms> <command> <arguments>", lines starting with # are comments
+<ms> pin <input> 0|1|z             digital level, z is undriven (pulled up, as the switches of the boards)
+<ms> analog <input> <mV>           voltage
+<ms> square <input> <Hz> [low high] square wave between low and high mV (default 0 and AVCC)
+<ms> sine <input> <Hz> <amp> <offset> sine wave (mV)
+<ms> uart <hex bytes>              bytes received by the usart, e.g. 01 02 00
+<ms> lcd                           print the lcd now
+<ms> end                           end the run
+inputs are the port pins B0 to D7, ADC0 to ADC7, AIN0 (D6), AIN1 (D7) and AVCC (default 5000mV)
+
+not modelled :- external interrupts, spi, twi, watchdog, compare outputs, analog circuits outside the avr
+(e.g. the rc charging of the capacitance measurement, drive its comparator input from the script)
+*/
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+//define the registers
+#define HOST_REGISTER(name) volatile uint8_t name;
+#define HOST_REGISTER16(name) volatile uint16_t name;
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+
+#include "host.h"
+
+
+//cycles of a step of the virtual clock (1us) and of a ms
+#define HOST_STEP_CYCLES (F_CPU/1000000UL)
+#define HOST_CYCLES_MS (F_CPU/1000UL)
+
+//lcd contents are printed once they have not changed for this time
+#define HOST_LCD_SETTLE_CYCLES (5*HOST_CYCLES_MS)
+//an EEPROM write (erase and write) takes 3.4ms
+#define HOST_EEPROM_WRITE_CYCLES (3400UL*HOST_STEP_CYCLES)
+//at most this many interrupts are executed in a step (an interrupt that stays pending cannot hang the run)
+#define HOST_STEP_INTERRUPTS 8
+#define HOST_SCRIPT_LINE 128
+
+//inputs (0 to 23 are the port pins B0 to D7)
+#define HOST_INPUT_AIN0 22
+#define HOST_INPUT_AIN1 23
+#define HOST_INPUT_ADC6 24
+#define HOST_INPUT_ADC7 25
+#define HOST_INPUT_AVCC 26
+#define HOST_INPUTS 27
+
+#define HOST_UNDRIVEN 0
+#define HOST_LEVEL 1
+#define HOST_SQUARE 2
+#define HOST_SINE 3
+
+//interrupt types
+//FLAG :- the flag is cleared when the interrupt is executed
+//PENDING_SET :- pending while the flag is set (data register empty)
+//PENDING_CLEAR :- pending while the flag is clear (EEPROM ready, the flag is the write enable bit)
+#define HOST_FLAG 0
+#define HOST_PENDING_SET 1
+#define HOST_PENDING_CLEAR 2
+
+//device specific registers and bits
+#if defined(__AVR_ATmega8__)
+#define HOST_TIFR1 TIFR
+#define HOST_UCSRA UCSRA
+#define HOST_UCSRB UCSRB
+#define HOST_UBRRH UBRRH
+#define HOST_UBRRL UBRRL
+#define HOST_UDR UDR
+#define HOST_RXC RXC
+#define HOST_TXC TXC
+#define HOST_UDRE UDRE
+#define HOST_DOR DOR
+#define HOST_U2X U2X
+#define HOST_RXEN RXEN
+#define HOST_TXEN TXEN
+#define HOST_EEPE EEWE
+#define HOST_EEMPE EEMWE
+//the comparator multiplexer is enabled in SFIOR
+#define HOST_ACME (SFIOR & (1<<ACME))
+#define HOST_ADC_FREE_RUNNING (ADCSRA & (1<<ADFR))
+#define HOST_ADC_TIMER0_TRIGGER (false)
+//no power reduction register
+#define HOST_PRR 0
+#define HOST_PR(bit) 0
+#define HOST_BANDGAP_MV 1300
+#define HOST_INTERNAL_REFERENCE_MV 2560
+#elif defined(__AVR_ATmega328P__)
+#define HOST_TIFR1 TIFR1
+#define HOST_UCSRA UCSR0A
+#define HOST_UCSRB UCSR0B
+#define HOST_UBRRH UBRR0H
+#define HOST_UBRRL UBRR0L
+#define HOST_UDR UDR0
+#define HOST_RXC RXC0
+#define HOST_TXC TXC0
+#define HOST_UDRE UDRE0
+#define HOST_DOR DOR0
+#define HOST_U2X U2X0
+#define HOST_RXEN RXEN0
+#define HOST_TXEN TXEN0
+#define HOST_EEPE EEPE
+#define HOST_EEMPE EEMPE
+#define HOST_ACME (ADCSRB & (1<<ACME))
+//auto trigger source 0 is free running, source 3 is the timer0 compare match A
+#define HOST_ADC_FREE_RUNNING ((ADCSRA & (1<<ADATE)) && ((ADCSRB & 0x07) == 0))
+#define HOST_ADC_TIMER0_TRIGGER ((ADCSRA & (1<<ADATE)) && ((ADCSRB & 0x07) == 3))
+#define HOST_PRR PRR
+#define HOST_PR(bit) (1<<(bit))
+#define HOST_BANDGAP_MV 1100
+#define HOST_INTERNAL_REFERENCE_MV 1100
+#endif
+
+
+//8 bit timer
+typedef struct
+{
+    //register with the clock select bits (CSn2:0)
+    volatile uint8_t* clock;
+    //register with the ctc mode bit (NULL if the timer only counts up)
+    volatile uint8_t* mode;
+    uint8_t ctc;
+    volatile uint8_t* count;
+    //compare register (NULL if there is no compare unit)
+    volatile uint8_t* compare;
+    volatile uint8_t* flags;
+    uint8_t compare_flag;
+    uint8_t overflow_flag;
+    //prescaler of every clock select value (0 stops the timer)
+    const uint16_t* prescalers;
+    //bit of the timer in the power reduction register
+    uint8_t power;
+    //cycles since the last timer clock
+    uint16_t cycles;
+} host_timer_t;
+
+//interrupt source
+typedef struct
+{
+    void (*vector)(void);
+    volatile uint8_t* enable;
+    uint8_t enable_mask;
+    volatile uint8_t* flag;
+    uint8_t flag_mask;
+    uint8_t type;
+} host_interrupt_t;
+
+//input driven by the script
+typedef struct
+{
+    uint8_t type;
+    //level (mV), or frequency and the two parameters of a wave
+    double mv;
+    double hz;
+    double a;
+    double b;
+} host_input_t;
+
+//line of the script
+typedef struct
+{
+    uint32_t ms;
+    char command[HOST_SCRIPT_LINE];
+} host_script_t;
+
+
+//interrupt vectors, the ISRs of the firmware replace the weak (NULL) definitions
+void host_pcint0_vect(void) __attribute__((weak));
+void host_pcint1_vect(void) __attribute__((weak));
+void host_pcint2_vect(void) __attribute__((weak));
+void host_timer2_comp_vect(void) __attribute__((weak));
+void host_timer2_ovf_vect(void) __attribute__((weak));
+void host_timer1_capt_vect(void) __attribute__((weak));
+void host_timer1_compa_vect(void) __attribute__((weak));
+void host_timer1_compb_vect(void) __attribute__((weak));
+void host_timer1_ovf_vect(void) __attribute__((weak));
+void host_timer0_compa_vect(void) __attribute__((weak));
+void host_timer0_ovf_vect(void) __attribute__((weak));
+void host_usart_rx_vect(void) __attribute__((weak));
+void host_usart_udre_vect(void) __attribute__((weak));
+void host_usart_tx_vect(void) __attribute__((weak));
+void host_adc_vect(void) __attribute__((weak));
+void host_ee_ready_vect(void) __attribute__((weak));
+void host_analog_comp_vect(void) __attribute__((weak));
+
+//EEMEM variables (the section is only there if the firmware has EEMEM variables)
+extern uint8_t __start_host_eeprom[] __attribute__((weak));
+extern uint8_t __stop_host_eeprom[] __attribute__((weak));
+
+
+//interrupts in the order of their priority
+static const host_interrupt_t host_interrupts[] =
+{
+#if defined(__AVR_ATmega8__)
+    {host_timer2_comp_vect, &TIMSK, (1<<OCIE2), &TIFR, (1<<OCF2), HOST_FLAG},
+    {host_timer2_ovf_vect, &TIMSK, (1<<TOIE2), &TIFR, (1<<TOV2), HOST_FLAG},
+    {host_timer1_capt_vect, &TIMSK, (1<<TICIE1), &TIFR, (1<<ICF1), HOST_FLAG},
+    {host_timer1_compa_vect, &TIMSK, (1<<OCIE1A), &TIFR, (1<<OCF1A), HOST_FLAG},
+    {host_timer1_compb_vect, &TIMSK, (1<<OCIE1B), &TIFR, (1<<OCF1B), HOST_FLAG},
+    {host_timer1_ovf_vect, &TIMSK, (1<<TOIE1), &TIFR, (1<<TOV1), HOST_FLAG},
+    {host_timer0_ovf_vect, &TIMSK, (1<<TOIE0), &TIFR, (1<<TOV0), HOST_FLAG},
+    {host_usart_rx_vect, &UCSRB, (1<<RXCIE), &UCSRA, (1<<RXC), HOST_FLAG},
+    {host_usart_udre_vect, &UCSRB, (1<<UDRIE), &UCSRA, (1<<UDRE), HOST_PENDING_SET},
+    {host_usart_tx_vect, &UCSRB, (1<<TXCIE), &UCSRA, (1<<TXC), HOST_FLAG},
+    {host_adc_vect, &ADCSRA, (1<<ADIE), &ADCSRA, (1<<ADIF), HOST_FLAG},
+    {host_ee_ready_vect, &EECR, (1<<EERIE), &EECR, (1<<EEWE), HOST_PENDING_CLEAR},
+    {host_analog_comp_vect, &ACSR, (1<<ACIE), &ACSR, (1<<ACI), HOST_FLAG},
+#elif defined(__AVR_ATmega328P__)
+    {host_pcint0_vect, &PCICR, (1<<PCIE0), &PCIFR, (1<<PCIF0), HOST_FLAG},
+    {host_pcint1_vect, &PCICR, (1<<PCIE1), &PCIFR, (1<<PCIF1), HOST_FLAG},
+    {host_pcint2_vect, &PCICR, (1<<PCIE2), &PCIFR, (1<<PCIF2), HOST_FLAG},
+    {host_timer2_comp_vect, &TIMSK2, (1<<OCIE2A), &TIFR2, (1<<OCF2A), HOST_FLAG},
+    {host_timer2_ovf_vect, &TIMSK2, (1<<TOIE2), &TIFR2, (1<<TOV2), HOST_FLAG},
+    {host_timer1_capt_vect, &TIMSK1, (1<<ICIE1), &TIFR1, (1<<ICF1), HOST_FLAG},
+    {host_timer1_compa_vect, &TIMSK1, (1<<OCIE1A), &TIFR1, (1<<OCF1A), HOST_FLAG},
+    {host_timer1_compb_vect, &TIMSK1, (1<<OCIE1B), &TIFR1, (1<<OCF1B), HOST_FLAG},
+    {host_timer1_ovf_vect, &TIMSK1, (1<<TOIE1), &TIFR1, (1<<TOV1), HOST_FLAG},
+    {host_timer0_compa_vect, &TIMSK0, (1<<OCIE0A), &TIFR0, (1<<OCF0A), HOST_FLAG},
+    {host_timer0_ovf_vect, &TIMSK0, (1<<TOIE0), &TIFR0, (1<<TOV0), HOST_FLAG},
+    {host_usart_rx_vect, &UCSR0B, (1<<RXCIE0), &UCSR0A, (1<<RXC0), HOST_FLAG},
+    {host_usart_udre_vect, &UCSR0B, (1<<UDRIE0), &UCSR0A, (1<<UDRE0), HOST_PENDING_SET},
+    {host_usart_tx_vect, &UCSR0B, (1<<TXCIE0), &UCSR0A, (1<<TXC0), HOST_FLAG},
+    {host_adc_vect, &ADCSRA, (1<<ADIE), &ADCSRA, (1<<ADIF), HOST_FLAG},
+    {host_ee_ready_vect, &EECR, (1<<EERIE), &EECR, (1<<EEPE), HOST_PENDING_CLEAR},
+    {host_analog_comp_vect, &ACSR, (1<<ACIE), &ACSR, (1<<ACI), HOST_FLAG},
+#endif
+};
+
+static const uint16_t host_prescalers_01[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+static const uint16_t host_prescalers_2[8] = {0, 1, 8, 32, 64, 128, 256, 1024};
+
+#if defined(__AVR_ATmega8__)
+static host_timer_t host_timer0 = {&TCCR0, NULL, 0, &TCNT0, NULL, &TIFR, 0, (1<<TOV0), host_prescalers_01, 0, 0};
+static host_timer_t host_timer2 = {&TCCR2, &TCCR2, (1<<WGM21), &TCNT2, &OCR2, &TIFR, (1<<OCF2), (1<<TOV2), host_prescalers_2, 0, 0};
+#elif defined(__AVR_ATmega328P__)
+static host_timer_t host_timer0 = {&TCCR0B, &TCCR0A, (1<<WGM01), &TCNT0, &OCR0A, &TIFR0, (1<<OCF0A), (1<<TOV0), host_prescalers_01, (1<<PRTIM0), 0};
+static host_timer_t host_timer2 = {&TCCR2B, &TCCR2A, (1<<WGM21), &TCNT2, &OCR2A, &TIFR2, (1<<OCF2A), (1<<TOV2), host_prescalers_2, (1<<PRTIM2), 0};
+#endif
+
+static volatile uint8_t* const host_ports[3] = {&PORTB, &PORTC, &PORTD};
+static volatile uint8_t* const host_ddrs[3] = {&DDRB, &DDRC, &DDRD};
+static volatile uint8_t* const host_pins[3] = {&PINB, &PINC, &PIND};
+#if defined(__AVR_ATmega328P__)
+static volatile uint8_t* const host_pcmsks[3] = {&PCMSK0, &PCMSK1, &PCMSK2};
+#endif
+
+//virtual clock (cycles since reset) and the end of the run
+static uint64_t host_cycles = 0;
+static uint64_t host_end_cycles = 10000ULL*HOST_CYCLES_MS;
+//fraction of a step left over by the delays
+static double host_delay_remainder = 0;
+//number of interrupts executed (a sleep ends with the next interrupt)
+static uint32_t host_interrupt_count = 0;
+//clkIO is halted (SLEEP_MODE_ADC)
+static bool host_clkio_halted = false;
+
+uint8_t host_sleep_mode = SLEEP_MODE_IDLE;
+uint8_t host_sleep_enabled = 0;
+
+static host_input_t host_inputs[HOST_INPUTS];
+
+static host_script_t* host_script = NULL;
+static uint16_t host_script_length = 0;
+static uint16_t host_script_next = 0;
+
+//timer1 input capture, level of the capture source
+static uint8_t host_capture_level = 0;
+static uint16_t host_timer1_cycles = 0;
+
+//adc
+static bool host_adc_converting = false;
+//the first conversion after enabling the adc takes 25 adc clocks
+static bool host_adc_first = true;
+static int32_t host_adc_cycles = 0;
+//input and reference of the conversion (sampled when it starts)
+static double host_adc_input_mv = 0;
+static double host_adc_reference_mv = 0;
+
+//eeprom
+static uint8_t host_eeprom[E2END + 1];
+static uint32_t host_eeprom_busy = 0;
+static const char* host_eeprom_file = NULL;
+
+//usart
+static bool host_uart_buffer_full = false;
+static uint8_t host_uart_buffer = 0;
+static bool host_uart_shifting = false;
+static uint8_t host_uart_shift = 0;
+static uint32_t host_uart_tx_cycles = 0;
+static uint8_t host_uart_rx_fifo[256];
+static uint8_t host_uart_rx_head = 0;
+static uint8_t host_uart_rx_tail = 0;
+static uint32_t host_uart_rx_cycles = 0;
+static FILE* host_uart_file = NULL;
+
+//lcd (wiring of lib/src/lcd.c :- RS PC3, RW PC4, EN PC5, data PORTB)
+static uint8_t host_lcd_ddram[0x80];
+static uint8_t host_lcd_address = 0;
+static bool host_lcd_cgram = false;
+static bool host_lcd_enable = false;
+static bool host_lcd_changed = false;
+static uint64_t host_lcd_changed_cycles = 0;
+static char host_lcd_shown[2][17];
+
+
+//_____Inputs_____
+//current value of an input (NAN if it is not driven)
+static double host_input_value(uint8_t index)
+{
+    const host_input_t* input = &host_inputs[index];
+    //periods since reset (multiplied first, so edges at whole cycles are exact)
+    double periods = (double) host_cycles * input->hz / F_CPU;
+
+    switch(input->type)
+    {
+        case HOST_LEVEL:
+            return (input->mv);
+
+        case HOST_SQUARE:
+            return ((fmod(periods, 1.0) < 0.5) ? input->b : input->a);
+
+        case HOST_SINE:
+            return (input->b + input->a * sin(2.0 * M_PI * periods));
+
+        default:
+            return (NAN);
+    }
+}
+
+static double host_avcc_mv(void)
+{
+    return (host_input_value(HOST_INPUT_AVCC));
+}
+
+//voltage of an input as seen by the avr (mV)
+//output pins drive the level of the port bit, undriven inputs are pulled up (as the switches of the boards)
+static double host_pin_mv(uint8_t index)
+{
+    double mv = host_input_value(index);
+
+    if(index < 24)
+    {
+        uint8_t port = index >> 3;
+        uint8_t mask = 1 << (index & 0x07);
+
+        if(*host_ddrs[port] & mask)
+        {
+            return ((*host_ports[port] & mask) ? host_avcc_mv() : 0);
+        }
+    }
+
+    return (isnan(mv) ? host_avcc_mv() : mv);
+}
+
+//voltage of an adc multiplexer channel (mV)
+static double host_channel_mv(uint8_t channel)
+{
+    if(channel < 6)
+    {
+        return (host_pin_mv(8 + channel));
+    }
+
+    if(channel < 8)
+    {
+        return (host_pin_mv(HOST_INPUT_ADC6 + channel - 6));
+    }
+
+    return ((channel == 14) ? HOST_BANDGAP_MV : 0);
+}
+
+//read the pins and set the pin change flags
+static void host_pins_update(void)
+{
+    double threshold = host_avcc_mv() / 2;
+    uint8_t port;
+    uint8_t bit;
+
+    for(port = 0; port < 3; port++)
+    {
+        uint8_t level = 0;
+
+        for(bit = 0; bit < 8; bit++)
+        {
+            if(host_pin_mv(port*8 + bit) > threshold)
+            {
+                level |= (1<<bit);
+            }
+        }
+
+#if defined(__AVR_ATmega328P__)
+        if((level ^ *host_pins[port]) & *host_pcmsks[port])
+        {
+            PCIFR |= (1<<port);
+        }
+#endif
+
+        *host_pins[port] = level;
+    }
+
+    return;
+}
+
+
+//_____Analog comparator_____
+static void host_comparator_update(void)
+{
+    double positive;
+    double negative;
+    uint8_t output;
+
+    if(ACSR & (1<<ACD))
+    {
+        return;
+    }
+
+    positive = (ACSR & (1<<ACBG)) ? HOST_BANDGAP_MV : host_pin_mv(HOST_INPUT_AIN0);
+
+    //the adc multiplexer selects the negative input while the adc is switched off
+    if(HOST_ACME && !(ADCSRA & (1<<ADEN)))
+    {
+        negative = host_channel_mv(ADMUX & 0x07);
+    }
+
+    else
+    {
+        negative = host_pin_mv(HOST_INPUT_AIN1);
+    }
+
+    output = (positive > negative) ? (1<<ACO) : 0;
+
+    if(output != (ACSR & (1<<ACO)))
+    {
+        //ACIS1:0 :- 00 toggle, 10 falling edge, 11 rising edge
+        uint8_t mode = ACSR & ((1<<ACIS1) | (1<<ACIS0));
+
+        ACSR ^= (1<<ACO);
+
+        if((mode == 0) || ((mode == (1<<ACIS1)) && !output) || ((mode == ((1<<ACIS1) | (1<<ACIS0))) && output))
+        {
+            ACSR |= (1<<ACI);
+        }
+    }
+
+    return;
+}
+
+
+//_____Timers_____
+//run an 8 bit timer, returns true if the compare flag has been set (the adc trigger of timer0)
+static bool host_timer_run(host_timer_t* timer, uint32_t cycles)
+{
+    uint16_t prescaler = timer->prescalers[*timer->clock & 0x07];
+    bool match = false;
+
+    if((prescaler == 0) || (HOST_PRR & timer->power) || host_clkio_halted)
+    {
+        return (false);
+    }
+
+    timer->cycles += cycles;
+
+    while(timer->cycles >= prescaler)
+    {
+        timer->cycles -= prescaler;
+
+        //in ctc mode the counter is cleared on the clock after the match
+        if(timer->mode && (*timer->mode & timer->ctc) && (*timer->count == *timer->compare))
+        {
+            *timer->count = 0;
+        }
+
+        else if(++(*timer->count) == 0)
+        {
+            *timer->flags |= timer->overflow_flag;
+        }
+
+        if(timer->compare && (*timer->count == *timer->compare))
+        {
+            match = match || !(*timer->flags & timer->compare_flag);
+            *timer->flags |= timer->compare_flag;
+        }
+    }
+
+    return (match);
+}
+
+//run timer1 (normal or ctc mode with top OCR1A)
+static void host_timer1_run(uint32_t cycles)
+{
+    uint16_t prescaler = host_prescalers_01[TCCR1B & 0x07];
+
+    if((prescaler == 0) || (HOST_PRR & HOST_PR(PRTIM1)) || host_clkio_halted)
+    {
+        return;
+    }
+
+    host_timer1_cycles += cycles;
+
+    while(host_timer1_cycles >= prescaler)
+    {
+        host_timer1_cycles -= prescaler;
+
+        if((TCCR1B & (1<<WGM12)) && (TCNT1 == OCR1A))
+        {
+            TCNT1 = 0;
+        }
+
+        else if(++TCNT1 == 0)
+        {
+            HOST_TIFR1 |= (1<<TOV1);
+        }
+
+        if(TCNT1 == OCR1A)
+        {
+            HOST_TIFR1 |= (1<<OCF1A);
+        }
+
+        if(TCNT1 == OCR1B)
+        {
+            HOST_TIFR1 |= (1<<OCF1B);
+        }
+    }
+
+    return;
+}
+
+//timer1 input capture, the source is the comparator output (ACIC) or the ICP1 pin (PB0)
+static void host_capture_update(void)
+{
+    uint8_t level = (ACSR & (1<<ACIC)) ? ((ACSR & (1<<ACO)) != 0) : ((PINB & (1<<PB0)) != 0);
+
+    if(HOST_PRR & HOST_PR(PRTIM1))
+    {
+        return;
+    }
+
+    if(level != host_capture_level)
+    {
+        host_capture_level = level;
+
+        if(level == ((TCCR1B & (1<<ICES1)) != 0))
+        {
+            ICR1 = TCNT1;
+            HOST_TIFR1 |= (1<<ICF1);
+        }
+    }
+
+    return;
+}
+
+
+//_____ADC_____
+static uint16_t host_adc_prescaler(void)
+{
+    uint8_t adps = ADCSRA & 0x07;
+
+    return ((adps == 0) ? 2 : (1<<adps));
+}
+
+//start a conversion (if none is running), the input and the reference are sampled
+static void host_adc_start(void)
+{
+    uint8_t refs = ADMUX >> 6;
+
+    if(host_adc_converting || !(ADCSRA & (1<<ADEN)) || (HOST_PRR & HOST_PR(PRADC)))
+    {
+        return;
+    }
+
+    host_adc_converting = true;
+    host_adc_cycles = (host_adc_first ? 25 : 13) * host_adc_prescaler();
+    host_adc_first = false;
+    host_adc_input_mv = host_channel_mv(ADMUX & 0x0F);
+    host_adc_reference_mv = (refs == 3) ? HOST_INTERNAL_REFERENCE_MV : host_avcc_mv();
+    ADCSRA |= (1<<ADSC);
+
+    return;
+}
+
+static void host_adc_run(uint32_t cycles)
+{
+    int32_t code;
+
+    if(!(ADCSRA & (1<<ADEN)) || (HOST_PRR & HOST_PR(PRADC)))
+    {
+        host_adc_converting = false;
+        host_adc_first = true;
+        ADCSRA &= ~(1<<ADSC);
+
+        return;
+    }
+
+    //a conversion is started by writing ADSC
+    if(!host_adc_converting && (ADCSRA & (1<<ADSC)))
+    {
+        host_adc_start();
+    }
+
+    if(!host_adc_converting)
+    {
+        return;
+    }
+
+    host_adc_cycles -= cycles;
+
+    if(host_adc_cycles > 0)
+    {
+        return;
+    }
+
+    code = (int32_t) (host_adc_input_mv * 1024 / host_adc_reference_mv);
+    code = (code < 0) ? 0 : ((code > 1023) ? 1023 : code);
+
+    if(ADMUX & (1<<ADLAR))
+    {
+        code <<= 6;
+    }
+
+    ADC = code;
+    ADCL = (uint8_t) code;
+    ADCH = (uint8_t) (code >> 8);
+    ADCSRA |= (1<<ADIF);
+    host_adc_converting = false;
+
+    //in free running mode the next conversion starts at once (the cycles left over are kept)
+    if(HOST_ADC_FREE_RUNNING)
+    {
+        int32_t left = host_adc_cycles;
+
+        host_adc_start();
+        host_adc_cycles += left;
+    }
+
+    else
+    {
+        ADCSRA &= ~(1<<ADSC);
+    }
+
+    return;
+}
+
+
+//_____EEPROM_____
+//offset of an address (EEMEM variable) in the EEPROM
+static uint16_t host_eeprom_offset(uint16_t address)
+{
+    return ((uint16_t) (address - (uint16_t) (uintptr_t) __start_host_eeprom) & E2END);
+}
+
+//a write starts when the write enable bit is set and takes HOST_EEPROM_WRITE_CYCLES
+static void host_eeprom_run(uint32_t cycles)
+{
+    if(host_eeprom_busy > 0)
+    {
+        if(host_eeprom_busy > cycles)
+        {
+            host_eeprom_busy -= cycles;
+        }
+
+        else
+        {
+            host_eeprom_busy = 0;
+            EECR &= ~(1<<HOST_EEPE);
+        }
+
+        return;
+    }
+
+    if(EECR & (1<<HOST_EEPE))
+    {
+        host_eeprom[host_eeprom_offset(EEAR)] = EEDR;
+        host_eeprom_busy = HOST_EEPROM_WRITE_CYCLES;
+        EECR &= ~(1<<HOST_EEMPE);
+    }
+
+    return;
+}
+
+//the EEPROM starts with the initial values of the EEMEM variables (or the contents of the EEPROM file)
+static void host_eeprom_init(void)
+{
+    FILE* file;
+    size_t length = __stop_host_eeprom - __start_host_eeprom;
+
+    memset(host_eeprom, 0xFF, sizeof(host_eeprom));
+    memcpy(host_eeprom, __start_host_eeprom, (length < sizeof(host_eeprom)) ? length : sizeof(host_eeprom));
+
+    if(host_eeprom_file && (file = fopen(host_eeprom_file, "rb")))
+    {
+        if(fread(host_eeprom, 1, sizeof(host_eeprom), file) != sizeof(host_eeprom))
+        {
+            fprintf(stderr, "%s :- not a complete EEPROM image\n", host_eeprom_file);
+        }
+
+        fclose(file);
+    }
+
+    return;
+}
+
+static void host_eeprom_save(void)
+{
+    FILE* file;
+
+    if(!host_eeprom_file)
+    {
+        return;
+    }
+
+    if(!(file = fopen(host_eeprom_file, "wb")))
+    {
+        perror(host_eeprom_file);
+
+        return;
+    }
+
+    fwrite(host_eeprom, 1, sizeof(host_eeprom), file);
+    fclose(file);
+
+    return;
+}
+
+uint8_t eeprom_read_byte(const uint8_t* address)
+{
+    eeprom_busy_wait();
+
+    return (host_eeprom[host_eeprom_offset((uintptr_t) address)]);
+}
+
+uint16_t eeprom_read_word(const uint16_t* address)
+{
+    uint16_t value;
+
+    eeprom_read_block(&value, address, sizeof(value));
+
+    return (value);
+}
+
+uint32_t eeprom_read_dword(const uint32_t* address)
+{
+    uint32_t value;
+
+    eeprom_read_block(&value, address, sizeof(value));
+
+    return (value);
+}
+
+void eeprom_read_block(void* destination, const void* source, size_t length)
+{
+    size_t count;
+
+    for(count = 0; count < length; count++)
+    {
+        ((uint8_t*) destination)[count] = eeprom_read_byte(((const uint8_t*) source) + count);
+    }
+
+    return;
+}
+
+//write a byte through the registers, the write takes 3.4ms as on the avr
+void eeprom_write_byte(uint8_t* address, uint8_t value)
+{
+    eeprom_busy_wait();
+    EEAR = (uint16_t) (uintptr_t) address;
+    EEDR = value;
+    EECR |= (1<<HOST_EEMPE);
+    EECR |= (1<<HOST_EEPE);
+    host_eeprom_run(0);
+
+    return;
+}
+
+void eeprom_write_word(uint16_t* address, uint16_t value)
+{
+    eeprom_write_block(&value, address, sizeof(value));
+
+    return;
+}
+
+void eeprom_write_dword(uint32_t* address, uint32_t value)
+{
+    eeprom_write_block(&value, address, sizeof(value));
+
+    return;
+}
+
+void eeprom_write_block(const void* source, void* destination, size_t length)
+{
+    size_t count;
+
+    for(count = 0; count < length; count++)
+    {
+        eeprom_write_byte(((uint8_t*) destination) + count, ((const uint8_t*) source)[count]);
+    }
+
+    return;
+}
+
+void eeprom_update_byte(uint8_t* address, uint8_t value)
+{
+    if(eeprom_read_byte(address) != value)
+    {
+        eeprom_write_byte(address, value);
+    }
+
+    return;
+}
+
+void eeprom_update_word(uint16_t* address, uint16_t value)
+{
+    eeprom_update_block(&value, address, sizeof(value));
+
+    return;
+}
+
+void eeprom_update_dword(uint32_t* address, uint32_t value)
+{
+    eeprom_update_block(&value, address, sizeof(value));
+
+    return;
+}
+
+void eeprom_update_block(const void* source, void* destination, size_t length)
+{
+    size_t count;
+
+    for(count = 0; count < length; count++)
+    {
+        eeprom_update_byte(((uint8_t*) destination) + count, ((const uint8_t*) source)[count]);
+    }
+
+    return;
+}
+
+
+//_____USART_____
+//cycles of a frame (start bit, 8 data bits, stop bit)
+static uint32_t host_uart_frame_cycles(void)
+{
+    uint16_t ubrr = ((HOST_UBRRH & 0x0F) << 8) | HOST_UBRRL;
+
+    return (10UL * (ubrr + 1) * ((HOST_UCSRA & (1<<HOST_U2X)) ? 8 : 16));
+}
+
+//UDR has been written
+static void host_uart_write(void)
+{
+    if(!(HOST_UCSRB & (1<<HOST_TXEN)))
+    {
+        return;
+    }
+
+    host_uart_buffer = HOST_UDR;
+    host_uart_buffer_full = true;
+    HOST_UCSRA &= ~(1<<HOST_UDRE);
+
+    return;
+}
+
+static void host_uart_run(uint32_t cycles)
+{
+    //transmitter, the data register is moved to the shift register when it is empty
+    if(!(HOST_UCSRB & (1<<HOST_TXEN)) || (HOST_PRR & HOST_PR(PRUSART0)))
+    {
+        host_uart_shifting = false;
+        host_uart_buffer_full = false;
+    }
+
+    else
+    {
+        if(host_uart_shifting)
+        {
+            if(host_uart_tx_cycles > cycles)
+            {
+                host_uart_tx_cycles -= cycles;
+            }
+
+            else
+            {
+                host_uart_shifting = false;
+
+                if(host_uart_file)
+                {
+                    fputc(host_uart_shift, host_uart_file);
+                }
+
+                if(!host_uart_buffer_full)
+                {
+                    HOST_UCSRA |= (1<<HOST_TXC);
+                }
+            }
+        }
+
+        if(!host_uart_shifting && host_uart_buffer_full)
+        {
+            host_uart_shift = host_uart_buffer;
+            host_uart_buffer_full = false;
+            host_uart_shifting = true;
+            host_uart_tx_cycles = host_uart_frame_cycles();
+        }
+    }
+
+    if(host_uart_buffer_full)
+    {
+        HOST_UCSRA &= ~(1<<HOST_UDRE);
+    }
+
+    else
+    {
+        HOST_UCSRA |= (1<<HOST_UDRE);
+    }
+
+    //receiver, the bytes of the script arrive one frame after the other
+    if(!(HOST_UCSRB & (1<<HOST_RXEN)) || (host_uart_rx_head == host_uart_rx_tail))
+    {
+        host_uart_rx_cycles = 0;
+
+        return;
+    }
+
+    host_uart_rx_cycles += cycles;
+
+    if(host_uart_rx_cycles >= host_uart_frame_cycles())
+    {
+        host_uart_rx_cycles = 0;
+
+        //a byte that has not been read is overwritten (data overrun)
+        if(HOST_UCSRA & (1<<HOST_RXC))
+        {
+            HOST_UCSRA |= (1<<HOST_DOR);
+        }
+
+        HOST_UDR = host_uart_rx_fifo[host_uart_rx_tail++];
+        HOST_UCSRA |= (1<<HOST_RXC);
+    }
+
+    return;
+}
+
+
+//_____LCD_____
+//text of the lcd (custom characters as #, other characters outside ascii as ?)
+static void host_lcd_text(char text[2][17])
+{
+    uint8_t line;
+    uint8_t count;
+
+    for(line = 0; line < 2; line++)
+    {
+        for(count = 0; count < 16; count++)
+        {
+            uint8_t data = host_lcd_ddram[line*0x40 + count];
+
+            text[line][count] = (data < 0x08) ? '#' : (((data < 0x20) || (data > 0x7E)) ? '?' : data);
+        }
+
+        text[line][16] = '\0';
+    }
+
+    return;
+}
+
+static void host_lcd_print(void)
+{
+    host_lcd_text(host_lcd_shown);
+    printf("lcd %lu |%s|%s|\n", (unsigned long) (host_cycles / HOST_CYCLES_MS), host_lcd_shown[0], host_lcd_shown[1]);
+
+    return;
+}
+
+//a command or data byte has been latched
+static void host_lcd_latch(uint8_t value, bool data)
+{
+    if(data)
+    {
+        //characters written to the cgram are not kept
+        if(!host_lcd_cgram)
+        {
+            host_lcd_ddram[host_lcd_address] = value;
+
+            //the 2 lines are 0x00 to 0x27 and 0x40 to 0x67
+            host_lcd_address++;
+
+            if(host_lcd_address == 0x28)
+            {
+                host_lcd_address = 0x40;
+            }
+
+            else if(host_lcd_address == 0x68)
+            {
+                host_lcd_address = 0x00;
+            }
+        }
+    }
+
+    else if(value & 0x80)
+    {
+        host_lcd_address = value & 0x7F;
+        host_lcd_cgram = false;
+    }
+
+    else if(value & 0x40)
+    {
+        host_lcd_cgram = true;
+    }
+
+    else if(value == 0x01)
+    {
+        memset(host_lcd_ddram, ' ', sizeof(host_lcd_ddram));
+        host_lcd_address = 0;
+        host_lcd_cgram = false;
+    }
+
+    else if((value & 0xFE) == 0x02)
+    {
+        host_lcd_address = 0;
+        host_lcd_cgram = false;
+    }
+
+    //entry mode, display control, shift and function set are not modelled
+
+    host_lcd_changed = true;
+    host_lcd_changed_cycles = host_cycles;
+
+    return;
+}
+
+//the lcd latches a write on the falling edge of EN
+static void host_lcd_write(void)
+{
+    bool enable = (PORTC & (1<<PC5)) != 0;
+
+    if(host_lcd_enable && !enable && !(PORTC & (1<<PC4)))
+    {
+        host_lcd_latch(PORTB, (PORTC & (1<<PC3)) != 0);
+    }
+
+    host_lcd_enable = enable;
+
+    return;
+}
+
+//the lcd is printed when its text has changed and the writes have settled
+static void host_lcd_run(void)
+{
+    char text[2][17];
+
+    if(!host_lcd_changed || (host_cycles - host_lcd_changed_cycles < HOST_LCD_SETTLE_CYCLES))
+    {
+        return;
+    }
+
+    host_lcd_changed = false;
+    host_lcd_text(text);
+
+    if(memcmp(text, host_lcd_shown, sizeof(text)) != 0)
+    {
+        host_lcd_print();
+    }
+
+    return;
+}
+
+
+//_____Script_____
+//index of an input name, -1 if the name is unknown
+static int8_t host_input_index(const char* name)
+{
+    if((name[0] >= 'B') && (name[0] <= 'D') && (name[1] >= '0') && (name[1] <= '7') && (name[2] == '\0'))
+    {
+        return ((name[0] - 'B')*8 + (name[1] - '0'));
+    }
+
+    if((strncmp(name, "ADC", 3) == 0) && (name[3] >= '0') && (name[3] <= '7') && (name[4] == '\0'))
+    {
+        return ((name[3] < '6') ? (8 + name[3] - '0') : (HOST_INPUT_ADC6 + name[3] - '6'));
+    }
+
+    if(strcmp(name, "AIN0") == 0)
+    {
+        return (HOST_INPUT_AIN0);
+    }
+
+    if(strcmp(name, "AIN1") == 0)
+    {
+        return (HOST_INPUT_AIN1);
+    }
+
+    if(strcmp(name, "AVCC") == 0)
+    {
+        return (HOST_INPUT_AVCC);
+    }
+
+    return (-1);
+}
+
+static void host_end(void)
+{
+    host_lcd_print();
+    host_eeprom_save();
+
+    if(host_uart_file)
+    {
+        fclose(host_uart_file);
+    }
+
+    exit(0);
+}
+
+//execute a command of the script
+static void host_command(const char* command)
+{
+    char name[16];
+    char level[4];
+    double values[4];
+    int8_t index = -1;
+    int length;
+    int fields;
+    host_input_t input = {HOST_LEVEL, 0, 0, 0, 0};
+
+    if(sscanf(command, "pin %15s %3s", name, level) == 2)
+    {
+        index = host_input_index(name);
+        input.type = (level[0] == 'z') ? HOST_UNDRIVEN : HOST_LEVEL;
+        input.mv = (level[0] == '1') ? host_avcc_mv() : 0;
+    }
+
+    else if(sscanf(command, "analog %15s %lf", name, &values[0]) == 2)
+    {
+        index = host_input_index(name);
+        input.mv = values[0];
+    }
+
+    else if((fields = sscanf(command, "square %15s %lf %lf %lf", name, &values[0], &values[1], &values[2])) >= 2)
+    {
+        index = host_input_index(name);
+        input.type = HOST_SQUARE;
+        input.hz = values[0];
+        input.a = (fields == 4) ? values[1] : 0;
+        input.b = (fields == 4) ? values[2] : host_avcc_mv();
+    }
+
+    else if(sscanf(command, "sine %15s %lf %lf %lf", name, &values[0], &values[1], &values[2]) == 4)
+    {
+        index = host_input_index(name);
+        input.type = HOST_SINE;
+        input.hz = values[0];
+        input.a = values[1];
+        input.b = values[2];
+    }
+
+    else if(strncmp(command, "uart", 4) == 0)
+    {
+        unsigned int data;
+
+        for(command += 4; sscanf(command, "%x%n", &data, &length) == 1; command += length)
+        {
+            host_uart_rx_fifo[host_uart_rx_head++] = data;
+        }
+
+        return;
+    }
+
+    else if(strcmp(command, "lcd") == 0)
+    {
+        host_lcd_print();
+
+        return;
+    }
+
+    else if(strcmp(command, "end") == 0)
+    {
+        host_end();
+    }
+
+    if(index < 0)
+    {
+        fprintf(stderr, "script :- unknown command or input \"%s\"\n", command);
+
+        return;
+    }
+
+    host_inputs[index] = input;
+
+    return;
+}
+
+static void host_script_run(void)
+{
+    while((host_script_next < host_script_length) && (host_script[host_script_next].ms*(uint64_t) HOST_CYCLES_MS <= host_cycles))
+    {
+        host_command(host_script[host_script_next++].command);
+    }
+
+    return;
+}
+
+static void host_script_load(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    char line[HOST_SCRIPT_LINE + 16];
+
+    if(!file)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    while(fgets(line, sizeof(line), file))
+    {
+        host_script_t entry;
+        int length;
+
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if((line[0] == '#') || (sscanf(line, "%u %n", &entry.ms, &length) != 1))
+        {
+            continue;
+        }
+
+        snprintf(entry.command, sizeof(entry.command), "%s", line + length);
+        host_script = realloc(host_script, (host_script_length + 1) * sizeof(host_script_t));
+        host_script[host_script_length++] = entry;
+    }
+
+    fclose(file);
+
+    return;
+}
+
+
+//_____Virtual clock_____
+static const host_interrupt_t* host_pending(void)
+{
+    uint8_t count;
+
+    for(count = 0; count < sizeof(host_interrupts)/sizeof(host_interrupt_t); count++)
+    {
+        const host_interrupt_t* interrupt = &host_interrupts[count];
+        bool flag = (*interrupt->flag & interrupt->flag_mask) != 0;
+
+        if(interrupt->vector && (*interrupt->enable & interrupt->enable_mask) && (flag != (interrupt->type == HOST_PENDING_CLEAR)))
+        {
+            return (interrupt);
+        }
+    }
+
+    return (NULL);
+}
+
+//execute pending interrupts (the I bit is cleared while an ISR runs)
+static void host_dispatch(void)
+{
+    uint8_t count;
+
+    for(count = 0; (count < HOST_STEP_INTERRUPTS) && (SREG & 0x80); count++)
+    {
+        const host_interrupt_t* interrupt = host_pending();
+
+        if(!interrupt)
+        {
+            break;
+        }
+
+        if(interrupt->type == HOST_FLAG)
+        {
+            *interrupt->flag &= ~interrupt->flag_mask;
+        }
+
+        SREG &= ~0x80;
+        interrupt->vector();
+        SREG |= 0x80;
+        host_interrupt_count++;
+    }
+
+    return;
+}
+
+static void host_step(void)
+{
+    host_cycles += HOST_STEP_CYCLES;
+
+    host_script_run();
+    host_pins_update();
+    host_comparator_update();
+    host_timer_run(&host_timer2, HOST_STEP_CYCLES);
+    host_timer1_run(HOST_STEP_CYCLES);
+    //an edge during the step is captured with the count at the end of the step
+    host_capture_update();
+
+    if(host_timer_run(&host_timer0, HOST_STEP_CYCLES) && HOST_ADC_TIMER0_TRIGGER)
+    {
+        host_adc_start();
+    }
+
+    host_adc_run(HOST_STEP_CYCLES);
+    host_uart_run(HOST_STEP_CYCLES);
+    host_eeprom_run(HOST_STEP_CYCLES);
+    host_lcd_run();
+
+    if(host_cycles >= host_end_cycles)
+    {
+        host_end();
+    }
+
+    host_dispatch();
+
+    return;
+}
+
+void host_idle(void)
+{
+    host_step();
+
+    return;
+}
+
+void host_delay_us(double us)
+{
+    host_delay_remainder += us;
+
+    while(host_delay_remainder >= 1.0)
+    {
+        host_delay_remainder -= 1.0;
+        host_step();
+    }
+
+    return;
+}
+
+//sleep until an interrupt has been executed
+//SLEEP_MODE_ADC halts the timers (clkIO) and starts a conversion
+void host_sleep(void)
+{
+    uint32_t count = host_interrupt_count;
+
+    if(!host_sleep_enabled)
+    {
+        return;
+    }
+
+    if(host_sleep_mode == SLEEP_MODE_ADC)
+    {
+        host_clkio_halted = true;
+        host_adc_start();
+    }
+
+    while(count == host_interrupt_count)
+    {
+        host_step();
+    }
+
+    host_clkio_halted = false;
+
+    return;
+}
+
+//pending interrupts are executed at the end of the next step (after sei() the avr also executes one more instruction)
+void host_sei(void)
+{
+    SREG |= 0x80;
+
+    return;
+}
+
+void host_io_write(volatile uint8_t* reg)
+{
+    if(reg == &HOST_UDR)
+    {
+        host_uart_write();
+    }
+
+    else if((reg == &PORTB) || (reg == &PORTC) || (reg == &DDRB) || (reg == &DDRC))
+    {
+        host_lcd_write();
+    }
+
+    return;
+}
+
+
+//_____Start up_____
+static void host_usage(const char* name)
+{
+    fprintf(stderr, "usage :- %s [-s script] [-t ms] [-u uart_file] [-e eeprom_file]\n", name);
+    exit(1);
+}
+
+//runs before main() of the firmware (glibc passes the arguments to constructors)
+__attribute__((constructor)) static void host_init(int argc, char* argv[])
+{
+    int option;
+
+    while((option = getopt(argc, argv, "s:t:u:e:")) != -1)
+    {
+        switch(option)
+        {
+            case 's':
+                host_script_load(optarg);
+                break;
+
+            case 't':
+                host_end_cycles = strtoull(optarg, NULL, 10) * HOST_CYCLES_MS;
+                break;
+
+            case 'u':
+                if(!(host_uart_file = fopen(optarg, "wb")))
+                {
+                    perror(optarg);
+                    exit(1);
+                }
+                break;
+
+            case 'e':
+                host_eeprom_file = optarg;
+                break;
+
+            default:
+                host_usage(argv[0]);
+        }
+    }
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    //reset values of the registers that are not zero
+    HOST_UCSRA = (1<<HOST_UDRE);
+    memset(host_lcd_ddram, ' ', sizeof(host_lcd_ddram));
+    host_lcd_text(host_lcd_shown);
+    host_inputs[HOST_INPUT_AVCC].type = HOST_LEVEL;
+    host_inputs[HOST_INPUT_AVCC].mv = 5000;
+
+    host_eeprom_init();
+    host_pins_update();
+
+    return;
+}
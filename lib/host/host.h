@@ -0,0 +1,22 @@
+#ifndef HOST_H_INCLUDED
+#define HOST_H_INCLUDED
+
+//host build of the firmware (linux, gcc)
+//the directory lib/host replaces the avr-libc headers (add -Ilib/host before the other include directories),
+//the registers are variables and host.c runs models of the peripherals on a virtual clock:
+//timer0/1/2, input capture, analog comparator, ADC, EEPROM, USART, port pins, pin change interrupts and a HD44780 lcd
+//the clock runs in steps of 1us while the firmware waits (HAL_IDLE(), delays, busy waits, sleep_cpu())
+//the executable takes a script of input changes and prints the lcd whenever its contents change (see host.c)
+
+#include <stdint.h>
+
+//run the virtual clock for one step (1us), the models are updated and pending interrupts are executed
+void host_idle(void);
+//run the virtual clock until an interrupt has been executed (sleep_cpu())
+void host_sleep(void);
+//run the virtual clock for a delay
+void host_delay_us(double us);
+//a register has been written that a model has to see at once (port pins of the lcd, data register of the usart)
+void host_io_write(volatile uint8_t* reg);
+
+#endif // HOST_H_INCLUDED
@@ -0,0 +1,474 @@
+/* Tests of the library (host build)
+Checks the functions of lib/src against reference results computed on the host, prints every failed check
+and exits with status 1 if any check failed (0 and a summary line otherwise).
+
+build :- gcc -std=gnu99 -o lib_test -D__AVR_ATmega328P__ -DF_CPU=8000000UL -Ilib/host -Ilib/headers lib/host/test.c lib/src/[a-z]*.c lib/host/host.c -lm
+(from the top of the repository, see host.c)
+usage :- lib_test
+
+cobs :- round trip of blocks from 0 to 253 bytes with and without zero bytes, no zero byte in the encoded block,
+encoded length, invalid blocks
+crc :- check values of the crc functions of util/crc16.h ("123456789")
+stats :- mean, standard deviation, min and max against double precision, rounding of the mean
+fsm :- order of the exit, transition and entry actions, ignored events, transitions to the same state,
+events posted by actions, full queue
+goertzel :- coefficients, sines centred on a bin (largest bin, magnitude, rejection of the neighbouring bins)
+*/
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+
+#include "cobs.h"
+#include "stats.h"
+#include "fsm.h"
+#include "goertzel.h"
+
+
+//number of checks and of failed checks
+static uint32_t test_checks = 0;
+static uint32_t test_failures = 0;
+
+//count a check, print it if it failed
+#define TEST_CHECK(condition, ...) test_check((condition), #condition, __FILE__, __LINE__, __VA_ARGS__)
+
+static void test_check(bool passed, const char* condition, const char* file, int line, const char* format, ...)
+    __attribute__((format(printf, 5, 6)));
+
+static void test_check(bool passed, const char* condition, const char* file, int line, const char* format, ...)
+{
+    va_list arguments;
+
+    test_checks++;
+
+    if(passed)
+    {
+        return;
+    }
+
+    test_failures++;
+    printf("%s:%d: failed :- %s (", file, line, condition);
+    va_start(arguments, format);
+    vprintf(format, arguments);
+    va_end(arguments);
+    printf(")\n");
+
+    return;
+}
+
+
+//_____cobs_____
+//encode and decode a block, the encoded block must not contain a zero byte
+static void test_cobs_block(const uint8_t* data, uint8_t length)
+{
+    uint8_t encoded[COBS_ENCODED_LENGTH(253)];
+    uint8_t decoded[COBS_ENCODED_LENGTH(253)];
+    uint8_t encoded_length;
+    int16_t decoded_length;
+    uint8_t count;
+
+    encoded_length = cobs_encode(data, length, encoded);
+    TEST_CHECK(encoded_length <= COBS_ENCODED_LENGTH(length), "length %u, encoded %u", length, encoded_length);
+
+    for(count = 0; count < encoded_length; count++)
+    {
+        if(encoded[count] == 0)
+        {
+            break;
+        }
+    }
+
+    TEST_CHECK(count == encoded_length, "length %u, zero byte at %u", length, count);
+
+    decoded_length = cobs_decode(encoded, encoded_length, decoded);
+    TEST_CHECK((decoded_length == length) && (memcmp(data, decoded, length) == 0), "length %u, decoded %d",
+        length, decoded_length);
+
+    return;
+}
+
+static void test_cobs(void)
+{
+    uint8_t data[253];
+    uint8_t decoded[8];
+    uint16_t length;
+    uint16_t count;
+
+    for(length = 0; length <= sizeof(data); length++)
+    {
+        //no zero bytes (runs up to the full 254 bytes), only zero bytes, every third byte zero, random bytes
+        memset(data, 0x55, length);
+        test_cobs_block(data, length);
+        memset(data, 0, length);
+        test_cobs_block(data, length);
+
+        for(count = 0; count < length; count++)
+        {
+            data[count] = (count % 3 == 0) ? 0 : count;
+        }
+
+        test_cobs_block(data, length);
+
+        for(count = 0; count < length; count++)
+        {
+            data[count] = rand();
+        }
+
+        test_cobs_block(data, length);
+    }
+
+    //known encodings
+    data[0] = 0x11;
+    data[1] = 0x00;
+    data[2] = 0x22;
+    TEST_CHECK((cobs_encode(data, 3, decoded) == 4) && (memcmp(decoded, "\x02\x11\x02\x22", 4) == 0), "%02X %02X %02X %02X",
+        decoded[0], decoded[1], decoded[2], decoded[3]);
+    TEST_CHECK((cobs_encode(data + 1, 1, decoded) == 2) && (memcmp(decoded, "\x01\x01", 2) == 0), "%02X %02X",
+        decoded[0], decoded[1]);
+
+    //a zero byte and a run longer than the block are not valid
+    TEST_CHECK(cobs_decode((const uint8_t*) "\x02\x11\x00\x22", 4, decoded) == -1, "zero byte");
+    TEST_CHECK(cobs_decode((const uint8_t*) "\x05\x11\x22", 3, decoded) == -1, "run too long");
+
+    return;
+}
+
+
+//_____crc_____
+//crc of "123456789" with the update function and initial value
+#define TEST_CRC(update, initial) ({ \
+    const char* data = "123456789"; \
+    uint16_t crc = (initial); \
+    while(*data) crc = update(crc, *data++); \
+    crc; })
+
+static void test_crc(void)
+{
+    //check values of crc-16/arc, crc-16/xmodem, crc-16/kermit, crc-16/ibm-sdlc (before the final inversion),
+    //crc-8/maxim and crc-8 (smbus)
+    TEST_CHECK(TEST_CRC(_crc16_update, 0) == 0xBB3D, "%04X", TEST_CRC(_crc16_update, 0));
+    TEST_CHECK(TEST_CRC(_crc_xmodem_update, 0) == 0x31C3, "%04X", TEST_CRC(_crc_xmodem_update, 0));
+    TEST_CHECK(TEST_CRC(_crc_ccitt_update, 0) == 0x2189, "%04X", TEST_CRC(_crc_ccitt_update, 0));
+    TEST_CHECK(TEST_CRC(_crc_ccitt_update, 0xFFFF) == (0x906E ^ 0xFFFF), "%04X", TEST_CRC(_crc_ccitt_update, 0xFFFF));
+    TEST_CHECK(TEST_CRC(_crc_ibutton_update, 0) == 0xA1, "%02X", TEST_CRC(_crc_ibutton_update, 0));
+    TEST_CHECK(TEST_CRC(_crc8_ccitt_update, 0) == 0xF4, "%02X", TEST_CRC(_crc8_ccitt_update, 0));
+
+    return;
+}
+
+
+//_____stats_____
+//add the values and compare the results with double precision
+static void test_stats_values(const int32_t* values, uint16_t count)
+{
+    stats_t stats;
+    double sum = 0;
+    double squares = 0;
+    double mean;
+    double deviation = 0;
+    int32_t min = values[0];
+    int32_t max = values[0];
+    uint16_t index;
+
+    stats_reset(&stats);
+
+    for(index = 0; index < count; index++)
+    {
+        stats_update(&stats, values[index]);
+        sum += values[index];
+        min = (values[index] < min) ? values[index] : min;
+        max = (values[index] > max) ? values[index] : max;
+    }
+
+    mean = sum/count;
+
+    for(index = 0; index < count; index++)
+    {
+        squares += (values[index] - mean) * (values[index] - mean);
+    }
+
+    if(count > 1)
+    {
+        deviation = sqrt(squares/(count - 1));
+    }
+
+    TEST_CHECK(stats.count == count, "count %u", count);
+    TEST_CHECK((stats.min == min) && (stats.max == max), "min %d max %d", (int) stats.min, (int) stats.max);
+    //the mean is rounded to the nearest integer, the deviation is an integer square root
+    //(the squared deviations are summed with the integer part of the running mean, within 1 + 0.01%)
+    TEST_CHECK(fabs(stats_mean(&stats) - mean) <= 0.5, "count %u, mean %d, expected %f", count,
+        (int) stats_mean(&stats), mean);
+    TEST_CHECK(fabs(stats_deviation(&stats) - deviation) <= 1 + deviation * 1e-4,
+        "count %u, deviation %u, expected %f", count, (unsigned) stats_deviation(&stats), deviation);
+
+    return;
+}
+
+static void test_stats(void)
+{
+    int32_t values[1000];
+    uint16_t count;
+    stats_t stats;
+
+    //reaction times (us), readings around a large offset, large values of both signs
+    //(differences up to 2^30, the sum of squares of 1000 values must fit in 64 bits)
+    for(count = 0; count < 1000; count++)
+    {
+        values[count] = 100000 + rand() % 300000;
+    }
+
+    test_stats_values(values, 1);
+    test_stats_values(values, 2);
+    test_stats_values(values, 10);
+    test_stats_values(values, 1000);
+
+    for(count = 0; count < 1000; count++)
+    {
+        values[count] = 1000000000 + rand() % 1024;
+    }
+
+    test_stats_values(values, 1000);
+
+    for(count = 0; count < 1000; count++)
+    {
+        values[count] = (rand() % 2) ? 50000000 : -50000000;
+    }
+
+    test_stats_values(values, 1000);
+
+    //mean of 1 and 2 (1.5 rounds up), of -1 and -2 (-1.5 rounds to -1), of 1, 1 and 2 (1.33)
+    stats_reset(&stats);
+    stats_update(&stats, 1);
+    stats_update(&stats, 2);
+    TEST_CHECK(stats_mean(&stats) == 2, "%d", (int) stats_mean(&stats));
+    stats_reset(&stats);
+    stats_update(&stats, -1);
+    stats_update(&stats, -2);
+    TEST_CHECK(stats_mean(&stats) == -1, "%d", (int) stats_mean(&stats));
+    stats_reset(&stats);
+    stats_update(&stats, 1);
+    stats_update(&stats, 1);
+    stats_update(&stats, 2);
+    TEST_CHECK(stats_mean(&stats) == 1, "%d", (int) stats_mean(&stats));
+
+    //no values
+    stats_reset(&stats);
+    TEST_CHECK((stats_mean(&stats) == 0) && (stats_deviation(&stats) == 0), "empty");
+
+    return;
+}
+
+
+//_____fsm_____
+//states, events and a trace of the actions (one character per action)
+#define TEST_IDLE 0
+#define TEST_ARMED 1
+#define TEST_DONE 2
+#define TEST_NUM_STATES 3
+
+#define TEST_START 0
+#define TEST_TICK 1
+#define TEST_STOP 2
+#define TEST_CHAIN 3
+#define TEST_NUM_EVENTS 4
+
+static fsm_t test_fsm;
+static char test_trace[64];
+
+static void test_trace_add(char action)
+{
+    size_t length = strlen(test_trace);
+
+    if(length < sizeof(test_trace) - 1)
+    {
+        test_trace[length] = action;
+        test_trace[length + 1] = '\0';
+    }
+
+    return;
+}
+
+static void test_idle_entry(void) { test_trace_add('i'); return; }
+static void test_idle_exit(void) { test_trace_add('I'); return; }
+static void test_armed_entry(void) { test_trace_add('a'); return; }
+static void test_armed_exit(void) { test_trace_add('A'); return; }
+static void test_done_entry(void) { test_trace_add('d'); return; }
+static void test_start(void) { test_trace_add('s'); return; }
+static void test_tick(void) { test_trace_add('t'); return; }
+//posts the next event from an action
+static void test_chain(void) { test_trace_add('c'); fsm_post(&test_fsm, TEST_STOP); return; }
+
+static const fsm_transition_t test_transitions[TEST_NUM_STATES][TEST_NUM_EVENTS] PROGMEM =
+{
+    [TEST_IDLE] =
+    {
+        [TEST_START] = FSM_TRANSITION(TEST_ARMED, test_start),
+    },
+    [TEST_ARMED] =
+    {
+        [TEST_TICK] = FSM_TRANSITION(TEST_ARMED, test_tick),
+        [TEST_STOP] = FSM_TRANSITION(TEST_DONE, NULL),
+        [TEST_CHAIN] = FSM_TRANSITION(TEST_ARMED, test_chain),
+    },
+    [TEST_DONE] =
+    {
+        [TEST_START] = FSM_TRANSITION(TEST_IDLE, NULL),
+    },
+};
+
+static const fsm_state_t test_states[TEST_NUM_STATES] PROGMEM =
+{
+    [TEST_IDLE] = {test_idle_entry, test_idle_exit},
+    [TEST_ARMED] = {test_armed_entry, test_armed_exit},
+    [TEST_DONE] = {test_done_entry, NULL},
+};
+
+static void test_fsm_run(const uint8_t* events, uint8_t count, const char* trace, uint8_t state)
+{
+    test_trace[0] = '\0';
+
+    for(; count > 0; count--)
+    {
+        fsm_post(&test_fsm, *events++);
+    }
+
+    fsm_run(&test_fsm);
+
+    TEST_CHECK((strcmp(test_trace, trace) == 0) && (test_fsm.state == state), "trace %s, expected %s, state %u",
+        test_trace, trace, test_fsm.state);
+
+    return;
+}
+
+static void test_fsm_transitions(void)
+{
+    uint8_t count;
+
+    test_trace[0] = '\0';
+    fsm_init(&test_fsm, &test_transitions[0][0], test_states, TEST_NUM_EVENTS, TEST_IDLE);
+    TEST_CHECK(strcmp(test_trace, "i") == 0, "entry of the first state, trace %s", test_trace);
+
+    //exit, transition action, entry
+    test_fsm_run((const uint8_t[]) {TEST_START}, 1, "Isa", TEST_ARMED);
+    //a transition to the same state only runs its action, an event posted twice is handled twice
+    test_fsm_run((const uint8_t[]) {TEST_TICK, TEST_TICK}, 2, "tt", TEST_ARMED);
+    //ignored event, then a transition without an action (no exit action in TEST_DONE)
+    test_fsm_run((const uint8_t[]) {TEST_START, TEST_STOP, TEST_TICK}, 3, "Ad", TEST_DONE);
+    test_fsm_run((const uint8_t[]) {TEST_START, TEST_START}, 2, "iIsa", TEST_ARMED);
+    //an event posted by an action is handled by the same fsm_run()
+    test_fsm_run((const uint8_t[]) {TEST_CHAIN}, 1, "cAd", TEST_DONE);
+
+    //the queue keeps FSM_QUEUE_SIZE - 1 events, the others are counted as lost
+    for(count = 0; count < FSM_QUEUE_SIZE + 2; count++)
+    {
+        TEST_CHECK(fsm_post(&test_fsm, TEST_TICK) == (count < FSM_QUEUE_SIZE - 1), "post %u", count);
+    }
+
+    TEST_CHECK(test_fsm.lost == 3, "lost %u", test_fsm.lost);
+    fsm_run(&test_fsm);
+    TEST_CHECK(test_fsm.head == test_fsm.tail, "queue not empty");
+
+    return;
+}
+
+
+//_____goertzel_____
+//block of the tone detection of lab2 (bins 40Hz apart at 5kSa/s)
+#define TEST_BLOCK_SIZE 125
+#define TEST_NUM_BINS 60
+//amplitude of the test sines (adc codes, samples must lie in +-2^9)
+#define TEST_AMPLITUDE 400
+
+//feed a sine centred on a bin through the bins 1 to TEST_NUM_BINS, returns the magnitudes
+static void test_goertzel_sine(uint16_t bin, double phase, uint32_t* magnitudes)
+{
+    goertzel_t goertzel;
+    uint16_t index;
+    uint16_t count;
+
+    for(index = 1; index <= TEST_NUM_BINS; index++)
+    {
+        //the coefficients are computed at run time here (the firmware folds constant arguments)
+        goertzel_init(&goertzel, GOERTZEL_COEFF(index, TEST_BLOCK_SIZE));
+
+        for(count = 0; count < TEST_BLOCK_SIZE; count++)
+        {
+            goertzel_update(&goertzel, lround(TEST_AMPLITUDE * sin((2.0 * M_PI * bin * count) / TEST_BLOCK_SIZE + phase)));
+        }
+
+        magnitudes[index] = goertzel_magnitude(&goertzel);
+    }
+
+    return;
+}
+
+static void test_goertzel(void)
+{
+    //amplitude * block size / 2 for a sine centred on the bin
+    const uint32_t expected = (TEST_AMPLITUDE * TEST_BLOCK_SIZE) / 2;
+    uint32_t magnitudes[TEST_NUM_BINS + 1];
+    uint16_t bin;
+    uint16_t index;
+    uint16_t largest;
+
+    //2*cos in Q14, rounded to nearest (bin 1 is 32727, bin 31 is close to 0, bin 62 is -32758)
+    TEST_CHECK(GOERTZEL_COEFF(1, TEST_BLOCK_SIZE) == 32727, "%d", GOERTZEL_COEFF(1, TEST_BLOCK_SIZE));
+    TEST_CHECK(GOERTZEL_COEFF(62, TEST_BLOCK_SIZE) == -32758, "%d", GOERTZEL_COEFF(62, TEST_BLOCK_SIZE));
+    TEST_CHECK(abs(GOERTZEL_COEFF(31, TEST_BLOCK_SIZE)) < 500, "%d", GOERTZEL_COEFF(31, TEST_BLOCK_SIZE));
+
+    for(bin = 1; bin <= TEST_NUM_BINS; bin++)
+    {
+        test_goertzel_sine(bin, 0.1 * bin, magnitudes);
+
+        largest = 1;
+
+        for(index = 2; index <= TEST_NUM_BINS; index++)
+        {
+            if(magnitudes[index] > magnitudes[largest])
+            {
+                largest = index;
+            }
+        }
+
+        TEST_CHECK(largest == bin, "sine at bin %u, largest bin %u", bin, largest);
+        //within 1% (rounding of the samples and of the coefficient)
+        TEST_CHECK(labs((long) magnitudes[bin] - (long) expected) * 100 <= (long) expected, "bin %u, magnitude %lu, expected %lu",
+            bin, (unsigned long) magnitudes[bin], (unsigned long) expected);
+
+        //the neighbouring bins see at most 1% of the tone (a centred sine is a zero of their response)
+        for(index = bin - 1; index <= bin + 1; index += 2)
+        {
+            if((index >= 1) && (index <= TEST_NUM_BINS))
+            {
+                TEST_CHECK(magnitudes[index] * 100 <= magnitudes[bin], "sine at bin %u, bin %u magnitude %lu of %lu",
+                    bin, index, (unsigned long) magnitudes[index], (unsigned long) magnitudes[bin]);
+            }
+        }
+    }
+
+    return;
+}
+
+
+int main(void)
+{
+    srand(4760);
+
+    test_cobs();
+    test_crc();
+    test_stats();
+    test_fsm_transitions();
+    test_goertzel();
+
+    printf("%lu checks, %lu failed\n", (unsigned long) test_checks, (unsigned long) test_failures);
+
+    return ((test_failures == 0) ? 0 : 1);
+}
@@ -0,0 +1,37 @@
+#ifndef HOST_UTIL_ATOMIC_H_INCLUDED
+#define HOST_UTIL_ATOMIC_H_INCLUDED
+
+//atomic blocks of the host build (replaces util/atomic.h)
+//the I bit of SREG is cleared for the block and restored (or set) when the block is left, also by return or break
+//(the models only run interrupts while the virtual clock runs, so the block is atomic as on the avr)
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+static inline uint8_t host_atomic_cli(void)
+{
+    SREG &= ~0x80;
+
+    return (1);
+}
+
+static inline void host_atomic_restore(const uint8_t* sreg)
+{
+    SREG = *sreg;
+
+    return;
+}
+
+static inline void host_atomic_sei(const uint8_t* sreg)
+{
+    (void) sreg;
+    sei();
+
+    return;
+}
+
+#define ATOMIC_RESTORESTATE uint8_t host_sreg_save __attribute__((cleanup(host_atomic_restore))) = SREG
+#define ATOMIC_FORCEON uint8_t host_sreg_save __attribute__((cleanup(host_atomic_sei))) = 0
+#define ATOMIC_BLOCK(type) for(type, host_atomic_todo = host_atomic_cli(); host_atomic_todo; host_atomic_todo = 0)
+
+#endif // HOST_UTIL_ATOMIC_H_INCLUDED
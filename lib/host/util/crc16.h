@@ -0,0 +1,83 @@
+#ifndef HOST_UTIL_CRC16_H_INCLUDED
+#define HOST_UTIL_CRC16_H_INCLUDED
+
+//crc functions of the host build (replaces util/crc16.h, same results as the avr-libc assembler versions)
+
+#include <stdint.h>
+
+//polynomial 0xA001 (reflected 0x8005)
+static inline uint16_t _crc16_update(uint16_t crc, uint8_t data)
+{
+    uint8_t count;
+
+    crc ^= data;
+
+    for(count = 0; count < 8; count++)
+    {
+        crc = (crc & 1) ? ((crc >> 1) ^ 0xA001) : (crc >> 1);
+    }
+
+    return (crc);
+}
+
+//polynomial 0x1021, not reflected
+static inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+    uint8_t count;
+
+    crc ^= ((uint16_t) data) << 8;
+
+    for(count = 0; count < 8; count++)
+    {
+        crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+    }
+
+    return (crc);
+}
+
+//polynomial 0x8408 (reflected 0x1021)
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+    uint8_t count;
+
+    crc ^= data;
+
+    for(count = 0; count < 8; count++)
+    {
+        crc = (crc & 1) ? ((crc >> 1) ^ 0x8408) : (crc >> 1);
+    }
+
+    return (crc);
+}
+
+//polynomial 0x8C (reflected 0x31)
+static inline uint8_t _crc_ibutton_update(uint8_t crc, uint8_t data)
+{
+    uint8_t count;
+
+    crc ^= data;
+
+    for(count = 0; count < 8; count++)
+    {
+        crc = (crc & 1) ? ((crc >> 1) ^ 0x8C) : (crc >> 1);
+    }
+
+    return (crc);
+}
+
+//polynomial 0x07, not reflected
+static inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data)
+{
+    uint8_t count;
+
+    crc ^= data;
+
+    for(count = 0; count < 8; count++)
+    {
+        crc = (crc & 0x80) ? ((crc << 1) ^ 0x07) : (crc << 1);
+    }
+
+    return (crc);
+}
+
+#endif // HOST_UTIL_CRC16_H_INCLUDED
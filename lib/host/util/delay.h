@@ -0,0 +1,13 @@
+#ifndef HOST_UTIL_DELAY_H_INCLUDED
+#define HOST_UTIL_DELAY_H_INCLUDED
+
+//delays of the host build (replaces util/delay.h), the virtual clock runs for the time of the delay
+
+#include <stdint.h>
+
+void host_delay_us(double us);
+
+#define _delay_us(us) host_delay_us(us)
+#define _delay_ms(ms) host_delay_us((ms) * 1000.0)
+
+#endif // HOST_UTIL_DELAY_H_INCLUDED
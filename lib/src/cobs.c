@@ -0,0 +1,70 @@
+#include <stdint.h>
+
+#include "cobs.h"
+
+//cobs functions
+//encode a block of data (without the zero byte that ends the frame)
+//output needs COBS_ENCODED_LENGTH(length) bytes, returns the length of the encoded block
+//every zero byte is replaced by the distance to the next zero byte (or the end of a run of 254 non zero bytes)
+uint8_t cobs_encode(const uint8_t* data, uint8_t length, uint8_t* output)
+{
+    uint8_t code_index = 0;
+    uint8_t index = 1;
+    uint8_t code = 1;
+
+    for(; length > 0; length--)
+    {
+        if(*data != 0)
+        {
+            output[index++] = *data;
+            code++;
+        }
+
+        if((*data == 0) || (code == 0xFF))
+        {
+            //end of a run, store its length and start the next one
+            output[code_index] = code;
+            code_index = index++;
+            code = 1;
+        }
+
+        data++;
+    }
+
+    output[code_index] = code;
+
+    return (index);
+}
+
+//decode an encoded block (without the zero byte that ends the frame)
+//output needs length bytes, returns the length of the decoded data or -1 if the block is not valid
+int16_t cobs_decode(const uint8_t* data, uint8_t length, uint8_t* output)
+{
+    uint8_t index = 0;
+    uint8_t output_length = 0;
+    uint8_t code;
+    uint8_t count;
+
+    while(index < length)
+    {
+        code = data[index++];
+
+        if((code == 0) || (code - 1 > length - index))
+        {
+            return (-1);
+        }
+
+        for(count = 1; count < code; count++)
+        {
+            output[output_length++] = data[index++];
+        }
+
+        //every run except the last one and the runs of 254 bytes ends with a zero byte
+        if((code != 0xFF) && (index < length))
+        {
+            output[output_length++] = 0;
+        }
+    }
+
+    return (output_length);
+}
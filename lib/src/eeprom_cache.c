@@ -0,0 +1,181 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <util/atomic.h>
+
+#include "eeprom_cache.h"
+
+//the atmega328p names the write enable bits EEMPE and EEPE, the atmega8 names them EEMWE and EEWE
+#ifdef EEMPE
+#define EEPROM_MASTER_WRITE_ENABLE EEMPE
+#define EEPROM_WRITE_ENABLE EEPE
+#else
+#define EEPROM_MASTER_WRITE_ENABLE EEMWE
+#define EEPROM_WRITE_ENABLE EEWE
+#endif
+
+//EEPROM ready vector (EE_READY_vect on the atmega328p, EE_RDY_vect on the atmega8)
+#ifdef EE_READY_vect
+#define EEPROM_READY_VECT EE_READY_vect
+#else
+#define EEPROM_READY_VECT EE_RDY_vect
+#endif
+
+//EEPROM address of the cached region and its sram copy
+static uintptr_t eeprom_cache_base = 0;
+static volatile uint8_t eeprom_cache[EEPROM_CACHE_SIZE];
+//one bit per byte that differs from the EEPROM
+static volatile uint8_t eeprom_cache_dirty[(EEPROM_CACHE_SIZE + 7)/8];
+//number of dirty bytes and the byte the ISR looks at next (the dirty bytes are written in turn)
+static volatile uint8_t eeprom_cache_dirty_count = 0;
+static volatile uint8_t eeprom_cache_next = 0;
+
+//EEPROM ready vector, writes the next dirty byte
+//the interrupt is disabled when all bytes are written
+ISR(EEPROM_READY_VECT)
+{
+    uint8_t index = eeprom_cache_next;
+
+    if(eeprom_cache_dirty_count == 0)
+    {
+        EECR &= ~(1<<EERIE);
+
+        return;
+    }
+
+    while(!(eeprom_cache_dirty[index >> 3] & (1<<(index & 0x07))))
+    {
+        index = (index < EEPROM_CACHE_SIZE - 1) ? (index + 1) : 0;
+    }
+
+    eeprom_cache_dirty[index >> 3] &= ~(1<<(index & 0x07));
+    eeprom_cache_dirty_count--;
+    eeprom_cache_next = (index < EEPROM_CACHE_SIZE - 1) ? (index + 1) : 0;
+
+    //erase and write (the write enable bit has to be set within 4 cycles of the master write enable bit)
+    EEAR = eeprom_cache_base + index;
+    EEDR = eeprom_cache[index];
+    EECR |= (1<<EEPROM_MASTER_WRITE_ENABLE);
+    EECR |= (1<<EEPROM_WRITE_ENABLE);
+}
+
+//copy the cached region to sram (called once at power up, before any other function)
+void eeprom_cache_init(const void* address)
+{
+    eeprom_cache_base = (uintptr_t) address;
+    eeprom_read_block((void*) eeprom_cache, address, EEPROM_CACHE_SIZE);
+
+    return;
+}
+
+uint8_t eeprom_cache_read_byte(const uint8_t* address)
+{
+    uintptr_t index = ((uintptr_t) address) - eeprom_cache_base;
+
+    if(index >= EEPROM_CACHE_SIZE)
+    {
+        return (0xFF);
+    }
+
+    return (eeprom_cache[index]);
+}
+
+uint16_t eeprom_cache_read_word(const uint16_t* address)
+{
+    uint16_t value;
+
+    eeprom_cache_read_block(&value, address, sizeof(value));
+
+    return (value);
+}
+
+void eeprom_cache_read_block(void* data, const void* address, uint8_t length)
+{
+    uint8_t count;
+
+    for(count = 0; count < length; count++)
+    {
+        ((uint8_t*) data)[count] = eeprom_cache_read_byte(((const uint8_t*) address) + count);
+    }
+
+    return;
+}
+
+//change a byte of the sram copy, it is written to the EEPROM later if it changed (like eeprom_update_byte)
+void eeprom_cache_write_byte(uint8_t* address, uint8_t value)
+{
+    uintptr_t index = ((uintptr_t) address) - eeprom_cache_base;
+
+    if((index >= EEPROM_CACHE_SIZE) || (eeprom_cache[index] == value))
+    {
+        return;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        eeprom_cache[index] = value;
+
+        //a byte that is already dirty is written once with the newest value
+        if(!(eeprom_cache_dirty[index >> 3] & (1<<(index & 0x07))))
+        {
+            eeprom_cache_dirty[index >> 3] |= (1<<(index & 0x07));
+            eeprom_cache_dirty_count++;
+        }
+
+        EECR |= (1<<EERIE);
+    }
+
+    return;
+}
+
+void eeprom_cache_write_word(uint16_t* address, uint16_t value)
+{
+    eeprom_cache_write_block(&value, address, sizeof(value));
+
+    return;
+}
+
+void eeprom_cache_write_block(const void* data, void* address, uint8_t length)
+{
+    uint8_t count;
+
+    for(count = 0; count < length; count++)
+    {
+        eeprom_cache_write_byte(((uint8_t*) address) + count, ((const uint8_t*) data)[count]);
+    }
+
+    return;
+}
+
+//returns true while changed bytes are waiting to be written (e.g. to wait before powering down)
+bool eeprom_cache_busy(void)
+{
+    return (eeprom_cache_dirty_count > 0);
+}
+
+//stop writing dirty bytes and wait until the EEPROM is ready (before a direct access to the EEPROM)
+void eeprom_cache_pause(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        EECR &= ~(1<<EERIE);
+    }
+
+    eeprom_busy_wait();
+
+    return;
+}
+
+//go on writing the dirty bytes (after a direct access)
+void eeprom_cache_resume(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(eeprom_cache_dirty_count > 0)
+        {
+            EECR |= (1<<EERIE);
+        }
+    }
+
+    return;
+}
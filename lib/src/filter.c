@@ -0,0 +1,116 @@
+#include <stdint.h>
+
+#include "filter.h"
+
+//filter functions
+void filter_init(filter_t* filter, uint8_t type, uint8_t iir_shift)
+{
+    filter->type = type;
+    filter->iir_shift = iir_shift;
+    filter_reset(filter);
+
+    return;
+}
+
+//forget all previous values (e.g. after a range switch)
+void filter_reset(filter_t* filter)
+{
+    filter->count = 0;
+    filter->index = 0;
+    filter->state = 0;
+
+    return;
+}
+
+//add a new value to the filter and return the filtered value
+int32_t filter_update(filter_t* filter, int32_t value)
+{
+    int32_t sorted[FILTER_MEDIAN_LENGTH];
+    int32_t temp;
+    uint8_t count;
+    uint8_t pos;
+    uint8_t i;
+    uint8_t j;
+
+    switch(filter->type)
+    {
+        case FILTER_MOVING_AVERAGE:
+        {
+            //remove the oldest value from the sum once the history is full
+            if(filter->count == FILTER_AVERAGE_LENGTH)
+            {
+                filter->state -= filter->history[filter->index];
+            }
+
+            else
+            {
+                filter->count++;
+            }
+
+            filter->history[filter->index] = value;
+            filter->state += value;
+            filter->index = (filter->index + 1) & (FILTER_AVERAGE_LENGTH - 1);
+
+            //the divide is a shift once the history is full
+            if(filter->count == FILTER_AVERAGE_LENGTH)
+            {
+                return (filter->state / FILTER_AVERAGE_LENGTH);
+            }
+
+            return (filter->state / filter->count);
+        }
+
+        case FILTER_IIR:
+        {
+            //start from the first value instead of 0
+            if(filter->count == 0)
+            {
+                filter->state = value * 256;
+                filter->count = 1;
+            }
+
+            else
+            {
+                filter->state += ((value * 256) - filter->state) >> filter->iir_shift;
+            }
+
+            //round to the nearest integer
+            return ((filter->state + 128) >> 8);
+        }
+
+        case FILTER_MEDIAN:
+        {
+            filter->history[filter->index] = value;
+            filter->index = (filter->index + 1) % FILTER_MEDIAN_LENGTH;
+
+            if(filter->count < FILTER_MEDIAN_LENGTH)
+            {
+                filter->count++;
+            }
+
+            //insertion sort of the (at most 5) values in the history
+            count = filter->count;
+
+            for(i = 0; i < count; i++)
+            {
+                temp = filter->history[i];
+                pos = i;
+
+                for(j = i; j > 0 && sorted[j-1] > temp; j--)
+                {
+                    sorted[j] = sorted[j-1];
+                    pos = j - 1;
+                }
+
+                sorted[pos] = temp;
+            }
+
+            return (sorted[count/2]);
+        }
+
+        default:
+        {
+            return (value);
+        }
+    }
+}
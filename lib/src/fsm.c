@@ -0,0 +1,115 @@
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <stddef.h>
+
+#include "fsm.h"
+
+#define FSM_QUEUE_MASK (FSM_QUEUE_SIZE - 1)
+
+//fsm functions
+//set up a state machine with its PROGMEM tables and run the entry action of the first state
+void fsm_init(fsm_t* fsm, const fsm_transition_t* transitions, const fsm_state_t* states, uint8_t num_events, uint8_t state)
+{
+    fsm_state_t actions;
+
+    fsm->transitions = transitions;
+    fsm->states = states;
+    fsm->num_events = num_events;
+    fsm->state = state;
+    fsm->head = 0;
+    fsm->tail = 0;
+    fsm->lost = 0;
+
+    memcpy_P(&actions, &states[state], sizeof(actions));
+
+    if(actions.entry != NULL)
+    {
+        actions.entry();
+    }
+
+    return;
+}
+
+//add an event to the queue (from ISRs or tasks)
+//returns false (and counts the event as lost) if the queue is full
+bool fsm_post(fsm_t* fsm, uint8_t event)
+{
+    bool posted = false;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        uint8_t head = fsm->head;
+
+        if(((head + 1) & FSM_QUEUE_MASK) != fsm->tail)
+        {
+            fsm->queue[head] = event;
+            fsm->head = (head + 1) & FSM_QUEUE_MASK;
+            posted = true;
+        }
+
+        else
+        {
+            fsm->lost++;
+        }
+    }
+
+    return (posted);
+}
+
+//dispatch the queued events in order (called from one task only)
+//actions may post further events, they are dispatched before fsm_run() returns
+void fsm_run(fsm_t* fsm)
+{
+    fsm_transition_t transition;
+    fsm_state_t actions;
+    uint8_t tail;
+
+    while((tail = fsm->tail) != fsm->head)
+    {
+        uint8_t event = fsm->queue[tail];
+
+        fsm->tail = (tail + 1) & FSM_QUEUE_MASK;
+
+        memcpy_P(&transition, &fsm->transitions[fsm->state * fsm->num_events + event], sizeof(transition));
+
+        //the event is ignored in this state
+        if(transition.next_state == 0)
+        {
+            continue;
+        }
+
+        //a transition to the same state only runs its action
+        if(transition.next_state - 1 == fsm->state)
+        {
+            if(transition.action != NULL)
+            {
+                transition.action();
+            }
+
+            continue;
+        }
+
+        memcpy_P(&actions, &fsm->states[fsm->state], sizeof(actions));
+
+        if(actions.exit != NULL)
+        {
+            actions.exit();
+        }
+
+        if(transition.action != NULL)
+        {
+            transition.action();
+        }
+
+        fsm->state = transition.next_state - 1;
+
+        memcpy_P(&actions, &fsm->states[fsm->state], sizeof(actions));
+
+        if(actions.entry != NULL)
+        {
+            actions.entry();
+        }
+    }
+
+    return;
+}
@@ -0,0 +1,59 @@
+#include <stdint.h>
+
+#include "goertzel.h"
+#include "isqrt.h"
+
+//multiply a 32 bit value by a Q14 coefficient
+//the value is split in two 16 bit halves, so only 16x16 bit multiplications are needed (MUL based on the atmega328p)
+//the result is the same as (coeff * value) >> 14 with a 48 bit product
+static int32_t goertzel_mul_q14(int16_t coeff, int32_t value)
+{
+    int16_t high = (int16_t) (value >> 16);
+    uint16_t low = (uint16_t) value;
+
+    return ((((int32_t) coeff) * high) * 4) + ((((int32_t) coeff) * low) >> 14);
+}
+
+//goertzel functions
+//set up the filter with the coefficient of its bin (GOERTZEL_COEFF(), e.g. read from a PROGMEM table)
+void goertzel_init(goertzel_t* goertzel, int16_t coeff)
+{
+    goertzel->coeff = coeff;
+    goertzel_reset(goertzel);
+
+    return;
+}
+
+//start a new block
+void goertzel_reset(goertzel_t* goertzel)
+{
+    goertzel->s1 = 0;
+    goertzel->s2 = 0;
+
+    return;
+}
+
+//add one sample to the block, s0 = x + coeff*s1 - s2
+//estimated cost on the atmega328p is about 90 cycles including the call
+//(two 16x16 bit multiplications, a 32 bit shift and the loads and stores of the state)
+void goertzel_update(goertzel_t* goertzel, int16_t sample)
+{
+    int32_t s0 = sample + goertzel_mul_q14(goertzel->coeff, goertzel->s1) - goertzel->s2;
+
+    goertzel->s2 = goertzel->s1;
+    goertzel->s1 = s0;
+
+    return;
+}
+
+//magnitude of the bin at the end of a block, sqrt(s1^2 + s2^2 - coeff*s1*s2)
+//a sine of amplitude A centred on the bin gives A * block_size / 2
+//uses 64 bit arithmetic (a few thousand cycles), call it once per block and not from an ISR
+uint32_t goertzel_magnitude(const goertzel_t* goertzel)
+{
+    int64_t s1 = goertzel->s1;
+    int64_t s2 = goertzel->s2;
+    int64_t power = (s1 * s1) + (s2 * s2) - (((s1 * s2) * goertzel->coeff) >> 14);
+
+    return (isqrt64((power > 0) ? power : 0));
+}
@@ -0,0 +1,35 @@
+#include <stdint.h>
+
+#include "isqrt.h"
+
+//integer square root, one result bit per iteration (no multiplication or division)
+//takes at most 32 iterations, so it should not be called from an ISR
+uint32_t isqrt64(uint64_t value)
+{
+    uint64_t root = 0;
+    uint64_t bit = ((uint64_t) 1) << 62;
+
+    //start with the highest power of 4 that is not larger than the value
+    while(bit > value)
+    {
+        bit >>= 2;
+    }
+
+    while(bit != 0)
+    {
+        if(value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+
+        else
+        {
+            root >>= 1;
+        }
+
+        bit >>= 2;
+    }
+
+    return (root);
+}
@@ -3,6 +3,7 @@
 #include <stdio.h>
 
 #include "lcd.h"
+#include "hal.h"
 
 //PB1 = RS, PB2 = RW, PB3 = EN, PORTD = data
 #define CONTROL_PORT PORTC
@@ -20,23 +21,23 @@
 //lcd functions
 void lcd_ready()
 {
-    DATA_PORT &= ~(1<<BUSY); //set PD7 to 0, if it was set to 1 earlier
+    hal_clear_bits(&DATA_PORT, (1<<BUSY)); //set PD7 to 0, if it was set to 1 earlier
     // if PD7 was set to 1 earlier and it is not set to 0 before configuring it as an input,
     // its value will always be read as 1
-    DATA_PORT &= ~(1<<BUSY); //set PD7 as input
-    CONTROL_PORT &= ~(1<<RS); //RS = 0
-    CONTROL_PORT |= (1<<RW); //RW = 1
+    hal_clear_bits(&DATA_PORT, (1<<BUSY)); //set PD7 as input
+    hal_clear_bits(&CONTROL_PORT, (1<<RS)); //RS = 0
+    hal_set_bits(&CONTROL_PORT, (1<<RW)); //RW = 1
 
     //perform busy wait
     while((BUSY_INPUT & (1<<BUSY)) == (1<<BUSY))
     {
-        CONTROL_PORT &= ~(1<<EN); //EN = 0
+        hal_clear_bits(&CONTROL_PORT, (1<<EN)); //EN = 0
         delayus(ENABLE_DURATION);
-        CONTROL_PORT |= (1<<EN); //EN = 1
+        hal_set_bits(&CONTROL_PORT, (1<<EN)); //EN = 1
     }
 
-    DATA_PORT_CONFIG |= (1<<BUSY); //make PD7 output again
-    CONTROL_PORT &= ~(1<<EN); //EN = 0
+    hal_set_bits(&DATA_PORT_CONFIG, (1<<BUSY)); //make PD7 output again
+    hal_clear_bits(&CONTROL_PORT, (1<<EN)); //EN = 0
 
     return;
 }
@@ -44,11 +45,11 @@ void lcd_ready()
 void lcd_cmd(unsigned char cmd)
 {
     lcd_ready();
-    DATA_PORT = cmd; //send cmd to data port
-    CONTROL_PORT &= ~((1<<RS) | (1<<RW)); //RS = 0, RW = 0
-    CONTROL_PORT |= (1<<EN); //EN = 1
+    hal_write(&DATA_PORT, cmd); //send cmd to data port
+    hal_clear_bits(&CONTROL_PORT, ((1<<RS) | (1<<RW))); //RS = 0, RW = 0
+    hal_set_bits(&CONTROL_PORT, (1<<EN)); //EN = 1
     delayus(ENABLE_DURATION);
-    CONTROL_PORT &= ~(1<<EN); //EN = 0
+    hal_clear_bits(&CONTROL_PORT, (1<<EN)); //EN = 0
 
     return;
 }
@@ -56,22 +57,22 @@ void lcd_cmd(unsigned char cmd)
 void lcd_data(unsigned char data)
 {
     lcd_ready();
-    DATA_PORT = data; //send data to data port
-    CONTROL_PORT &= ~(1<<RW); //RW = 0
-    CONTROL_PORT |= (1<<RS); //RS = 1
-    CONTROL_PORT |= (1<<EN); //EN = 1
+    hal_write(&DATA_PORT, data); //send data to data port
+    hal_clear_bits(&CONTROL_PORT, (1<<RW)); //RW = 0
+    hal_set_bits(&CONTROL_PORT, (1<<RS)); //RS = 1
+    hal_set_bits(&CONTROL_PORT, (1<<EN)); //EN = 1
     delayus(ENABLE_DURATION);
-    CONTROL_PORT &= ~(1<<EN); //EN =0
+    hal_clear_bits(&CONTROL_PORT, (1<<EN)); //EN =0
 
     return;
 }
 
 void lcd_init(void)
 {
-    CONTROL_PORT_CONFIG |= ((1<<RS) | (1<<RW) | (1<<EN));
-    PORTB &= ~((1<<RS) | (1<<RW) | (1<<EN));
-    DATA_PORT_CONFIG |= 0xFF;
-    DATA_PORT = 0x00;
+    hal_set_bits(&CONTROL_PORT_CONFIG, ((1<<RS) | (1<<RW) | (1<<EN)));
+    hal_clear_bits(&PORTB, ((1<<RS) | (1<<RW) | (1<<EN)));
+    hal_set_bits(&DATA_PORT_CONFIG, 0xFF);
+    hal_write(&DATA_PORT, 0x00);
 
     lcd_cmd(0x38); //2 lines 5x7 matrix for each character
     lcd_cmd(0x01); //clear display
@@ -126,7 +127,8 @@ void lcd_print_string(const char* ptr, uint8_t num_chars, char loc)
             lcd_data(*(ptr+count));
 
             loc++;
-            if(loc >= 0x90 && loc < 0xC0)
+            //(loc is a char, compared as the unsigned ddram address)
+            if((uint8_t) loc >= 0x90 && (uint8_t) loc < 0xC0)
             {
                 lcd_cmd(0xC0);
                 loc = 0xC0;
@@ -207,7 +209,7 @@ void lcd_print_num(uint16_t val, uint8_t num_digits, char loc)
     }*/
 
     char array[num_digits + 1];
-    sprintf(array, "%d", val);
+    sprintf(array, "%u", val);
     lcd_print_string(array, num_digits, loc);
 
     return;
@@ -227,3 +229,20 @@ void lcd_clear_segment(uint8_t num_segments, char loc)
     return;
 }
 
+//define one of the 8 custom characters (CGRAM) with a 5x8 pattern (one byte per row, top row first, bit 4 is the left column)
+//custom characters are displayed with the codes 0 to 7 (or 8 to 15, which can also be used in strings)
+//the cursor location has to be set again before printing
+void lcd_create_char(uint8_t code, const uint8_t* pattern)
+{
+    uint8_t count = 0;
+
+    lcd_cmd(0x40 | ((code & 0x07) << 3)); //set CGRAM address of the character
+
+    for(count = 0; count < 8; count++)
+    {
+        lcd_data(pattern[count]);
+    }
+
+    return;
+}
+
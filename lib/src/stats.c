@@ -0,0 +1,89 @@
+#include <stdint.h>
+
+#include "stats.h"
+#include "isqrt.h"
+
+//statistics functions
+//start a new set of values
+void stats_reset(stats_t* stats)
+{
+    stats->count = 0;
+    stats->min = 0;
+    stats->max = 0;
+    stats->mean = 0;
+    stats->remainder = 0;
+    stats->m2 = 0;
+
+    return;
+}
+
+//add a value, O(1) and short enough for every decimated adc block
+void stats_update(stats_t* stats, int32_t value)
+{
+    int32_t delta;
+    int32_t step;
+
+    if(stats->count == 0)
+    {
+        stats->min = value;
+        stats->max = value;
+    }
+
+    else if(value < stats->min)
+    {
+        stats->min = value;
+    }
+
+    else if(value > stats->max)
+    {
+        stats->max = value;
+    }
+
+    stats->count++;
+
+    //deviation from the old mean
+    delta = value - stats->mean;
+
+    //mean += delta/count, the part of delta that is not a whole step stays in the remainder
+    step = (stats->remainder + delta) / (int32_t) stats->count;
+    stats->remainder += delta - (step * (int32_t) stats->count);
+    stats->mean += step;
+
+    //m2 += (value - old mean) * (value - new mean), the product is never negative
+    stats->m2 += (uint64_t) ((int64_t) delta * (value - stats->mean));
+
+    return;
+}
+
+//mean rounded to the nearest integer
+int32_t stats_mean(const stats_t* stats)
+{
+    if(stats->count == 0)
+    {
+        return (0);
+    }
+
+    //the remainder lies in +-count
+    if(2 * stats->remainder >= (int32_t) stats->count)
+    {
+        return (stats->mean + 1);
+    }
+
+    if(-2 * stats->remainder > (int32_t) stats->count)
+    {
+        return (stats->mean - 1);
+    }
+
+    return (stats->mean);
+}
+
+//sample standard deviation, takes a few thousand cycles (64 bit division and square root)
+uint32_t stats_deviation(const stats_t* stats)
+{
+    if(stats->count < 2)
+    {
+        return (0);
+    }
+
+    return (isqrt64(stats->m2 / (stats->count - 1)));
+}
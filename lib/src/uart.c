@@ -0,0 +1,271 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#include "uart.h"
+#include "hal.h"
+
+//the atmega328p has one usart with the registers numbered 0, the atmega8 usart registers have no number
+#ifdef UCSR0A
+#define UART_UCSRA UCSR0A
+#define UART_UCSRB UCSR0B
+#define UART_UBRRH UBRR0H
+#define UART_UBRRL UBRR0L
+#define UART_UDR UDR0
+#define UART_U2X U2X0
+#define UART_TXC TXC0
+#define UART_UDRIE UDRIE0
+#define UART_RXCIE RXCIE0
+#define UART_TXEN TXEN0
+#define UART_RXEN RXEN0
+#else
+#define UART_UCSRA UCSRA
+#define UART_UCSRB UCSRB
+#define UART_UBRRH UBRRH
+#define UART_UBRRL UBRRL
+#define UART_UDR UDR
+#define UART_U2X U2X
+#define UART_TXC TXC
+#define UART_UDRIE UDRIE
+#define UART_RXCIE RXCIE
+#define UART_TXEN TXEN
+#define UART_RXEN RXEN
+#endif
+
+//receive complete vector (USART_RX_vect on the atmega328p, USART_RXC_vect on the atmega8)
+#ifdef USART_RX_vect
+#define UART_RX_VECT USART_RX_vect
+#else
+#define UART_RX_VECT USART_RXC_vect
+#endif
+
+#define UART_TX_MASK (UART_TX_BUFFER_SIZE - 1)
+
+//transmit ring buffer, filled by the uart functions and emptied by the data register empty ISR
+//one entry is kept free to tell a full buffer from an empty one
+static volatile uint8_t uart_tx_buffer[UART_TX_BUFFER_SIZE];
+static volatile uint8_t uart_tx_head = 0;
+static volatile uint8_t uart_tx_tail = 0;
+//a byte has been loaded since the transmitter was enabled (TXC is only set after a byte)
+static volatile uint8_t uart_tx_used = 0;
+
+//receive frame buffer, filled by the receive complete ISR until the zero byte that ends a frame
+//the frame is then kept until it is read with uart_read_frame(), frames arriving meanwhile are dropped
+static volatile uint8_t uart_rx_buffer[UART_RX_FRAME_SIZE];
+static volatile uint8_t uart_rx_length = 0;
+static volatile uint8_t uart_rx_ready = 0;
+//bytes are dropped up to the end of the current frame (no space or frame too long)
+static volatile uint8_t uart_rx_skip = 0;
+
+//receive complete vector, collects the bytes of a frame (a few cycles per byte)
+ISR(UART_RX_VECT)
+{
+    uint8_t data = UART_UDR;
+
+    if(uart_rx_ready || uart_rx_skip)
+    {
+        uart_rx_skip = (data != 0);
+
+        return;
+    }
+
+    if(data == 0)
+    {
+        //end of the frame (empty frames are ignored)
+        uart_rx_ready = (uart_rx_length > 0);
+
+        return;
+    }
+
+    if(uart_rx_length < UART_RX_FRAME_SIZE)
+    {
+        uart_rx_buffer[uart_rx_length++] = data;
+    }
+
+    else
+    {
+        uart_rx_length = 0;
+        uart_rx_skip = 1;
+    }
+
+    return;
+}
+
+//data register empty vector, sends the next byte of the ring buffer
+//the interrupt is disabled once the buffer is empty (it is enabled again by the next byte)
+ISR(USART_UDRE_vect)
+{
+    uint8_t tail = uart_tx_tail;
+
+    hal_write(&UART_UDR, uart_tx_buffer[tail]);
+    //clear the transmit complete flag, it is set again once this byte has been shifted out
+    //(the error flags in the same register are written as zero)
+    hal_write_flags(&UART_UCSRA, (UART_UCSRA & (1<<UART_U2X)) | (1<<UART_TXC), (1<<UART_TXC));
+    uart_tx_used = 1;
+    tail = (tail + 1) & UART_TX_MASK;
+    uart_tx_tail = tail;
+
+    if(tail == uart_tx_head)
+    {
+        UART_UCSRB &= ~(1<<UART_UDRIE);
+    }
+
+    return;
+}
+
+//uart functions
+//frame format is 8N1 (reset value of the frame format register)
+void uart_init(uint16_t ubrr)
+{
+    UART_UBRRH = (uint8_t) (ubrr >> 8);
+    UART_UBRRL = (uint8_t) ubrr;
+    //double speed mode
+    UART_UCSRA |= (1<<UART_U2X);
+    //enable transmitter
+    UART_UCSRB |= (1<<UART_TXEN);
+
+    return;
+}
+
+//wait until the ring buffer is empty and the last byte has been shifted out, then switch the transmitter
+//and the receiver off, the pins are normal io pins again (e.g. when switches share them)
+//interrupts have to be enabled, uart_init() switches the transmitter on again
+void uart_disable(void)
+{
+    while(uart_tx_head != uart_tx_tail)
+    {
+        HAL_IDLE();
+    }
+
+    if(uart_tx_used)
+    {
+        loop_until_bit_is_set(UART_UCSRA, UART_TXC);
+    }
+
+    UART_UCSRB &= ~((1<<UART_TXEN) | (1<<UART_RXEN) | (1<<UART_RXCIE));
+    uart_tx_used = 0;
+
+    return;
+}
+
+//the ring buffer is empty and the last byte has been shifted out (never waits)
+//uart_disable() returns at once when this is true, e.g. to switch the transmitter off from a later task pass
+bool uart_tx_idle(void)
+{
+    return ((uart_tx_head == uart_tx_tail) && (!uart_tx_used || bit_is_set(UART_UCSRA, UART_TXC)));
+}
+
+//number of bytes that can be added to the ring buffer
+uint8_t uart_tx_free(void)
+{
+    return ((uart_tx_tail - uart_tx_head - 1) & UART_TX_MASK);
+}
+
+//enable the data register empty interrupt
+//(atomic, the ISR clears the enable bit in the same register when the buffer runs empty)
+static void uart_tx_start(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        UART_UCSRB |= (1<<UART_UDRIE);
+    }
+
+    return;
+}
+
+//add one byte to the ring buffer (the caller has checked that there is space)
+static void uart_tx_add(uint8_t data)
+{
+    uint8_t head = uart_tx_head;
+
+    uart_tx_buffer[head] = data;
+    uart_tx_head = (head + 1) & UART_TX_MASK;
+
+    return;
+}
+
+//send one byte, waits while the ring buffer is full
+//interrupts have to be enabled (the ISR makes space)
+void uart_putc(uint8_t data)
+{
+    while(uart_tx_free() == 0)
+    {
+        HAL_IDLE();
+    }
+
+    uart_tx_add(data);
+    uart_tx_start();
+
+    return;
+}
+
+//send a block of bytes, waits whenever the ring buffer is full (used for large frames)
+void uart_write(const uint8_t* data, uint16_t length)
+{
+    for(; length > 0; length--)
+    {
+        uart_putc(*data++);
+    }
+
+    return;
+}
+
+//send a block of bytes if the ring buffer has space for all of them, never waits
+//returns false (and sends nothing) if the block does not fit
+bool uart_try_write(const uint8_t* data, uint8_t length)
+{
+    if(uart_tx_free() < length)
+    {
+        return (false);
+    }
+
+    for(; length > 0; length--)
+    {
+        uart_tx_add(*data++);
+    }
+
+    uart_tx_start();
+
+    return (true);
+}
+
+//enable the receiver and the receive complete interrupt
+void uart_rx_enable(void)
+{
+    UART_UCSRB |= ((1<<UART_RXEN) | (1<<UART_RXCIE));
+
+    return;
+}
+
+//copy a received frame (without the zero byte) to frame (UART_RX_FRAME_SIZE bytes)
+//returns the length of the frame or 0 if no complete frame has been received
+uint8_t uart_read_frame(uint8_t* frame)
+{
+    uint8_t length;
+    uint8_t count;
+
+    if(!uart_rx_ready)
+    {
+        return (0);
+    }
+
+    length = uart_rx_length;
+
+    for(count = 0; count < length; count++)
+    {
+        frame[count] = uart_rx_buffer[count];
+    }
+
+    //the ISR does not touch the buffer until uart_rx_ready is cleared
+    uart_rx_length = 0;
+    uart_rx_ready = 0;
+
+    return (length);
+}
+
+//a frame is being received (bytes since the last zero byte, not yet a complete frame)
+//e.g. to avoid a sleep mode that halts clkIO, the usart would lose the rest of the frame
+bool uart_rx_busy(void)
+{
+    return (((uart_rx_length > 0) && !uart_rx_ready) || uart_rx_skip);
+}
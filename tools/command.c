@@ -0,0 +1,98 @@
+/* Remote command sender (host tool)
+Sends one command to lab2 over the serial port, the response is printed by tools/telemetry.c reading the same port.
+
+build :- gcc -I../lib/headers -o command command.c ../lib/src/cobs.c (the cobs functions of the firmware)
+usage :- command output command [argument]
+output is the serial port or pseudo terminal (see tools/telemetry.c), command and argument are numbers (e.g. 0x10 4)
+
+commands :-
+0x10 set mode (argument is the app state, 0 frequency ... 8 tone)
+0x11 set range (argument is the range of the current mode, turns autoranging off)
+0x12 autoranging (argument 0 off, 1 on)
+0x13 set display rate (argument 0 2Hz, 1 5Hz, 2 10Hz)
+0x14 trigger (new reading, new capture in scope and logic mode)
+0x15 query (data is the last telemetry frame without type and crc)
+0x16 profiler (data is the adc isr ticks, the maximum, the adc block overruns and the dropped telemetry frames, argument 1 resets the maximum)
+0x17 statistics (data is the view, count, min, max, mean and standard deviation)
+0x18 log (argument is the log interval in s, 0 stops logging)
+0x19 log dump (the log is sent before the response, tools/log2csv.c converts it)
+0x1A range switches (argument is the first counter, data is up to 10 counters of 16 bit, the counters are the 5.0V and 1.1V
+     reference, the reference resistors, the frequency prescalers and the capacitance ranges)
+0x1B scope trigger edge (argument 0 rising, 1 falling)
+
+frame format :-
+command (8 bit), sequence number (8 bit), argument (8 bit, optional), crc8 of the bytes before (polynomial 0x07, initial value 0),
+cobs encoded and followed by a zero byte
+the status of a response is 0 (ok), 1 (unknown command) or 2 (invalid argument)
+*/
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "cobs.h"
+
+
+uint8_t crc8_update(uint8_t crc, uint8_t data)
+{
+    uint8_t count;
+
+    crc ^= data;
+
+    for(count = 0; count < 8; count++)
+    {
+        crc = (crc & 0x80) ? ((crc << 1) ^ 0x07) : (crc << 1);
+    }
+
+    return (crc);
+}
+
+int main(int argc, char* argv[])
+{
+    FILE* output;
+    uint8_t frame[4];
+    uint8_t encoded[6];
+    int length = 0;
+    int encoded_length;
+    uint8_t crc = 0;
+    int count;
+
+    if(argc < 3)
+    {
+        fprintf(stderr, "usage :- %s output command [argument]\n", argv[0]);
+        return (1);
+    }
+
+    if((output = fopen(argv[1], "wb")) == NULL)
+    {
+        perror(argv[1]);
+        return (1);
+    }
+
+    frame[length++] = strtoul(argv[2], NULL, 0);
+    //the sequence number matches a response to its request
+    frame[length++] = time(NULL);
+
+    if(argc > 3)
+    {
+        frame[length++] = strtoul(argv[3], NULL, 0);
+    }
+
+    for(count = 0; count < length; count++)
+    {
+        crc = crc8_update(crc, frame[count]);
+    }
+
+    frame[length++] = crc;
+
+    encoded_length = cobs_encode(frame, length, encoded);
+    encoded[encoded_length++] = 0;
+    fwrite(encoded, 1, encoded_length, output);
+    fclose(output);
+
+    printf("sequence %u\n", frame[1]);
+
+    return (0);
+}
@@ -0,0 +1,200 @@
+/* Measurement log to CSV converter (host tool)
+Converts the measurement log sent by lab2 over the serial port (remote command 0x19, see tools/command.c) into csv lines.
+
+build :- gcc -o log2csv log2csv.c
+usage :- log2csv [input [output]]
+input is a file with the raw bytes received from the serial port (default stdin), the first log in it is converted
+output is the csv file (default stdout), one line per reading :- page sequence number, time since power up (s), mode, unit, value
+
+frame format (little endian) :-
+sync byte 0xA7, number of pages (8 bit), page size (8 bit), then the pages
+page :- sequence number (16 bit), time of the first entry in ms since power up (32 bit), log interval in s (8 bit),
+mode (8 bit), crc8 of the header bytes before (polynomial 0x07, initial value 0), then the entries
+entry :- zigzag encoded difference to the previous reading (0x00 to 0xFD) or 0xFE followed by the reading (32 bit, signed),
+0xFF ends the page
+pages without a valid header are skipped, the pages are printed from the oldest to the newest
+(the time restarts at 0 after every power up of the meter, the sequence number does not)
+*/
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+#define LOG_FRAME_SYNC 0xA7
+#define LOG_HEADER_SIZE 9
+#define LOG_ESCAPE 0xFE
+#define LOG_ERASED 0xFF
+
+
+//names of the modes (app states of lab2) and the units of their readings
+const char* mode_names[] = {"frequency", "voltage", "resistance", "capacitance"};
+const char* units[] = {"Hz", "uV", "ohm", "pF"};
+
+
+uint8_t crc8_update(uint8_t crc, uint8_t data)
+{
+    uint8_t count;
+
+    crc ^= data;
+
+    for(count = 0; count < 8; count++)
+    {
+        crc = (crc & 0x80) ? ((crc << 1) ^ 0x07) : (crc << 1);
+    }
+
+    return (crc);
+}
+
+uint32_t get_le(const uint8_t* data, uint8_t num_bytes)
+{
+    uint32_t value = 0;
+
+    while(num_bytes-- > 0)
+    {
+        value = (value << 8) | data[num_bytes];
+    }
+
+    return (value);
+}
+
+//returns 1 if the page starts with a valid header
+int page_valid(const uint8_t* page)
+{
+    uint8_t crc = 0;
+    int count;
+
+    for(count = 0; count < LOG_HEADER_SIZE - 1; count++)
+    {
+        crc = crc8_update(crc, page[count]);
+    }
+
+    return (crc == page[LOG_HEADER_SIZE - 1] && page[6] != 0);
+}
+
+//print the readings of a page
+void print_page(FILE* output, const uint8_t* page, int page_size)
+{
+    uint16_t sequence = get_le(&page[0], 2);
+    uint32_t time_ms = get_le(&page[2], 4);
+    uint32_t interval_ms = page[6] * 1000UL;
+    uint8_t mode = page[7];
+    int32_t value = 0;
+    int index = LOG_HEADER_SIZE;
+    int entry;
+
+    for(entry = 0; index < page_size; entry++)
+    {
+        if(page[index] == LOG_ERASED)
+        {
+            break;
+        }
+
+        else if(page[index] == LOG_ESCAPE)
+        {
+            if(index + 5 > page_size)
+            {
+                break;
+            }
+
+            value = (int32_t) get_le(&page[index + 1], 4);
+            index += 5;
+        }
+
+        else
+        {
+            //zigzag decoding
+            uint8_t code = page[index++];
+
+            value += (code & 1) ? -(int32_t) ((code + 1) >> 1) : (int32_t) (code >> 1);
+        }
+
+        fprintf(output, "%u,%.3f,%s,%s,%d\n", sequence, (time_ms + entry * interval_ms) / 1000.0,
+            (mode < sizeof(mode_names)/sizeof(mode_names[0])) ? mode_names[mode] : "?",
+            (mode < sizeof(units)/sizeof(units[0])) ? units[mode] : "?", value);
+    }
+
+    return;
+}
+
+int main(int argc, char* argv[])
+{
+    FILE* input = stdin;
+    FILE* output = stdout;
+    uint8_t* pages;
+    int num_pages;
+    int page_size;
+    int newest = -1;
+    int page;
+    int byte;
+
+    if(argc > 1 && (input = fopen(argv[1], "rb")) == NULL)
+    {
+        perror(argv[1]);
+        return (1);
+    }
+
+    if(argc > 2 && (output = fopen(argv[2], "w")) == NULL)
+    {
+        perror(argv[2]);
+        return (1);
+    }
+
+    //skip everything before the sync byte
+    while((byte = fgetc(input)) != EOF && byte != LOG_FRAME_SYNC);
+
+    num_pages = fgetc(input);
+    page_size = fgetc(input);
+
+    if(byte == EOF || num_pages == EOF || page_size == EOF || page_size <= LOG_HEADER_SIZE)
+    {
+        fprintf(stderr, "no log found\n");
+        return (1);
+    }
+
+    pages = malloc(num_pages * page_size);
+
+    if(pages == NULL || fread(pages, page_size, num_pages, input) != (size_t) num_pages)
+    {
+        fprintf(stderr, "log is incomplete\n");
+        return (1);
+    }
+
+    //the newest page has the highest sequence number (compared as differences, they wrap around)
+    for(page = 0; page < num_pages; page++)
+    {
+        if(page_valid(&pages[page * page_size]) && (newest < 0 ||
+            (int16_t) (get_le(&pages[page * page_size], 2) - get_le(&pages[newest * page_size], 2)) > 0))
+        {
+            newest = page;
+        }
+    }
+
+    fprintf(output, "sequence,time_s,mode,unit,value\n");
+
+    //the pages are written in turn, the oldest page follows the newest
+    for(page = 1; newest >= 0 && page <= num_pages; page++)
+    {
+        const uint8_t* data = &pages[((newest + page) % num_pages) * page_size];
+
+        if(page_valid(data))
+        {
+            print_page(output, data, page_size);
+        }
+    }
+
+    free(pages);
+
+    if(input != stdin)
+    {
+        fclose(input);
+    }
+
+    if(output != stdout)
+    {
+        fclose(output);
+    }
+
+    return (0);
+}
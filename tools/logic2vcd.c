@@ -0,0 +1,138 @@
+/* Logic analyzer capture to VCD converter (host tool)
+Converts a capture sent by the logic analyzer mode of lab2 over the serial port into a vcd file
+that can be opened in a waveform viewer (e.g. GTKWave).
+
+build :- gcc -o logic2vcd logic2vcd.c
+usage :- logic2vcd [input [output]]
+input is a file with the raw bytes received from the serial port (default stdin), the first capture in it is converted
+output is the vcd file (default stdout)
+
+frame format (little endian) :-
+sync byte 0xA6, number of data bytes (16 bit), number of edges (16 bit), initial level (8 bit), timer clock in Hz (32 bit)
+data :- one varint per edge, time since the previous edge (or the start of the capture) in timer counts,
+7 bits per byte, least significant group first, bit 7 set if more bytes follow
+*/
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+#define LOGIC_FRAME_SYNC 0xA6
+//largest frame the device can send
+#define MAX_DATA_LENGTH 4096
+
+
+//read a little endian value of num_bytes bytes
+int read_le(FILE* input, uint32_t* value, uint8_t num_bytes)
+{
+    int data;
+    uint8_t count;
+
+    *value = 0;
+
+    for(count = 0; count < num_bytes; count++)
+    {
+        data = fgetc(input);
+
+        if(data == EOF)
+        {
+            return (0);
+        }
+
+        *value |= ((uint32_t) data) << (8*count);
+    }
+
+    return (1);
+}
+
+int main(int argc, char* argv[])
+{
+    FILE* input = stdin;
+    FILE* output = stdout;
+    uint8_t data[MAX_DATA_LENGTH];
+    uint32_t length;
+    uint32_t edges;
+    uint32_t level;
+    uint32_t clock;
+    uint32_t index;
+    uint32_t edge;
+    uint64_t time = 0;
+    int byte;
+
+    if(argc > 1 && (input = fopen(argv[1], "rb")) == NULL)
+    {
+        perror(argv[1]);
+        return (1);
+    }
+
+    if(argc > 2 && (output = fopen(argv[2], "w")) == NULL)
+    {
+        perror(argv[2]);
+        return (1);
+    }
+
+    //skip everything before the first frame
+    do
+    {
+        byte = fgetc(input);
+    } while(byte != EOF && byte != LOGIC_FRAME_SYNC);
+
+    if(byte == EOF || !read_le(input, &length, 2) || !read_le(input, &edges, 2) || !read_le(input, &level, 1) || !read_le(input, &clock, 4))
+    {
+        fprintf(stderr, "no capture found\n");
+        return (1);
+    }
+
+    if(length > MAX_DATA_LENGTH || clock == 0 || fread(data, 1, length, input) != length)
+    {
+        fprintf(stderr, "incomplete or invalid capture\n");
+        return (1);
+    }
+
+    //vcd header, times are in ns
+    fprintf(output, "$timescale 1ns $end\n");
+    fprintf(output, "$scope module lab2 $end\n");
+    fprintf(output, "$var wire 1 ! probe $end\n");
+    fprintf(output, "$upscope $end\n");
+    fprintf(output, "$enddefinitions $end\n");
+    fprintf(output, "#0\n%u!\n", level ? 1 : 0);
+
+    index = 0;
+
+    for(edge = 0; edge < edges; edge++)
+    {
+        uint32_t delta = 0;
+        uint8_t shift = 0;
+
+        //decode one varint
+        do
+        {
+            if(index >= length || shift > 28)
+            {
+                fprintf(stderr, "capture ends after %u of %u edges\n", edge, edges);
+                return (1);
+            }
+
+            delta |= ((uint32_t) (data[index] & 0x7F)) << shift;
+            shift += 7;
+        } while(data[index++] & 0x80);
+
+        time += delta;
+        level = !level;
+        fprintf(output, "#%llu\n%u!\n", (unsigned long long) ((time * 1000000000ULL) / clock), level);
+    }
+
+    if(input != stdin)
+    {
+        fclose(input);
+    }
+
+    if(output != stdout)
+    {
+        fclose(output);
+    }
+
+    return (0);
+}
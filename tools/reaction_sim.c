@@ -0,0 +1,177 @@
+/* Reaction time test bench for lab1 (host tool, simavr)
+Runs the lab1 firmware in simavr, presses SW1 and SW2 at scripted times and compares the reaction time
+measured by the firmware with the time between the led turning on and the simulated press of SW2.
+
+build :- gcc -o reaction_sim reaction_sim.c -lsimavr -lelf
+(needs a simavr version with the analog comparator, SW2 is connected to AIN1)
+usage :- reaction_sim firmware address [reaction_us ...]
+firmware is the lab1 elf file (built with avr-gcc -mmcu=atmega8 -DF_CPU=8000000UL)
+address is the address of reaction_us in the elf file, e.g. $(avr-nm firmware | grep reaction_us | cut -d' ' -f1)
+reaction_us are the reaction times to simulate (default 1234 and 250000)
+*/
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_acomp.h>
+
+
+#define F_CPU 8000000UL
+//cycles per us
+#define CYCLES_US (F_CPU/1000000UL)
+//how long a switch is held (longer than the debouncing of SW1)
+#define PRESS_US 200000UL
+//comparator input voltages of SW2 released and pressed (mV)
+#define SW2_RELEASED_MV 5000
+#define SW2_PRESSED_MV 0
+//trials of a session of the firmware (a reaction time up to 400ms is a trial)
+#define SESSION_TRIALS 10
+#define TOO_SLOW_US 400000UL
+
+
+avr_t* avr;
+//cycle at which the led was switched on (0 while it is off)
+avr_cycle_count_t led_on_cycle = 0;
+
+
+//led (PC0) hook
+void led_changed(struct avr_irq_t* irq, uint32_t value, void* param)
+{
+    led_on_cycle = value ? avr->cycle : 0;
+}
+
+//run the simulation for a time (us)
+void run_us(uint32_t us)
+{
+    avr_cycle_count_t end = avr->cycle + ((avr_cycle_count_t) us) * CYCLES_US;
+
+    while(avr->cycle < end)
+    {
+        int state = avr_run(avr);
+
+        if(state == cpu_Done || state == cpu_Crashed)
+        {
+            fprintf(stderr, "simulation stopped\n");
+            exit(1);
+        }
+    }
+}
+
+//press and release SW1 (PC2, active low)
+void press_sw1(void)
+{
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 2), 0);
+    run_us(PRESS_US);
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 2), 1);
+    run_us(PRESS_US);
+}
+
+int main(int argc, char* argv[])
+{
+    elf_firmware_t firmware;
+    uint16_t address;
+    uint32_t default_reactions[] = {1234, 250000};
+    uint32_t* reactions = default_reactions;
+    int num_reactions = sizeof(default_reactions)/sizeof(default_reactions[0]);
+    int count;
+    int errors = 0;
+    int trials = 0;
+
+    if(argc < 3)
+    {
+        fprintf(stderr, "usage :- %s firmware address [reaction_us ...]\n", argv[0]);
+        return (1);
+    }
+
+    memset(&firmware, 0, sizeof(firmware));
+
+    if(elf_read_firmware(argv[1], &firmware) != 0)
+    {
+        fprintf(stderr, "%s: cannot read the firmware\n", argv[1]);
+        return (1);
+    }
+
+    //data space addresses of avr-nm start at 0x800000
+    address = strtoul(argv[2], NULL, 16) & 0xFFFF;
+
+    if(argc > 3)
+    {
+        num_reactions = argc - 3;
+        reactions = malloc(num_reactions * sizeof(uint32_t));
+
+        for(count = 0; count < num_reactions; count++)
+        {
+            reactions[count] = strtoul(argv[count + 3], NULL, 0);
+        }
+    }
+
+    avr = avr_make_mcu_by_name(firmware.mmcu[0] ? firmware.mmcu : "atmega8");
+
+    if(avr == NULL)
+    {
+        fprintf(stderr, "unknown mcu\n");
+        return (1);
+    }
+
+    avr_init(avr);
+    avr_load_firmware(avr, &firmware);
+    avr->frequency = F_CPU;
+
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 0), led_changed, NULL);
+
+    //switches released
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 2), 1);
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ACOMP_GETIRQ, ACOMP_IRQ_AIN1), SW2_RELEASED_MV);
+
+    //power up message
+    run_us(2500000UL);
+
+    for(count = 0; count < num_reactions; count++)
+    {
+        uint32_t measured;
+
+        //ready -> instructions -> wait
+        press_sw1();
+        press_sw1();
+
+        //the led is switched on after the wait (random, 1 to 4s)
+        while(led_on_cycle == 0)
+        {
+            run_us(10);
+        }
+
+        //press SW2 the given time after the led was switched on
+        run_us(reactions[count] - (avr->cycle - led_on_cycle)/CYCLES_US);
+        avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ACOMP_GETIRQ, ACOMP_IRQ_AIN1), SW2_PRESSED_MV);
+        run_us(PRESS_US);
+        avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ACOMP_GETIRQ, ACOMP_IRQ_AIN1), SW2_RELEASED_MV);
+        run_us(PRESS_US);
+
+        measured = avr->data[address] | (avr->data[address + 1] << 8) |
+            ((uint32_t) avr->data[address + 2] << 16) | ((uint32_t) avr->data[address + 3] << 24);
+
+        printf("pressed after %uus, measured %uus, error %dus\n", reactions[count], measured, (int) (measured - reactions[count]));
+
+        if(measured + 5 < reactions[count] || measured > reactions[count] + 5)
+        {
+            errors++;
+        }
+
+        //results -> ready (results -> session -> ready after the last trial of a session)
+        press_sw1();
+
+        if(reactions[count] <= TOO_SLOW_US && ++trials == SESSION_TRIALS)
+        {
+            trials = 0;
+            press_sw1();
+        }
+    }
+
+    return (errors ? 1 : 0);
+}
@@ -0,0 +1,208 @@
+/* Telemetry decoder (host tool)
+Decodes the telemetry frames sent by lab2 over the serial port and prints one reading per line.
+
+build :- gcc -I../lib/headers -o telemetry telemetry.c ../lib/src/cobs.c (the cobs functions of the firmware)
+usage :- telemetry [input]
+input is the serial port, a pseudo terminal or a file with the raw bytes received from the serial port (default stdin)
+e.g. the pseudo terminal created by simavr for the uart (/tmp/simavr-uart0) or a usb serial adapter
+(set the baud rate first, e.g. stty -F /dev/ttyUSB0 250000)
+
+frame format :-
+every frame is cobs encoded and followed by a zero byte, a decoded reading frame has 17 bytes (little endian) :-
+type 0x01 (8 bit), time since power up in ms (32 bit), mode (8 bit), quantity (8 bit), range (8 bit),
+raw value (32 bit), scaled value (32 bit, signed), crc8 of the bytes before (polynomial 0x07, initial value 0)
+a response to a remote command (see tools/command.c) has the type 0x02, the command, the sequence number, the status,
+up to 21 bytes of data and the crc8, it is printed as a line starting with "response" followed by the data in hex
+bytes between the frames that do not decode to a valid frame (e.g. scope or logic captures) are skipped
+*/
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "cobs.h"
+
+
+#define TELEMETRY_READING 0x01
+#define TELEMETRY_RESPONSE 0x02
+#define READING_LENGTH 17
+//longest encoded frame that is collected (cobs_decode() takes up to 255 bytes), longer runs of non zero bytes are skipped
+#define MAX_FRAME_LENGTH 255
+
+
+//names of the modes and quantities (app states of lab2)
+const char* mode_names[] = {"frequency", "voltage", "resistance", "capacitance", "dual", "ac_rms", "scope", "logic", "tone"};
+const char* units[] = {"Hz", "uV", "ohm", "pF"};
+
+
+uint8_t crc8_update(uint8_t crc, uint8_t data)
+{
+    uint8_t count;
+
+    crc ^= data;
+
+    for(count = 0; count < 8; count++)
+    {
+        crc = (crc & 0x80) ? ((crc << 1) ^ 0x07) : (crc << 1);
+    }
+
+    return (crc);
+}
+
+uint32_t get_le(const uint8_t* data, uint8_t num_bytes)
+{
+    uint32_t value = 0;
+
+    while(num_bytes-- > 0)
+    {
+        value = (value << 8) | data[num_bytes];
+    }
+
+    return (value);
+}
+
+//print a decoded frame, returns 0 if it is not a valid reading
+int print_reading(const uint8_t* frame, int length)
+{
+    uint8_t crc = 0;
+    int count;
+    uint8_t mode;
+    uint8_t quantity;
+
+    if(length != READING_LENGTH || frame[0] != TELEMETRY_READING)
+    {
+        return (0);
+    }
+
+    for(count = 0; count < READING_LENGTH - 1; count++)
+    {
+        crc = crc8_update(crc, frame[count]);
+    }
+
+    if(crc != frame[READING_LENGTH - 1])
+    {
+        return (0);
+    }
+
+    mode = frame[5];
+    quantity = frame[6];
+
+    printf("%u\t%s\t%s\t%u\t%u\t%d\n",
+        get_le(&frame[1], 4),
+        (mode < sizeof(mode_names)/sizeof(mode_names[0])) ? mode_names[mode] : "?",
+        (quantity < sizeof(units)/sizeof(units[0])) ? units[quantity] : "?",
+        frame[7],
+        get_le(&frame[8], 4),
+        (int32_t) get_le(&frame[12], 4));
+    fflush(stdout);
+
+    return (1);
+}
+
+//print a decoded response frame, returns 0 if it is not a valid response
+int print_response(const uint8_t* frame, int length)
+{
+    uint8_t crc = 0;
+    int count;
+
+    if(length < 5 || frame[0] != TELEMETRY_RESPONSE)
+    {
+        return (0);
+    }
+
+    for(count = 0; count < length - 1; count++)
+    {
+        crc = crc8_update(crc, frame[count]);
+    }
+
+    if(crc != frame[length - 1])
+    {
+        return (0);
+    }
+
+    printf("response\tcommand 0x%02X\tsequence %u\tstatus %u\t", frame[1], frame[2], frame[3]);
+
+    for(count = 4; count < length - 1; count++)
+    {
+        printf("%02X", frame[count]);
+    }
+
+    printf("\n");
+    fflush(stdout);
+
+    return (1);
+}
+
+int main(int argc, char* argv[])
+{
+    FILE* input = stdin;
+    struct termios settings;
+    uint8_t encoded[MAX_FRAME_LENGTH];
+    uint8_t frame[MAX_FRAME_LENGTH];
+    int length = 0;
+    int overflow = 0;
+    unsigned long bad_frames = 0;
+    int byte;
+
+    if(argc > 1 && (input = fopen(argv[1], "rb")) == NULL)
+    {
+        perror(argv[1]);
+        return (1);
+    }
+
+    //serial ports and pseudo terminals are switched to raw mode (no line editing or character translation)
+    if(isatty(fileno(input)) && tcgetattr(fileno(input), &settings) == 0)
+    {
+        cfmakeraw(&settings);
+        tcsetattr(fileno(input), TCSANOW, &settings);
+    }
+
+    printf("time_ms\tmode\tunit\trange\traw\tvalue\n");
+
+    while((byte = fgetc(input)) != EOF)
+    {
+        if(byte != 0)
+        {
+            if(length < MAX_FRAME_LENGTH)
+            {
+                encoded[length++] = byte;
+            }
+
+            else
+            {
+                overflow = 1;
+            }
+
+            continue;
+        }
+
+        //end of a frame
+        if(length > 0)
+        {
+            int decoded = overflow ? -1 : cobs_decode(encoded, length, frame);
+
+            if(decoded < 0 || !(print_reading(frame, decoded) || print_response(frame, decoded)))
+            {
+                bad_frames++;
+            }
+        }
+
+        length = 0;
+        overflow = 0;
+    }
+
+    if(bad_frames > 0)
+    {
+        fprintf(stderr, "%lu invalid frames skipped\n", bad_frames);
+    }
+
+    if(input != stdin)
+    {
+        fclose(input);
+    }
+
+    return (0);
+}